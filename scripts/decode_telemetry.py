@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""Decoder di riferimento per la telemetria binaria su bonsai/<id>/telemetry.
+
+Layout del frame: vedi src/telemetry_codec.h (v1 = 14 byte little-endian).
+
+Uso:
+  mosquitto_sub -h <broker> -t 'bonsai/+/telemetry' -F '%t %x' | python3 scripts/decode_telemetry.py
+  python3 scripts/decode_telemetry.py 01030078e768bd2a4709c40bf1ff
+"""
+import datetime
+import json
+import struct
+import sys
+
+# version, flags, ts, rssi, soil_pct, soil_raw, battery (mV sul pin), temp
+FRAME_V1 = struct.Struct("<BBIbBHHh")
+
+FLAG_PUMP_ON = 0x01
+FLAG_TIME_VALID = 0x02
+FLAG_PUMP_ALERT = 0x04
+
+
+def decode(payload: bytes) -> dict:
+    if not payload:
+        raise ValueError("payload vuoto")
+    version = payload[0]
+    if version != 1:
+        raise ValueError(f"versione frame non supportata: {version}")
+    if len(payload) < FRAME_V1.size:
+        raise ValueError(f"frame v1 troppo corto: {len(payload)} < {FRAME_V1.size}")
+
+    _, flags, ts, rssi, soil_pct, soil_raw, battery, temp = FRAME_V1.unpack_from(payload)
+    time_valid = bool(flags & FLAG_TIME_VALID)
+    return {
+        "version": version,
+        "ts": ts if time_valid else None,
+        "time": datetime.datetime.fromtimestamp(ts, datetime.timezone.utc).isoformat() if time_valid else None,
+        "rssi": rssi,
+        "humidity": soil_pct,
+        "soil_raw": soil_raw,
+        "battery_mv": battery,
+        "temp": temp / 10.0,
+        "pump": "on" if flags & FLAG_PUMP_ON else "off",
+        "pump_alert": bool(flags & FLAG_PUMP_ALERT),
+    }
+
+
+def decode_line(line: str) -> dict:
+    # "topic hex" (mosquitto_sub -F '%t %x') oppure solo "hex"
+    parts = line.split()
+    topic = parts[0] if len(parts) > 1 else None
+    out = decode(bytes.fromhex(parts[-1]))
+    if topic:
+        out["topic"] = topic
+    return out
+
+
+def main():
+    lines = sys.argv[1:] or (l for l in sys.stdin)
+    for line in lines:
+        line = line.strip()
+        if not line:
+            continue
+        try:
+            print(json.dumps(decode_line(line)), flush=True)
+        except ValueError as e:
+            print(f"❌ {e}: {line}", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
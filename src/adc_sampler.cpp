@@ -0,0 +1,218 @@
+#include "adc_sampler.h"
+#include <Arduino.h>
+
+#if ADC_DMA_ENABLED
+extern "C" {
+  #include "driver/adc.h"
+  #include "esp_adc_cal.h"
+}
+#endif
+
+// =======================================================
+// ====================== RIDUZIONE ======================
+// =======================================================
+
+namespace AdcSampler {
+
+int gpioToAdc1Channel(int gpio)
+{
+  switch (gpio) {
+    case 36: return 0;
+    case 37: return 1;
+    case 38: return 2;
+    case 39: return 3;
+    case 32: return 4;
+    case 33: return 5;
+    case 34: return 6;
+    case 35: return 7;
+    default: return -1;
+  }
+}
+
+static void add(AdcChannelAcc& acc, uint16_t v)
+{
+  acc.range.push(v);
+  acc.sum += (uint32_t)acc.hampel.push(v);
+  acc.n++;
+}
+
+void accumulate(const uint8_t* frames, size_t len, uint8_t soilCh, uint8_t batteryCh,
+                AdcChannelAcc& soil, AdcChannelAcc& battery)
+{
+  for (size_t i = 0; i + 1 < len; i += 2) {
+    const uint16_t w = (uint16_t)(frames[i] | (frames[i + 1] << 8));
+    const uint8_t ch = (uint8_t)(w >> 12);
+    const uint16_t v = w & 0x0FFF;
+    if (ch == soilCh) add(soil, v);
+    else if (ch == batteryCh) add(battery, v);
+  }
+}
+
+uint16_t channelMean(const AdcChannelAcc& acc)
+{
+  if (acc.n == 0) return 0;
+  return (uint16_t)((acc.sum + acc.n / 2) / acc.n);
+}
+
+} // namespace AdcSampler
+
+// =======================================================
+// ========================= DMA =========================
+// =======================================================
+
+#if ADC_DMA_ENABLED
+
+static const uint32_t ADC_FRAME_BYTES = 256;   // 128 conversioni per interrupt
+static const uint32_t ADC_DEFAULT_VREF_MV = 1100;
+
+static bool s_ready = false;
+static bool s_running = false;
+static uint8_t s_soilCh = 0;
+static uint8_t s_batteryCh = 0;
+static uint32_t s_startMs = 0;
+static AdcChannelAcc s_soil;
+static AdcChannelAcc s_battery;
+static uint8_t s_frame[ADC_FRAME_BYTES];
+
+static esp_adc_cal_characteristics_t s_cal;
+static esp_adc_cal_value_t s_calType = ESP_ADC_CAL_VAL_DEFAULT_VREF;
+
+namespace AdcSampler {
+
+bool begin(int soilPin, int batteryPin)
+{
+  if (s_ready) return true;
+
+  const int soilCh = gpioToAdc1Channel(soilPin);
+  const int batteryCh = gpioToAdc1Channel(batteryPin);
+  if (soilCh < 0 || batteryCh < 0 || soilCh == batteryCh) {
+    Serial.printf("[ADC] pin %d/%d non su ADC1: fallback analogRead\n", soilPin, batteryPin);
+    return false;
+  }
+  s_soilCh = (uint8_t)soilCh;
+  s_batteryCh = (uint8_t)batteryCh;
+
+  adc_digi_init_config_t init = {};
+  init.max_store_buf_size = ADC_FRAME_BYTES * 4;
+  init.conv_num_each_intr = ADC_FRAME_BYTES;
+  init.adc1_chan_mask = (uint32_t)(BIT(s_soilCh) | BIT(s_batteryCh));
+  init.adc2_chan_mask = 0;
+  if (adc_digi_initialize(&init) != ESP_OK) {
+    Serial.println("[ADC] adc_digi_initialize FAIL: fallback analogRead");
+    return false;
+  }
+
+  static adc_digi_pattern_config_t pattern[2] = {};
+  const uint8_t chans[2] = { s_soilCh, s_batteryCh };
+  for (int i = 0; i < 2; i++) {
+    pattern[i].atten = ADC_ATTEN_DB_11;   // 0..~3.1 V, come analogRead()
+    pattern[i].channel = chans[i];
+    pattern[i].unit = 0;                  // ADC1
+    pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+  }
+
+  adc_digi_configuration_t dig = {};
+  dig.conv_limit_en = 1;                  // obbligatorio su ESP32 (I2S)
+  dig.conv_limit_num = 250;
+  dig.pattern_num = 2;
+  dig.adc_pattern = pattern;
+  dig.sample_freq_hz = SAMPLE_FREQ_HZ;
+  dig.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  dig.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+  if (adc_digi_controller_configure(&dig) != ESP_OK) {
+    adc_digi_deinitialize();
+    Serial.println("[ADC] adc_digi_controller_configure FAIL: fallback analogRead");
+    return false;
+  }
+
+  // Vref da eFuse se presente (o two-point), altrimenti 1100 mV nominali
+  s_calType = esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12,
+                                       ADC_DEFAULT_VREF_MV, &s_cal);
+  s_ready = true;
+  Serial.printf("[ADC] DMA ch%u/ch%u @ %lu Hz, cal=%s\n", s_soilCh, s_batteryCh,
+                (unsigned long)SAMPLE_FREQ_HZ, calibrationStr());
+  return true;
+}
+
+bool ready()
+{
+  return s_ready;
+}
+
+bool start()
+{
+  if (!s_ready || s_running) return s_running;
+  s_soil = AdcChannelAcc();
+  s_battery = AdcChannelAcc();
+  if (adc_digi_start() != ESP_OK) return false;
+  s_running = true;
+  s_startMs = millis();
+  return true;
+}
+
+AdcBurst poll(AdcReading& out)
+{
+  if (!s_running) return AdcBurst::Failed;
+
+  // Timeout 0: legge solo i frame già completati dal DMA
+  // (INVALID_STATE = overflow del buffer interno, i dati letti restano validi)
+  uint32_t got = 0;
+  esp_err_t err;
+  while ((err = adc_digi_read_bytes(s_frame, sizeof(s_frame), &got, 0)) == ESP_OK ||
+         err == ESP_ERR_INVALID_STATE) {
+    if (got == 0) break;
+    accumulate(s_frame, got, s_soilCh, s_batteryCh, s_soil, s_battery);
+    if (s_soil.n >= SAMPLES_PER_CHANNEL && s_battery.n >= SAMPLES_PER_CHANNEL) break;
+  }
+
+  if (s_soil.n < SAMPLES_PER_CHANNEL || s_battery.n < SAMPLES_PER_CHANNEL) {
+    if (millis() - s_startMs < BURST_TIMEOUT_MS) return AdcBurst::Pending;
+    if (s_soil.n == 0 || s_battery.n == 0) {
+      abort();
+      return AdcBurst::Failed;
+    }
+    // Scaduto con campioni parziali: si usa quello che c'è
+  }
+
+  adc_digi_stop();
+  s_running = false;
+
+  out.soilRaw = channelMean(s_soil);
+  out.batteryRaw = channelMean(s_battery);
+  out.soilMv = (uint16_t)esp_adc_cal_raw_to_voltage(out.soilRaw, &s_cal);
+  out.batteryMv = (uint16_t)esp_adc_cal_raw_to_voltage(out.batteryRaw, &s_cal);
+  out.samples = s_soil.n < s_battery.n ? s_soil.n : s_battery.n;
+  out.outliers = (uint16_t)(s_soil.hampel.outliers() + s_battery.hampel.outliers());
+  return AdcBurst::Done;
+}
+
+void abort()
+{
+  if (!s_running) return;
+  adc_digi_stop();
+  s_running = false;
+}
+
+const char* calibrationStr()
+{
+  switch (s_calType) {
+    case ESP_ADC_CAL_VAL_EFUSE_VREF: return "efuse_vref";
+    case ESP_ADC_CAL_VAL_EFUSE_TP:   return "two_point";
+    default:                         return "default";
+  }
+}
+
+} // namespace AdcSampler
+
+#else
+
+namespace AdcSampler {
+bool begin(int, int) { return false; }
+bool ready() { return false; }
+bool start() { return false; }
+AdcBurst poll(AdcReading&) { return AdcBurst::Failed; }
+void abort() {}
+const char* calibrationStr() { return "none"; }
+}
+
+#endif
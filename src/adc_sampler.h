@@ -0,0 +1,79 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "signal_filter.h"
+
+// 1 = acquisizione continua via DMA (adc_digi_*, IDF 4.4) + calibrazione eFuse.
+// 0 = solo la parte di riduzione, host-testabile (env native): begin() fallisce
+//     e il controllo ripiega su analogRead().
+#ifdef NATIVE_BUILD
+  #define ADC_DMA_ENABLED 0
+#else
+  #define ADC_DMA_ENABLED 1
+#endif
+
+// Hampel per l'ADC dell'ESP32: finestra 9, k = 3, e sotto ±12 LSB (rumore
+// tipico a 11 dB) non si scarta mai, anche se la finestra ha MAD quasi nulla
+typedef SignalFilter::HampelFilter<int32_t, 9, 768, 12> AdcHampel;
+
+// Accumulatore per canale di una raffica DMA: Hampel sui campioni grezzi,
+// poi media dei valori puliti
+struct AdcChannelAcc {
+  AdcHampel hampel;
+  SignalFilter::MinMaxTracker<uint16_t> range;   // grezzo, prima di Hampel
+  uint32_t sum = 0;
+  uint16_t n = 0;
+};
+
+enum class AdcBurst : uint8_t {
+  Pending,   // DMA ancora in corso
+  Done,      // `out` valido, driver fermato
+  Failed,    // nessun dato entro BURST_TIMEOUT_MS: usare analogRead()
+};
+
+// Risultato di una raffica: grezzo = media dopo Hampel, mV = calibrazione eFuse
+struct AdcReading {
+  uint16_t soilRaw;
+  uint16_t soilMv;
+  uint16_t batteryRaw;
+  uint16_t batteryMv;
+  uint16_t samples;     // campioni per canale
+  uint16_t outliers;    // campioni sostituiti da Hampel (entrambi i canali)
+};
+
+// Sensore (GPIO32 = ADC1_CH4) e batteria (GPIO34 = ADC1_CH6) campionati in
+// background dal controller digitale dell'ADC1: una raffica da
+// SAMPLES_PER_CHANNEL conversioni per canale dura ~3 ms invece dei 250 ms di
+// 5 × analogRead + delay(50). Pensato per il task di controllo: start() e
+// poll() non bloccano.
+namespace AdcSampler {
+  // Con Hampel gli spike non spostano la media: 32 campioni bastano
+  // (test_bench: bench_signalFilter sulla traccia registrata)
+  static const uint16_t SAMPLES_PER_CHANNEL = 32;
+  static const uint32_t SAMPLE_FREQ_HZ = 20000;   // minimo del controller su ESP32
+  static const uint32_t BURST_TIMEOUT_MS = 50;
+
+  // false se i pin non sono su ADC1 o il driver non parte: usare analogRead()
+  bool begin(int soilPin, int batteryPin);
+  bool ready();
+
+  bool start();                    // avvia una raffica
+  AdcBurst poll(AdcReading& out);
+  void abort();
+
+  // Descrizione della calibrazione usata ("efuse_vref", "two_point", "default")
+  const char* calibrationStr();
+
+  // ---- Parte pura (host-testabile) ----
+
+  // GPIO → canale ADC1, -1 se il pin non è su ADC1
+  int gpioToAdc1Channel(int gpio);
+
+  // Smista i risultati DMA (formato TYPE1 dell'ESP32: 16 bit LE, canale nei
+  // 4 bit alti, dato nei 12 bassi) negli accumulatori dei due canali
+  void accumulate(const uint8_t* frames, size_t len, uint8_t soilCh, uint8_t batteryCh,
+                  AdcChannelAcc& soil, AdcChannelAcc& battery);
+
+  // Media dei campioni dopo il filtro di Hampel
+  uint16_t channelMean(const AdcChannelAcc& acc);
+}
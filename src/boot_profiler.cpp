@@ -0,0 +1,126 @@
+#include "boot_profiler.h"
+
+extern "C" {
+  #include "esp_timer.h"
+}
+
+namespace BootProfiler {
+
+static const uint32_t STORE_MAGIC = 0xB0070F01;
+static const size_t PHASES = (size_t)BootPhase::Count;
+
+struct PhaseStats {
+  uint32_t lastUs;
+  uint32_t minUs;
+  uint32_t maxUs;
+  uint32_t avgUs;     // media mobile esponenziale (alpha = 1/8)
+  uint16_t samples;
+};
+
+struct ProfileStore {
+  uint32_t magic;
+  uint32_t wakes;
+  PhaseStats phases[PHASES];
+};
+
+// ===== STATE =====
+RTC_DATA_ATTR static ProfileStore s_store;
+static int64_t  s_startUs[PHASES];
+static uint32_t s_measuredMask = 0;   // fasi misurate in questo wake
+
+static const char* const PHASE_NAMES[PHASES] = {
+  "fs", "cfg", "wifi", "ntp", "mqtt", "ota", "soil", "pump", "total"
+};
+
+// ===== IMPLEMENTATION =====
+
+static void record(BootPhase p, uint32_t us)
+{
+  PhaseStats& s = s_store.phases[(size_t)p];
+  s.lastUs = us;
+  if (s.samples == 0) {
+    s.minUs = s.maxUs = s.avgUs = us;
+  } else {
+    if (us < s.minUs) s.minUs = us;
+    if (us > s.maxUs) s.maxUs = us;
+    s.avgUs = (uint32_t)(((uint64_t)s.avgUs * 7 + us) / 8);
+  }
+  if (s.samples < UINT16_MAX) s.samples++;
+  s_measuredMask |= 1UL << (size_t)p;
+}
+
+void begin()
+{
+  if (s_store.magic != STORE_MAGIC) {
+    memset(&s_store, 0, sizeof(s_store));
+    s_store.magic = STORE_MAGIC;
+  }
+  s_store.wakes++;
+  s_measuredMask = 0;
+  for (size_t i = 0; i < PHASES; i++) s_startUs[i] = -1;
+}
+
+void start(BootPhase p)
+{
+  if (p >= BootPhase::Count) return;
+  s_startUs[(size_t)p] = esp_timer_get_time();
+}
+
+void stop(BootPhase p)
+{
+  if (p >= BootPhase::Count) return;
+  const int64_t t0 = s_startUs[(size_t)p];
+  if (t0 < 0) return;
+  s_startUs[(size_t)p] = -1;
+
+  const int64_t dt = esp_timer_get_time() - t0;
+  record(p, dt > (int64_t)UINT32_MAX ? UINT32_MAX : (uint32_t)dt);
+}
+
+void recordWakeTotal()
+{
+  const int64_t now = esp_timer_get_time();
+  record(BootPhase::WakeTotal, now > (int64_t)UINT32_MAX ? UINT32_MAX : (uint32_t)now);
+}
+
+uint32_t lastMs(BootPhase p)
+{
+  if (p >= BootPhase::Count) return 0;
+  return (s_store.phases[(size_t)p].lastUs + 500) / 1000;
+}
+
+const char* phaseName(BootPhase p)
+{
+  return p < BootPhase::Count ? PHASE_NAMES[(size_t)p] : "?";
+}
+
+size_t formatReport(char* out, size_t len)
+{
+  if (!out || len == 0) return 0;
+
+  size_t n = (size_t)snprintf(out, len, "{\"wake\":%lu", (unsigned long)s_store.wakes);
+
+  for (size_t i = 0; i < PHASES && n < len; i++) {
+    const PhaseStats& s = s_store.phases[i];
+    if (s.samples == 0) continue;
+
+    // Fasi non eseguite in questo wake: last = -1 (WakeTotal si riferisce sempre al wake precedente)
+    const bool fresh = (s_measuredMask & (1UL << i)) || i == (size_t)BootPhase::WakeTotal;
+    const long last = fresh ? (long)((s.lastUs + 500) / 1000) : -1L;
+
+    n += (size_t)snprintf(out + n, len - n, ",\"%s\":[%ld,%lu,%lu,%lu]",
+                          PHASE_NAMES[i], last,
+                          (unsigned long)((s.minUs + 500) / 1000),
+                          (unsigned long)((s.avgUs + 500) / 1000),
+                          (unsigned long)((s.maxUs + 500) / 1000));
+  }
+
+  if (n < len) n += (size_t)snprintf(out + n, len - n, "}");
+  if (n >= len) {
+    out[len - 1] = '\0';
+    return len - 1;
+  }
+  return n;
+}
+
+} // namespace BootProfiler
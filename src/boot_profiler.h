@@ -0,0 +1,34 @@
+#pragma once
+#include <Arduino.h>
+
+// Fasi di setup() misurate ad ogni wake.
+// WakeTotal = durata complessiva del wake precedente (registrata prima del deep sleep).
+enum class BootPhase : uint8_t {
+  FsMount,
+  LoadConfig,
+  WifiAssoc,
+  NtpSync,
+  Mqtt,
+  Updater,
+  SoilRead,
+  PumpCycle,
+  WakeTotal,
+  Count
+};
+
+// Profiler del boot: timestamp ad alta risoluzione (esp_timer) per fase,
+// statistiche last/min/avg/max conservate in RTC memory tra un deep sleep e l'altro.
+namespace BootProfiler {
+
+void begin();                 // prima istruzione di setup()
+void start(BootPhase p);
+void stop(BootPhase p);
+void recordWakeTotal();       // subito prima di esp_deep_sleep_start()
+
+uint32_t lastMs(BootPhase p);
+const char* phaseName(BootPhase p);
+
+// Report compatto (JSON, valori in ms): {"wake":N,"fs":[last,min,avg,max],...}
+size_t formatReport(char* out, size_t len);
+
+} // namespace BootProfiler
@@ -0,0 +1,118 @@
+#include "boot_sequencer.h"
+
+int BootSequencer::add(const char* name, uint32_t deadlineMs, StartFn start, PollFn poll,
+                       uint32_t after, uint32_t requires, BootPhase phase, TimeoutFn onTimeout)
+{
+  if (count_ >= MAX_STAGES) return -1;
+
+  Stage& s = stages_[count_];
+  s.name = name;
+  s.deadlineMs = deadlineMs;
+  s.start = start;
+  s.poll = poll;
+  s.onTimeout = onTimeout;
+  s.after = after | requires;
+  s.requires = requires;
+  s.phase = phase;
+  s.status = StageStatus::Pending;
+  s.startedMs = 0;
+  s.finishedMs = 0;
+  return count_++;
+}
+
+bool BootSequencer::terminal(int id) const
+{
+  StageStatus st = status(id);
+  return st == StageStatus::Done || st == StageStatus::Failed || st == StageStatus::Skipped;
+}
+
+void BootSequencer::finish(Stage& s, StageStatus st)
+{
+  s.status = st;
+  s.finishedMs = millis();
+  if (s.phase != BootPhase::Count) BootProfiler::stop(s.phase);
+  Serial.printf("[BOOT] %-8s %-7s %lu ms\n", s.name, statusStr(st), s.finishedMs - s.startedMs);
+}
+
+void BootSequencer::tick()
+{
+  for (uint8_t i = 0; i < count_; i++) {
+    Stage& s = stages_[i];
+
+    if (s.status == StageStatus::Pending) {
+      bool ready = true;
+      bool skip = false;
+      for (uint8_t d = 0; d < count_; d++) {
+        if (!(s.after & STAGE_BIT(d))) continue;
+        if (!terminal(d)) { ready = false; break; }
+        if ((s.requires & STAGE_BIT(d)) && stages_[d].status != StageStatus::Done) skip = true;
+      }
+      if (!ready) continue;
+
+      s.startedMs = millis();
+      if (skip) {
+        s.status = StageStatus::Skipped;
+        s.finishedMs = s.startedMs;
+        Serial.printf("[BOOT] %-8s skipped\n", s.name);
+        continue;
+      }
+
+      if (s.phase != BootPhase::Count) BootProfiler::start(s.phase);
+      s.status = StageStatus::Running;
+      if (s.start && !s.start()) {
+        finish(s, StageStatus::Failed);
+        continue;
+      }
+    }
+
+    if (s.status != StageStatus::Running) continue;
+
+    StageStatus st = s.poll ? s.poll() : StageStatus::Done;
+    if (st == StageStatus::Done || st == StageStatus::Failed) {
+      finish(s, st);
+    } else if (s.deadlineMs > 0 && millis() - s.startedMs >= s.deadlineMs) {
+      if (s.onTimeout) s.onTimeout();
+      finish(s, StageStatus::Failed);
+    }
+  }
+}
+
+bool BootSequencer::done() const
+{
+  for (uint8_t i = 0; i < count_; i++)
+    if (!terminal(i)) return false;
+  return true;
+}
+
+StageStatus BootSequencer::status(int id) const
+{
+  if (id < 0 || id >= count_) return StageStatus::Skipped;
+  return stages_[id].status;
+}
+
+unsigned long BootSequencer::elapsedMs(int id) const
+{
+  if (id < 0 || id >= count_) return 0;
+  const Stage& s = stages_[id];
+  if (s.status == StageStatus::Pending) return 0;
+  if (s.status == StageStatus::Running) return millis() - s.startedMs;
+  return s.finishedMs - s.startedMs;
+}
+
+const char* BootSequencer::name(int id) const
+{
+  if (id < 0 || id >= count_) return "?";
+  return stages_[id].name;
+}
+
+const char* BootSequencer::statusStr(StageStatus s)
+{
+  switch (s) {
+    case StageStatus::Pending: return "pending";
+    case StageStatus::Running: return "running";
+    case StageStatus::Done:    return "done";
+    case StageStatus::Failed:  return "failed";
+    case StageStatus::Skipped: return "skipped";
+  }
+  return "?";
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <Arduino.h>
+#include "boot_profiler.h"
+
+// Stato di uno stage di boot
+enum class StageStatus : uint8_t {
+  Pending,   // in attesa delle dipendenze
+  Running,
+  Done,
+  Failed,    // errore o deadline scaduta
+  Skipped    // una dipendenza obbligatoria è fallita
+};
+
+#define STAGE_BIT(id) (1UL << (uint32_t)(id))
+
+// Sequencer cooperativo per setup(): ogni stage ha una deadline, parte appena
+// le sue dipendenze sono terminate e non blocca gli altri. Gli stage
+// indipendenti (sensore/pompa vs WiFi/MQTT) avanzano in parallelo, un errore
+// degrada solo gli stage che ne dipendono.
+class BootSequencer {
+public:
+  // start(): avvio non bloccante (false = fallito subito)
+  // poll():  Running finché non termina, poi Done o Failed
+  // onTimeout(): pulizia quando scade la deadline (opzionale)
+  using StartFn   = bool (*)();
+  using PollFn    = StageStatus (*)();
+  using TimeoutFn = void (*)();
+
+  static const uint8_t MAX_STAGES = 12;
+
+  // after:    stage che devono essere terminati (in qualunque stato)
+  // requires: stage che devono essere Done, altrimenti questo viene Skipped
+  // deadlineMs = 0 → nessuna deadline (lo stage si limita da solo)
+  int add(const char* name, uint32_t deadlineMs, StartFn start, PollFn poll,
+          uint32_t after = 0, uint32_t requires = 0,
+          BootPhase phase = BootPhase::Count, TimeoutFn onTimeout = nullptr);
+
+  void tick();                 // da chiamare in loop stretto, non blocca
+  bool done() const;
+
+  StageStatus status(int id) const;
+  bool ok(int id) const { return status(id) == StageStatus::Done; }
+  unsigned long elapsedMs(int id) const;
+  const char* name(int id) const;
+
+  static const char* statusStr(StageStatus s);
+
+private:
+  struct Stage {
+    const char* name;
+    uint32_t deadlineMs;
+    StartFn start;
+    PollFn poll;
+    TimeoutFn onTimeout;
+    uint32_t after;
+    uint32_t requires;
+    BootPhase phase;
+    StageStatus status;
+    unsigned long startedMs;
+    unsigned long finishedMs;
+  };
+
+  bool terminal(int id) const;
+  void finish(Stage& s, StageStatus st);
+
+  Stage stages_[MAX_STAGES];
+  uint8_t count_ = 0;
+};
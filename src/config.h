@@ -5,6 +5,7 @@
 #define PUMP_ON LOW
 #define PUMP_OFF HIGH
 
+// Nuovi campi: anche in CONFIG_FIELDS (config_schema.h): JSON, default, limiti e cache
 struct Config
 {
   // WiFi
@@ -16,6 +17,14 @@ struct Config
   String mqtt_password;
   String mqtt_broker;
   int    mqtt_port;
+  bool   mqtt_persistent_session;  // cleanSession off + subscribe QoS 1: i comandi inviati durante il sleep arrivano al wake
+  bool   telemetry_binary;   // stato periodico come frame binario su bonsai/<id>/telemetry
+
+  // Report a deadband dei topic di stato (report_heartbeat_s = 0 → tutto ogni 15 s)
+  int report_heartbeat_s;        // ripubblica comunque dopo questo silenzio
+  int report_deadband_humidity;  // punti %
+  int report_deadband_rssi;      // dBm
+  int report_deadband_battery;   // mV
 
   // Hardware
   int led_pin;
@@ -26,7 +35,10 @@ struct Config
 
   // Logica irrigazione
   int moisture_threshold;
-  int pump_duration;
+  int pump_duration;         // budget di pompa accesa per sessione (s)
+  int irrigation_pulse_s;    // impulso; 0 = un solo impulso di pump_duration
+  int irrigation_soak_s;     // pausa prima di rimisurare
+  int irrigation_target;     // umidità % a cui fermarsi; 0 = moisture_threshold + 10
   int measurement_interval;
   bool use_pump;
   bool debug;
@@ -35,6 +47,11 @@ struct Config
 
   // Sleep
   int sleep_hours;
+  int maintenance_wakes;     // 0/1 = radio a ogni wake; N>1 = sensor-first, radio forzata ogni N wake
+  bool adaptive_sleep;       // durata dal trend dell'umidità (sleep_scheduler.h) invece di sleep_hours fisso
+  int sleep_max_hours;       // limite superiore dello sleep adattivo, 0 = sleep_hours (il minimo è measurement_interval)
+  int low_battery_mv;        // sotto questa tensione (mV sul pin) lo sleep adattivo raddoppia; 0 = mai
+  bool ulp_monitor;          // durante il deep sleep l'ULP legge il sensore ogni measurement_interval (ulp_monitor.h)
 
   // Rete statica
   bool   use_dhcp;
@@ -51,4 +68,3 @@ struct Config
   String timezone;           // Timezone string (IANA: "Europe/Rome", "Europe/Berlin", "UTC" o POSIX: "CET-1CEST,M3.5.0/2,M10.5.0/3")
 };
 
-bool loadConfig(Config &config);
@@ -4,7 +4,11 @@
 #include <SPIFFS.h>
 #include "config_api.h"
 #include "config_validator.h"
-#include "mqtt.h"   // publishMqtt()
+#include "config_cache.h"
+#include "config_schema.h"
+#include "record_store.h"
+#include "mqtt.h"   // publishMqtt(), mqttPause()
+#include <atomic>
 
 const char* CONFIG_PATH = "/config.json";
 
@@ -12,45 +16,35 @@ const char* CONFIG_PATH = "/config.json";
 // FS Helpers
 // ---------------------------------------------------------------------------
 
+// Montato al primo uso: sui wake con config in cache SPIFFS non si tocca
+static bool s_fsMounted = false;
+
 bool mountFS(bool formatOnFail)
 {
-    if (FS_IMPL.begin(formatOnFail))
+    if (s_fsMounted)
         return true;
 
-    if (!formatOnFail)
-        return false;
-
-    return FS_IMPL.begin(true);
-}
-
-bool writeFileAtomic(const char* path, const String& data)
-{
-    String tmp = String(path) + ".tmp";
-
-    auto f = FS_IMPL.open(tmp, "w");
-    if (!f) return false;
-
-    size_t w = f.print(data);
-    f.flush();
-    f.close();
+    if (FS_IMPL.begin(formatOnFail)) {
+        s_fsMounted = true;
+        return true;
+    }
 
-    if (w != data.length()) {
-        FS_IMPL.remove(tmp);
+    if (!formatOnFail)
         return false;
-    }
 
-    FS_IMPL.remove(path);
-    return FS_IMPL.rename(tmp, path);
+    s_fsMounted = FS_IMPL.begin(true);
+    return s_fsMounted;
 }
 
-bool readFileToString(const char* path, String& out)
+// CRC del file senza caricarlo: decide se config.json va reimportato
+static uint32_t streamCrc(File& f)
 {
-    auto f = FS_IMPL.open(path, "r");
-    if (!f) return false;
-
-    out = f.readString();
-    f.close();
-    return true;
+    uint8_t buf[64];
+    uint32_t crc = 0;
+    size_t n;
+    while ((n = f.read(buf, sizeof(buf))) > 0)
+        crc = RecordStore::crc32(buf, n, crc);
+    return crc;
 }
 
 // ---------------------------------------------------------------------------
@@ -59,85 +53,38 @@ bool readFileToString(const char* path, String& out)
 
 String configToJson(const Config& c)
 {
-    StaticJsonDocument<2048> d;
-
-    d["wifi_ssid"]     = c.wifi_ssid;
-    d["wifi_password"] = c.wifi_password;
-
-    d["mqtt_broker"]   = c.mqtt_broker;
-    d["mqtt_port"]     = c.mqtt_port;
-    d["mqtt_username"] = c.mqtt_username;
-    d["mqtt_password"] = c.mqtt_password;
-
-    d["sensor_pin"]           = c.sensor_pin;
-    d["pump_pin"]             = c.pump_pin;
-    d["relay_pin"]            = c.relay_pin;
-    d["battery_pin"]          = c.battery_pin;
-    d["moisture_threshold"]   = c.moisture_threshold;
-    d["pump_duration"]        = c.pump_duration;
-    d["measurement_interval"] = c.measurement_interval;
-
-    d["use_pump"]  = c.use_pump;
-    d["debug"]     = c.debug;
-    d["enable_webserver"] = c.enable_webserver;
-    d["webserver_timeout"] = c.webserver_timeout;
-
-    d["sleep_hours"] = c.sleep_hours;
-
-    d["use_dhcp"]   = c.use_dhcp;
-    d["ip_address"] = c.ip_address;
-    d["gateway"]    = c.gateway;
-    d["subnet"]     = c.subnet;
-
-    d["ota_manifest_url"] = c.ota_manifest_url;
-    d["update_server"]    = c.update_server;
-    d["config_version"]   = c.config_version;
-    d["timezone"]         = c.timezone;
+    StaticJsonDocument<CONFIG_JSON_CAPACITY> d;
+    ConfigSchema::toJson(c, d);
 
     String out;
     serializeJson(d, out);
     return out;
 }
 
-bool jsonToConfig(const String& json, Config& out)
+// Il filtro scarta le chiavi fuori tabella: il documento ha dimensione fissa
+// qualunque cosa arrivi, e nessuna copia intermedia dell'input
+bool jsonToConfig(const char* json, size_t len, Config& out)
 {
-    StaticJsonDocument<2048> d;
-    auto err = deserializeJson(d, json);
+    StaticJsonDocument<CONFIG_PARSE_CAPACITY> d;
+    auto err = deserializeJson(d, json, len, DeserializationOption::Filter(ConfigSchema::filter()));
     if (err) return false;
 
-    if (d.containsKey("wifi_ssid"))     out.wifi_ssid     = d["wifi_ssid"].as<String>();
-    if (d.containsKey("wifi_password")) out.wifi_password = d["wifi_password"].as<String>();
-
-    if (d.containsKey("mqtt_broker"))   out.mqtt_broker   = d["mqtt_broker"].as<String>();
-    if (d.containsKey("mqtt_port"))     out.mqtt_port     = d["mqtt_port"].as<int>();
-    if (d.containsKey("mqtt_username")) out.mqtt_username = d["mqtt_username"].as<String>();
-    if (d.containsKey("mqtt_password")) out.mqtt_password = d["mqtt_password"].as<String>();
-
-    if (d.containsKey("sensor_pin"))           out.sensor_pin           = d["sensor_pin"].as<int>();
-    if (d.containsKey("pump_pin"))             out.pump_pin             = d["pump_pin"].as<int>();
-    if (d.containsKey("relay_pin"))            out.relay_pin            = d["relay_pin"].as<int>();
-    if (d.containsKey("battery_pin"))          out.battery_pin          = d["battery_pin"].as<int>();
-    if (d.containsKey("moisture_threshold"))   out.moisture_threshold   = d["moisture_threshold"].as<int>();
-    if (d.containsKey("pump_duration"))        out.pump_duration        = d["pump_duration"].as<int>();
-    if (d.containsKey("measurement_interval")) out.measurement_interval = d["measurement_interval"].as<int>();
-
-    if (d.containsKey("use_pump")) out.use_pump = d["use_pump"].as<bool>();
-    if (d.containsKey("debug"))    out.debug    = d["debug"].as<bool>();
-    if (d.containsKey("enable_webserver")) out.enable_webserver = d["enable_webserver"].as<bool>();
-    if (d.containsKey("webserver_timeout")) out.webserver_timeout = d["webserver_timeout"].as<int>();
-
-    if (d.containsKey("sleep_hours")) out.sleep_hours = d["sleep_hours"].as<int>();
+    ConfigSchema::fromJson(d, out);
+    return true;
+}
 
-    if (d.containsKey("use_dhcp"))   out.use_dhcp   = d["use_dhcp"].as<bool>();
-    if (d.containsKey("ip_address")) out.ip_address = d["ip_address"].as<String>();
-    if (d.containsKey("gateway"))    out.gateway    = d["gateway"].as<String>();
-    if (d.containsKey("subnet"))     out.subnet     = d["subnet"].as<String>();
+bool jsonToConfig(const String& json, Config& out)
+{
+    return jsonToConfig(json.c_str(), json.length(), out);
+}
 
-    if (d.containsKey("ota_manifest_url")) out.ota_manifest_url = d["ota_manifest_url"].as<String>();
-    if (d.containsKey("update_server"))    out.update_server    = d["update_server"].as<String>();
-    if (d.containsKey("config_version"))   out.config_version   = d["config_version"].as<String>();
-    if (d.containsKey("timezone"))        out.timezone         = d["timezone"].as<String>();
+bool jsonToConfig(Stream& in, Config& out)
+{
+    StaticJsonDocument<CONFIG_PARSE_CAPACITY> d;
+    auto err = deserializeJson(d, in, DeserializationOption::Filter(ConfigSchema::filter()));
+    if (err) return false;
 
+    ConfigSchema::fromJson(d, out);
     return true;
 }
 
@@ -145,159 +92,297 @@ bool jsonToConfig(const String& json, Config& out)
 // Persistenza
 // ---------------------------------------------------------------------------
 
+// Il config salvato vive solo nella cache binaria in flash (kvstore o NVS):
+// un append atomico, niente riscrittura di config.json né rename su SPIFFS
 bool saveConfigStruct(const Config& c)
 {
-    return writeFileAtomic(CONFIG_PATH, configToJson(c));
+    return ConfigCache::store(c);
 }
 
-bool loadConfig(Config& out)
+// config.json è il seme: reimportato solo quando il suo CRC cambia (primo
+// flash, `uploadfs`), altrimenti vale l'ultimo config salvato via API/MQTT
+static bool importConfigJson(Config& out, ConfigSource& src)
 {
     if (!mountFS(true)) {
         Serial.println("[FS] Mount fallito anche dopo format");
         return false;
     }
 
-    String json;
-    if (!readFileToString(CONFIG_PATH, json)) {
-        Serial.println("[CONFIG] Nessun config.json, uso default");
-        out = getDefaultConfig();
-        return false;  // Indica che non c'era un config, ma abbiamo un default
+    auto f = FS_IMPL.open(CONFIG_PATH, "r");
+    if (!f) {
+        Serial.println("[CONFIG] Nessun config.json");
+        return false;
     }
 
-    if (!jsonToConfig(json, out)) {
-        Serial.println("[CONFIG] Errore parsing JSON, uso default");
-        out = getDefaultConfig();
+    const uint32_t seed = streamCrc(f);
+    if (seed == ConfigCache::jsonSeed() && ConfigCache::restoreFlash(out)) {
+        f.close();
+        src = ConfigCache::flashSource();
+        return true;
+    }
+
+    // Parse dallo stream: il file non passa mai per una String
+    f.seek(0);
+    out = getDefaultConfig();
+    const bool parsed = jsonToConfig(f, out);
+    f.close();
+
+    if (!parsed) {
+        Serial.println("[CONFIG] Errore parsing JSON");
         return false;
     }
 
-    // Validazione configurazione
+    // Validazione configurazione: al default solo i campi non validi, il
+    // resto del file resta. Il risultato entra sempre nella cache binaria,
+    // quindi il seme viene registrato e il boot successivo non reimporta.
     if (!validateConfig(out)) {
-        Serial.println("[CONFIG] Config non valido, correggo con default e salvo");
-        Config def = getDefaultConfig();
-        // Mantieni valori critici se validi (WiFi, MQTT)
-        if (out.wifi_ssid.length() > 0) def.wifi_ssid = out.wifi_ssid;
-        if (out.wifi_password.length() > 0) def.wifi_password = out.wifi_password;
-        if (out.mqtt_broker.length() > 0) def.mqtt_broker = out.mqtt_broker;
-        if (out.mqtt_username.length() > 0) def.mqtt_username = out.mqtt_username;
-        if (out.mqtt_password.length() > 0) def.mqtt_password = out.mqtt_password;
-        if (out.mqtt_port > 0 && out.mqtt_port <= 65535) def.mqtt_port = out.mqtt_port;
-        
-        out = def;
-        // Salva config corretto
-        saveConfigStruct(out);
-        Serial.println("[CONFIG] Config corretto salvato");
-        return true;  // Config corretto e salvato
+        const uint8_t fixed = ConfigSchema::sanitize(out);
+        Serial.printf("[CONFIG] Config non valido: %u campi al default\n", fixed);
     }
 
-    return true;  // Config valido
+    // Seme aggiornato solo dopo il config: un reset nel mezzo reimporta il file
+    if (saveConfigStruct(out))
+        ConfigCache::setJsonSeed(seed);
+    src = ConfigSource::Json;
+    Serial.println("[CONFIG] config.json importato");
+    return true;
 }
 
-// ---------------------------------------------------------------------------
-// Confronto parametri critici MQTT
-// ---------------------------------------------------------------------------
-
-bool mqttCriticalChanged(const Config& a, const Config& b)
+bool loadConfig(Config& out, ConfigSource* src)
 {
-    return a.mqtt_broker   != b.mqtt_broker ||
-           a.mqtt_port     != b.mqtt_port   ||
-           a.mqtt_username != b.mqtt_username ||
-           a.mqtt_password != b.mqtt_password;
+    ConfigSource from = ConfigSource::Json;
+    bool ok = importConfigJson(out, from);
+
+    // File mancante o illeggibile: ultimo config salvato
+    if (!ok && ConfigCache::restoreFlash(out)) {
+        from = ConfigCache::flashSource();
+        ok = true;
+    }
+    if (!ok) {
+        Serial.println("[CONFIG] Nessun config valido, uso default");
+        out = getDefaultConfig();
+        from = ConfigSource::Defaults;
+    }
+
+    if (src) *src = from;
+    return ok;
 }
 
 // ---------------------------------------------------------------------------
 // APPLY + SAVE
 // ---------------------------------------------------------------------------
+// La classe della modifica (ConfigSchema::applyClass) decide come applicarla:
+// Live sul posto, Reconnect con il worker MQTT fermo, Restart solo salvata.
 
-bool applyAndPersistConfigJson(const String& json, bool rebootAfter)
+static const unsigned long MQTT_PAUSE_TIMEOUT_MS = 5000;  // > timeout di connect del worker
+
+static ConfigAppliedHook s_appliedHook = nullptr;
+
+void setConfigAppliedHook(ConfigAppliedHook hook)
 {
-    Config newCfg = config;
+    s_appliedHook = hook;
+}
 
-    if (!jsonToConfig(json, newCfg)) {
-        mqttClient.publish("bonsai/ack/config", "{\"status\":\"failed\",\"reason\":\"parse\"}");
+static void publishApplyAck(const char* status, const char* detail)
+{
+    char ack[64];
+    snprintf(ack, sizeof(ack), "{\"status\":\"%s\",\"%s\":\"%s\"}",
+             status, strcmp(status, "applied") == 0 ? "mode" : "reason", detail);
+    publishMqtt("bonsai/ack/config", ack);
+}
+
+// Ultimo config salvato quando in RAM mancano ancora campi Restart (o un
+// Reconnect rinviato): le modifiche successive partono da qui, non da config
+static Config s_pendingConfig;
+static bool s_pending = false;
+
+static void applyInRam(const Config& newCfg)
+{
+    const Config before = config;
+    ConfigSchema::update(config, newCfg);
+    if (s_appliedHook) s_appliedHook(before);
+}
+
+bool persistAndApplyConfig(const char* json, size_t len, ConfigApply& applied, Config& saved)
+{
+    applied = ConfigApply::None;
+    saved = s_pending ? s_pendingConfig : config;
+
+    if (!jsonToConfig(json, len, saved)) {
+        publishApplyAck("failed", "parse");
         return false;
     }
 
-    bool crit = mqttCriticalChanged(config, newCfg);
-
-    if (!saveConfigStruct(newCfg)) {
-        mqttClient.publish("bonsai/ack/config", "{\"status\":\"failed\",\"reason\":\"fs_write\"}");
+    // Prima si salvava anche un config fuori limiti (corretto solo al boot dopo)
+    if (!validateConfig(saved)) {
+        publishApplyAck("failed", "invalid");
         return false;
     }
 
-    config = newCfg;
+    // Classe di questa modifica rispetto al config salvato
+    const ConfigApply cls = ConfigSchema::applyClass(s_pending ? s_pendingConfig : config, saved);
 
-    mqttClient.publish("bonsai/ack/config", "{\"status\":\"applied\"}");
+    // Stesso contenuto: niente scrittura in flash
+    if (cls != ConfigApply::None && !saveConfigStruct(saved)) {
+        publishApplyAck("failed", "fs_write");
+        return false;
+    }
 
-    if (rebootAfter) {
-        delay(500);
-        ESP.restart();
+    // In RAM tutto tranne i campi Restart: pin e rete restano quelli in uso
+    // fino al riavvio
+    Config live = saved;
+    ConfigSchema::copyFlagged(live, config, CFG_RESTART);
+
+    applied = cls;
+    switch (ConfigSchema::applyClass(config, live)) {
+        case ConfigApply::None:
+        case ConfigApply::Restart:
+            break;
+
+        case ConfigApply::Live:
+            applyInRam(live);
+            break;
+
+        case ConfigApply::Reconnect:
+            // Il worker legge broker e credenziali in connectMqtt(): fermo durante la copia
+            if (mqttPause(MQTT_PAUSE_TIMEOUT_MS)) {
+                applyInRam(live);
+                mqttResume(true);
+            } else {
+                Serial.println("[CONFIG] Worker MQTT occupato: applico al riavvio");
+                applied = ConfigApply::Restart;
+            }
+            break;
     }
 
-    if (crit) {
-        Serial.println("[CONFIG] Cambiati parametri MQTT: riavvio consigliato");
+    s_pending = ConfigSchema::applyClass(config, saved) != ConfigApply::None;
+    if (s_pending) s_pendingConfig = saved;
+
+    Serial.printf("[CONFIG] Config %s\n", ConfigSchema::applyStr(applied));
+    publishApplyAck("applied", ConfigSchema::applyStr(applied));
+    return true;
+}
+
+void finishConfigApply(ConfigApply applied, const Config& saved, bool allowRestart)
+{
+    if (applied == ConfigApply::None) return;
+
+    // Snapshot retained del config salvato (dopo un riavvio la sessione
+    // ripresa non lo ripubblicherebbe)
+    publishConfigSnapshot(saved);
+
+    if (applied != ConfigApply::Restart) return;
+
+    if (!allowRestart) {
+        Serial.println("[CONFIG] Salvato: attivo al prossimo riavvio");
+        return;
     }
 
+    mqttRestart();  // ack e snapshot escono prima del riavvio
+}
+
+bool applyAndPersistConfigJson(const char* json, size_t len, bool rebootAfter)
+{
+    ConfigApply applied;
+    Config saved;
+    if (!persistAndApplyConfig(json, len, applied, saved)) return false;
+
+    finishConfigApply(applied, saved, rebootAfter);
     return true;
 }
 
+bool applyAndPersistConfigJson(const String& json, bool rebootAfter)
+{
+    return applyAndPersistConfigJson(json.c_str(), json.length(), rebootAfter);
+}
+
 // ---------------------------------------------------------------------------
-// API HTTP
+// Casella HTTP → loop()
 // ---------------------------------------------------------------------------
+// Il handler gira nel task AsyncTCP: ricompone i chunk del body in un buffer
+// fisso, controlla sintassi e limiti e lo lascia qui; loop() lo confronta con
+// il config e lo applica (config, worker MQTT e hook non vengono mai toccati
+// da due task). Nessuna String, heap costante.
+
+static char s_httpBody[CONFIG_BODY_MAX];
+static size_t s_httpLen = 0;
+static bool s_httpReboot = true;
+static std::atomic<bool> s_httpPending(false);
+static AsyncWebServerRequest* s_httpOwner = nullptr;   // richiesta che sta riempiendo il buffer
+
+void serviceConfigApi()
+{
+    if (!s_httpPending.load(std::memory_order_acquire)) return;
 
-void setupConfigApi()
+    // Il parse copia i valori: il buffer si libera appena letto
+    ConfigApply applied;
+    Config saved;
+    const bool ok = persistAndApplyConfig(s_httpBody, s_httpLen, applied, saved);
+    const bool reboot = s_httpReboot;
+    s_httpPending.store(false, std::memory_order_release);
+
+    if (ok) finishConfigApply(applied, saved, reboot);
+}
+
+static void onConfigBody(AsyncWebServerRequest* req, uint8_t* data, size_t len, size_t index, size_t total)
 {
-    if (!mountFS(false)) {
-        mountFS(true);
+    if (index == 0) {
+        if (total > CONFIG_BODY_MAX) {
+            req->send(413, "application/json", "{\"error\":\"too_large\"}");
+            return;
+        }
+        if (s_httpPending.load(std::memory_order_acquire)) {
+            req->send(503, "application/json", "{\"error\":\"busy\"}");
+            return;
+        }
+        // Un upload abbandonato a metà non blocca il successivo
+        s_httpOwner = req;
     }
 
-    server.on("/api/config", HTTP_GET, [](AsyncWebServerRequest* req){
-        String json;
-        if (readFileToString(CONFIG_PATH, json))
-            req->send(200, "application/json", json);
-        else
-            req->send(200, "application/json", configToJson(config));
-    });
+    // Chunk di una richiesta già rifiutata o superata da un'altra
+    if (req != s_httpOwner || index + len > total) return;
 
-    server.on("/api/config", HTTP_POST, [](AsyncWebServerRequest* req){}, nullptr,
-        [](AsyncWebServerRequest* req, uint8_t* data, size_t len, size_t, size_t){
+    memcpy(s_httpBody + index, data, len);
+    if (index + len < total) return;
+    s_httpOwner = nullptr;
 
-            String body; body.reserve(len);
-            for (size_t i=0; i<len; i++) body += (char)data[i];
+    bool reboot = true;
+    if (req->hasParam("reboot", true)) {
+        reboot = req->getParam("reboot", true)->value() != "0";
+    }
 
-            bool reboot = true;
-            if (req->hasParam("reboot", true)) {
-                reboot = req->getParam("reboot", true)->value() != "0";
-            }
+    // Sintassi e limiti dei campi presenti, sui default: config appartiene a
+    // loop() e qui non si legge. Campi obbligatori, classe della modifica ed
+    // esito finale li decide serviceConfigApi() (ack su bonsai/ack/config)
+    Config candidate = getDefaultConfig();
+    if (!jsonToConfig(s_httpBody, total, candidate) || !ConfigSchema::validate(candidate, false)) {
+        req->send(400, "application/json", "{\"error\":\"invalid\"}");
+        return;
+    }
 
-            bool ok = applyAndPersistConfigJson(body, reboot);
-            if (ok) req->send(200, "application/json", "{\"status\":\"applied\"}");
-            else     req->send(400, "application/json", "{\"error\":\"invalid_or_write_failed\"}");
-        }
-    );
+    s_httpLen = total;
+    s_httpReboot = reboot;
+    s_httpPending.store(true, std::memory_order_release);
 
-    Serial.println("[🌐] API config pronta");
+    req->send(202, "application/json", "{\"status\":\"accepted\"}");
 }
 
 // ---------------------------------------------------------------------------
-// MQTT HANDLER
+// API HTTP
 // ---------------------------------------------------------------------------
 
-void handleMqttConfigCommands(char* topic, byte* payload, unsigned int length)
+void setupConfigApi()
 {
-    String msg; msg.reserve(length);
-    for (unsigned int i=0; i<length; i++) msg += (char)payload[i];
+    if (!mountFS(false)) {
+        mountFS(true);
+    }
 
-    String t(topic);
+    // Il config attivo: config.json è solo il seme e può essere vecchio
+    server.on("/api/config", HTTP_GET, [](AsyncWebServerRequest* req){
+        req->send(200, "application/json", configToJson(config));
+    });
 
-    if (t == "bonsai/config" || t == ("bonsai/config/" + deviceId)) {
-        applyAndPersistConfigJson(msg, true);
-        return;
-    }
+    server.on("/api/config", HTTP_POST, [](AsyncWebServerRequest* req){}, nullptr, onConfigBody);
 
-    if (t == "bonsai/command/config/update") {
-        applyAndPersistConfigJson(msg, true);
-    }
-    else if (t == "bonsai/command/restart") {
-        ESP.restart();
-    }
+    Serial.println("[🌐] API config pronta");
 }
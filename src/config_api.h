@@ -17,6 +17,8 @@
 #include <ESPAsyncWebServer.h>
 #include <PubSubClient.h>
 #include "config.h"
+#include "config_schema.h"
+#include "config_cache.h"
 
 // ---- extern dal tuo progetto
 extern AsyncWebServer server;
@@ -29,25 +31,39 @@ extern const char* CONFIG_PATH;
 
 // Helpers FS
 bool mountFS(bool formatOnFail = false);
-bool writeFileAtomic(const char* path, const String& data);
-bool readFileToString(const char* path, String& out);
 
-// JSON <-> Config
+// JSON <-> Config (parse con il filtro dello schema: chiavi sconosciute saltate)
 String configToJson(const Config& c);
+bool jsonToConfig(const char* json, size_t len, Config& out);
 bool jsonToConfig(const String& json, Config& out);
+bool jsonToConfig(Stream& in, Config& out);   // es. File aperto su CONFIG_PATH
 
-// Persistenza
+// Persistenza: il config salvato è quello in flash (ConfigCache); config.json
+// si importa al cold boot solo se è cambiato dall'ultimo import.
+// false = nessun config valido, out ai default. src = da dove arriva.
 bool saveConfigStruct(const Config& c);
-bool loadConfig(Config& out);
+bool loadConfig(Config& out, ConfigSource* src = nullptr);
 
-// Confronto parametri MQTT critici
-bool mqttCriticalChanged(const Config& a, const Config& b);
+// Dopo ogni modifica applicata in RAM (contesto di loop()): before = config precedente
+typedef void (*ConfigAppliedHook)(const Config& before);
+void setConfigAppliedHook(ConfigAppliedHook hook);
 
-// Applica + salva + ack + reboot
+// Parse + validazione + salvataggio + applicazione secondo la classe dei campi
+// cambiati, ack su bonsai/ack/config. saved = config scritto in flash.
+// I campi Restart in RAM restano quelli vecchi fino al riavvio; le modifiche
+// successive partono comunque da saved, non dal config in RAM.
+bool persistAndApplyConfig(const char* json, size_t len, ConfigApply& applied, Config& saved);
+
+// Snapshot retained di saved e, per Restart, riavvio (se allowRestart)
+void finishConfigApply(ConfigApply applied, const Config& saved, bool allowRestart);
+
+// persistAndApplyConfig + finishConfigApply; riavvia solo se serve
+bool applyAndPersistConfigJson(const char* json, size_t len, bool rebootAfter = true);
 bool applyAndPersistConfigJson(const String& json, bool rebootAfter = true);
 
+// Config ricevuti via HTTP: applicati da qui, nel contesto di loop()
+void serviceConfigApi();
+
 // API HTTP
 void setupConfigApi();
 
-// Gestione MQTT config
-void handleMqttConfigCommands(char* topic, byte* payload, unsigned int length);
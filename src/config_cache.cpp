@@ -0,0 +1,174 @@
+#include "config_cache.h"
+#include "record_store.h"
+#include <Preferences.h>
+
+static const char* NVS_NAMESPACE = "cfgcache";
+static const char* NVS_KEY = "img";
+static const char* NVS_SEED_KEY = "seed";
+
+static_assert(sizeof(ConfigImage) <= RecordStore::MAX_RECORD, "ConfigImage non entra in un record del kvstore");
+
+RTC_DATA_ATTR static ConfigImage s_rtcImage;
+
+// Buffer di lavoro statici: ~1 KB fuori dallo stack di setup()
+static ConfigImage s_flashImage;
+static ConfigImage s_newImage;
+
+// =======================================================
+// ======================= PACK/UNPACK ===================
+// =======================================================
+
+namespace ConfigCache {
+
+uint32_t crc32(const void* data, size_t len)
+{
+  return RecordStore::crc32(data, len);
+}
+
+bool pack(const Config& c, ConfigImage& img)
+{
+  memset(&img, 0, sizeof(img));
+  if (!ConfigSchema::toImage(c, img.data)) return false;
+  img.magic = MAGIC;
+  img.schema = ConfigSchema::fingerprint();
+  img.crc = crc32(img.data, sizeof(img.data));
+  return true;
+}
+
+bool unpack(const ConfigImage& img, Config& out)
+{
+  if (img.magic != MAGIC || img.schema != ConfigSchema::fingerprint()) return false;
+  if (img.crc != crc32(img.data, sizeof(img.data))) return false;
+  ConfigSchema::fromImage(img.data, out);
+  return true;
+}
+
+// =======================================================
+// ===================== RTC / FLASH =====================
+// =======================================================
+// Con la partizione kvstore ogni salvataggio è un append atomico; senza (tabella
+// partizioni vecchia, aggiornamento via OTA) resta NVS come prima.
+
+static bool readFlash(ConfigImage& img)
+{
+  if (RecordStore* kv = kvStore())
+    return kv->get(REC_CONFIG, &img, sizeof(img)) == (int)sizeof(img);
+
+  Preferences p;
+  if (!p.begin(NVS_NAMESPACE, true)) return false;
+  const bool ok = p.getBytesLength(NVS_KEY) == sizeof(img) &&
+                  p.getBytes(NVS_KEY, &img, sizeof(img)) == sizeof(img);
+  p.end();
+  return ok;
+}
+
+static bool writeFlash(const ConfigImage& img)
+{
+  if (RecordStore* kv = kvStore())
+    return kv->put(REC_CONFIG, &img, sizeof(img));
+
+  Preferences p;
+  if (!p.begin(NVS_NAMESPACE, false)) return false;
+  const bool ok = p.putBytes(NVS_KEY, &img, sizeof(img)) == sizeof(img);
+  p.end();
+  return ok;
+}
+
+ConfigSource flashSource()
+{
+  return kvStore() ? ConfigSource::Store : ConfigSource::Nvs;
+}
+
+bool restoreFlash(Config& out)
+{
+  if (!readFlash(s_flashImage) || !unpack(s_flashImage, out)) return false;
+  s_rtcImage = s_flashImage;   // il prossimo wake riparte dalla RTC
+  return true;
+}
+
+bool restore(Config& out, bool deepSleepWake, ConfigSource& src)
+{
+  // Cold boot (power-on, reset, flash di SPIFFS): passa da config.json
+  if (!deepSleepWake) return false;
+
+  if (unpack(s_rtcImage, out)) {
+    src = ConfigSource::Rtc;
+    return true;
+  }
+  if (restoreFlash(out)) {
+    src = flashSource();
+    return true;
+  }
+  return false;
+}
+
+bool store(const Config& c)
+{
+  if (!pack(c, s_newImage)) {
+    Serial.println("[CONFIG] Stringa troppo lunga per la cache binaria, cache disattivata");
+    invalidate();
+    return false;
+  }
+  s_rtcImage = s_newImage;
+
+  // Flash: riscritta solo quando il contenuto cambia
+  if (readFlash(s_flashImage) && s_flashImage.crc == s_newImage.crc &&
+      memcmp(&s_flashImage, &s_newImage, sizeof(s_newImage)) == 0)
+    return true;
+
+  return writeFlash(s_newImage);
+}
+
+void invalidate()
+{
+  s_rtcImage.magic = 0;
+  if (RecordStore* kv = kvStore()) {
+    kv->remove(REC_CONFIG);
+    return;
+  }
+  Preferences p;
+  if (p.begin(NVS_NAMESPACE, false)) {
+    p.remove(NVS_KEY);
+    p.end();
+  }
+}
+
+uint32_t jsonSeed()
+{
+  uint32_t crc = 0;
+  if (RecordStore* kv = kvStore()) {
+    if (kv->get(REC_CONFIG_SEED, &crc, sizeof(crc)) != (int)sizeof(crc)) return 0;
+    return crc;
+  }
+  Preferences p;
+  if (!p.begin(NVS_NAMESPACE, true)) return 0;
+  crc = p.getUInt(NVS_SEED_KEY, 0);
+  p.end();
+  return crc;
+}
+
+bool setJsonSeed(uint32_t crc)
+{
+  if (crc == jsonSeed()) return true;
+  if (RecordStore* kv = kvStore()) return kv->put(REC_CONFIG_SEED, &crc, sizeof(crc));
+
+  Preferences p;
+  if (!p.begin(NVS_NAMESPACE, false)) return false;
+  const bool ok = p.putUInt(NVS_SEED_KEY, crc) == sizeof(crc);
+  p.end();
+  return ok;
+}
+
+const char* sourceStr(ConfigSource s)
+{
+  switch (s) {
+    case ConfigSource::Rtc:      return "rtc";
+    case ConfigSource::Nvs:      return "nvs";
+    case ConfigSource::Json:     return "json";
+    case ConfigSource::Defaults: return "defaults";
+    case ConfigSource::Store:    return "kv";
+  }
+  return "?";
+}
+
+} // namespace ConfigCache
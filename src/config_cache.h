@@ -0,0 +1,53 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+#include "config_schema.h"
+
+// Da dove arriva il config di questo boot
+enum class ConfigSource : uint8_t {
+  Rtc,        // immagine in RTC slow memory (wake da deep sleep)
+  Nvs,        // copia in NVS (device senza partizione kvstore)
+  Json,       // /config.json su SPIFFS, importato perché cambiato
+  Defaults,   // nessuna delle precedenti
+  Store       // ultimo record nel kvstore (record_store.h)
+};
+
+struct ConfigImage {
+  uint32_t magic;
+  uint32_t schema;     // ConfigSchema::fingerprint() al momento della scrittura
+  uint32_t crc;        // CRC-32 di data
+  uint8_t  data[CONFIG_IMAGE_BYTES];   // layout di CONFIG_FIELDS
+};
+
+// Config validato in forma binaria: RTC memory per i wake da deep sleep (pochi
+// µs, niente SPIFFS né parse) e copia persistente in flash, che è il config
+// salvato: record versionati nel kvstore o, se la partizione manca, NVS.
+// /config.json è solo il seme: si importa al cold boot quando il suo CRC
+// cambia (primo flash, `uploadfs`), le modifiche via API/MQTT vanno in flash.
+namespace ConfigCache {
+  static const uint32_t MAGIC = 0x43464743;   // "CFGC"
+
+  // Solo sui wake da deep sleep: RTC, poi flash. false = serve il JSON
+  bool restore(Config& out, bool deepSleepWake, ConfigSource& src);
+
+  // Ultimo config salvato in flash (cold boot, config.json invariato o illeggibile)
+  bool restoreFlash(Config& out);
+  ConfigSource flashSource();   // Store o Nvs
+
+  // Dopo un load/salvataggio riuscito: RTC sempre, flash solo se cambiata.
+  // false se una stringa non entra nell'immagine o la scrittura fallisce.
+  bool store(const Config& c);
+
+  void invalidate();
+
+  // CRC del config.json importato per ultimo (0 = mai)
+  uint32_t jsonSeed();
+  bool setJsonSeed(uint32_t crc);
+
+  // ---- Parte pura (host-testabile) ----
+  bool pack(const Config& c, ConfigImage& img);
+  bool unpack(const ConfigImage& img, Config& out);   // controlla magic, schema, CRC
+  uint32_t crc32(const void* data, size_t len);
+
+  const char* sourceStr(ConfigSource s);
+}
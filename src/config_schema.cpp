@@ -0,0 +1,239 @@
+#include "config_schema.h"
+
+constexpr ConfigField ConfigSchemaTable::FIELDS[];
+
+namespace ConfigSchema {
+
+void applyDefaults(Config& c)
+{
+  for (const ConfigField& f : CONFIG_FIELDS) {
+    switch (f.type) {
+      case ConfigFieldType::Int:  c.*f.i = f.def; break;
+      case ConfigFieldType::Bool: c.*f.b = f.def != 0; break;
+      case ConfigFieldType::Str:  c.*f.s = f.defStr; break;
+    }
+  }
+}
+
+static bool reservedPin(int pin)
+{
+  return pin >= 6 && pin <= 11;   // Flash/PSRAM
+}
+
+// Limiti del singolo campo (senza l'obbligatorietà)
+static bool fieldValid(const ConfigField& f, const Config& c)
+{
+  switch (f.type) {
+    case ConfigFieldType::Int: {
+      const int v = c.*f.i;
+      if (v < f.min || v > f.max) return false;
+      return !((f.flags & CFG_PIN) && reservedPin(v));
+    }
+    case ConfigFieldType::Bool:
+      return true;
+    case ConfigFieldType::Str:
+      return (c.*f.s).length() <= (size_t)f.max;
+  }
+  return true;
+}
+
+bool validate(const Config& c, bool required)
+{
+  for (const ConfigField& f : CONFIG_FIELDS) {
+    if (!fieldValid(f, c)) return false;
+    if (required && (f.flags & CFG_REQUIRED) && f.type == ConfigFieldType::Str &&
+        (c.*f.s).length() == 0)
+      return false;
+  }
+  return true;
+}
+
+uint8_t sanitize(Config& c)
+{
+  uint8_t fixed = 0;
+  for (const ConfigField& f : CONFIG_FIELDS) {
+    if (fieldValid(f, c)) continue;
+    switch (f.type) {
+      case ConfigFieldType::Int:  c.*f.i = f.def; break;
+      case ConfigFieldType::Bool: c.*f.b = f.def != 0; break;
+      case ConfigFieldType::Str:  c.*f.s = f.defStr; break;
+    }
+    Serial.printf("[CONFIG] %s non valido, uso il default\n", f.name);
+    fixed++;
+  }
+  return fixed;
+}
+
+void toJson(const Config& c, JsonDocument& doc)
+{
+  for (const ConfigField& f : CONFIG_FIELDS) {
+    switch (f.type) {
+      case ConfigFieldType::Int:  doc[f.name] = c.*f.i; break;
+      case ConfigFieldType::Bool: doc[f.name] = c.*f.b; break;
+      case ConfigFieldType::Str:  doc[f.name] = c.*f.s; break;
+    }
+  }
+}
+
+void fromJson(const JsonDocument& doc, Config& out)
+{
+  for (const ConfigField& f : CONFIG_FIELDS) {
+    JsonVariantConst v = doc[f.name];
+    if (v.isNull()) continue;
+    switch (f.type) {
+      case ConfigFieldType::Int:  out.*f.i = v.as<int>(); break;
+      case ConfigFieldType::Bool: out.*f.b = v.as<bool>(); break;
+      case ConfigFieldType::Str:  out.*f.s = v.as<String>(); break;
+    }
+  }
+}
+
+const JsonDocument& filter()
+{
+  // Inizializzazione statica thread-safe: loop() e task AsyncTCP la condividono
+  static const StaticJsonDocument<CONFIG_FILTER_CAPACITY> s_filter = [] {
+    StaticJsonDocument<CONFIG_FILTER_CAPACITY> d;
+    for (const ConfigField& f : CONFIG_FIELDS) d[f.name] = true;
+    return d;
+  }();
+  return s_filter;
+}
+
+bool toImage(const Config& c, uint8_t* out)
+{
+  // Coda delle stringhe a zero: immagine (e CRC) deterministica
+  memset(out, 0, CONFIG_IMAGE_BYTES);
+  uint8_t* p = out;
+  for (const ConfigField& f : CONFIG_FIELDS) {
+    switch (f.type) {
+      case ConfigFieldType::Int: {
+        const int32_t v = c.*f.i;
+        memcpy(p, &v, sizeof(v));
+        p += sizeof(v);
+        break;
+      }
+      case ConfigFieldType::Bool:
+        *p++ = c.*f.b ? 1 : 0;
+        break;
+      case ConfigFieldType::Str: {
+        const String& s = c.*f.s;
+        if (s.length() > (size_t)f.max) return false;
+        memcpy(p, s.c_str(), s.length());
+        p += f.max + 1;
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+void fromImage(const uint8_t* in, Config& out)
+{
+  const uint8_t* p = in;
+  for (const ConfigField& f : CONFIG_FIELDS) {
+    switch (f.type) {
+      case ConfigFieldType::Int: {
+        int32_t v;
+        memcpy(&v, p, sizeof(v));
+        out.*f.i = v;
+        p += sizeof(v);
+        break;
+      }
+      case ConfigFieldType::Bool:
+        out.*f.b = *p++ != 0;
+        break;
+      case ConfigFieldType::Str:
+        // Terminatore garantito da toImage(); un'immagine corrotta non passa il CRC
+        out.*f.s = (const char*)p;
+        p += f.max + 1;
+        break;
+    }
+  }
+}
+
+uint32_t fingerprint()
+{
+  static uint32_t s_hash = 0;
+  if (s_hash) return s_hash;
+
+  // FNV-1a su nome, tipo e dimensione di ogni campo
+  uint32_t h = 2166136261UL;
+  auto mix = [&h](uint8_t b) { h = (h ^ b) * 16777619UL; };
+  for (const ConfigField& f : CONFIG_FIELDS) {
+    for (const char* n = f.name; *n; n++) mix((uint8_t)*n);
+    mix((uint8_t)f.type);
+    if (f.type == ConfigFieldType::Str) {
+      mix((uint8_t)f.max);
+      mix((uint8_t)(f.max >> 8));
+    }
+  }
+  s_hash = h ? h : 1;
+  return s_hash;
+}
+
+bool changed(const ConfigField& f, const Config& a, const Config& b)
+{
+  switch (f.type) {
+    case ConfigFieldType::Int:  return a.*f.i != b.*f.i;
+    case ConfigFieldType::Bool: return a.*f.b != b.*f.b;
+    case ConfigFieldType::Str:  return a.*f.s != b.*f.s;
+  }
+  return false;
+}
+
+ConfigApply applyClass(const Config& before, const Config& after)
+{
+  ConfigApply cls = ConfigApply::None;
+  for (const ConfigField& f : CONFIG_FIELDS) {
+    if (!changed(f, before, after)) continue;
+    const ConfigApply c = (f.flags & CFG_RESTART)   ? ConfigApply::Restart
+                        : (f.flags & CFG_RECONNECT) ? ConfigApply::Reconnect
+                                                    : ConfigApply::Live;
+    if (c > cls) cls = c;
+  }
+  return cls;
+}
+
+const char* applyStr(ConfigApply a)
+{
+  switch (a) {
+    case ConfigApply::None:      return "none";
+    case ConfigApply::Live:      return "live";
+    case ConfigApply::Reconnect: return "reconnect";
+    case ConfigApply::Restart:   return "restart";
+  }
+  return "?";
+}
+
+void update(Config& dst, const Config& src)
+{
+  for (const ConfigField& f : CONFIG_FIELDS) {
+    if (!changed(f, dst, src)) continue;
+    switch (f.type) {
+      case ConfigFieldType::Int:  dst.*f.i = src.*f.i; break;
+      case ConfigFieldType::Bool: dst.*f.b = src.*f.b; break;
+      case ConfigFieldType::Str:  dst.*f.s = src.*f.s; break;
+    }
+  }
+}
+
+void copyFlagged(Config& dst, const Config& src, uint8_t flags)
+{
+  for (const ConfigField& f : CONFIG_FIELDS) {
+    if (!(f.flags & flags)) continue;
+    switch (f.type) {
+      case ConfigFieldType::Int:  dst.*f.i = src.*f.i; break;
+      case ConfigFieldType::Bool: dst.*f.b = src.*f.b; break;
+      case ConfigFieldType::Str:  dst.*f.s = src.*f.s; break;
+    }
+  }
+}
+
+const ConfigField* find(const char* name)
+{
+  for (const ConfigField& f : CONFIG_FIELDS)
+    if (strcmp(f.name, name) == 0) return &f;
+  return nullptr;
+}
+
+} // namespace ConfigSchema
@@ -0,0 +1,228 @@
+#pragma once
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+// =======================================================
+// ===================== SCHEMA CONFIG ===================
+// =======================================================
+//
+// Unica descrizione dei campi di Config: nome JSON, membro, tipo, default e
+// limiti. configToJson, jsonToConfig, publishConfigSnapshot, getDefaultConfig,
+// validateConfig e l'immagine binaria di ConfigCache girano tutti su questa
+// tabella; un campo nuovo va aggiunto a Config e qui, nient'altro.
+
+enum class ConfigFieldType : uint8_t { Int, Bool, Str };
+
+static const uint8_t CFG_PIN       = 0x01;   // GPIO 0..39, esclusi i pin della flash (6..11)
+static const uint8_t CFG_REQUIRED  = 0x02;   // stringa non vuota
+
+// Come si applica una modifica a runtime (senza flag: subito, sul posto)
+static const uint8_t CFG_RECONNECT = 0x04;   // nuova connessione al broker MQTT
+static const uint8_t CFG_RESTART   = 0x08;   // WiFi, pin, rete statica, webserver: al riavvio
+
+// Costo crescente: una modifica vale quanto il campo più costoso che tocca
+enum class ConfigApply : uint8_t {
+  None,        // nessun campo cambiato
+  Live,        // già attiva in config
+  Reconnect,   // attiva dopo la riconnessione MQTT
+  Restart      // salvata, attiva dal prossimo boot
+};
+
+struct ConfigField {
+  const char*      name;
+  ConfigFieldType  type;
+  uint8_t          flags;
+  int Config::*    i;
+  bool Config::*   b;
+  String Config::* s;
+  int32_t          def;      // Int, Bool
+  int32_t          min;      // Int
+  int32_t          max;      // Int; Str: lunghezza massima
+  const char*      defStr;   // Str
+};
+
+constexpr ConfigField cfgInt(const char* n, int Config::* m, int32_t def, int32_t lo, int32_t hi, uint8_t flags = 0)
+{
+  return { n, ConfigFieldType::Int, flags, m, nullptr, nullptr, def, lo, hi, nullptr };
+}
+
+constexpr ConfigField cfgBool(const char* n, bool Config::* m, bool def, uint8_t flags = 0)
+{
+  return { n, ConfigFieldType::Bool, flags, nullptr, m, nullptr, def ? 1 : 0, 0, 1, nullptr };
+}
+
+constexpr ConfigField cfgStr(const char* n, String Config::* m, const char* def, int32_t maxLen, uint8_t flags = 0)
+{
+  return { n, ConfigFieldType::Str, flags, nullptr, nullptr, m, 0, 0, maxLen, def };
+}
+
+// Membro statico: un'unica copia in flash (definita in config_schema.cpp)
+// anche se l'header è incluso da più unità
+struct ConfigSchemaTable {
+  static constexpr ConfigField FIELDS[] = {
+    // WiFi
+    cfgStr("wifi_ssid",     &Config::wifi_ssid,     "", 32, CFG_REQUIRED | CFG_RESTART),   // 802.11
+    cfgStr("wifi_password", &Config::wifi_password, "", 64, CFG_RESTART),                  // WPA2: 63 + PSK esadecimale
+
+    // MQTT
+    cfgStr("mqtt_broker",   &Config::mqtt_broker,   "", 128, CFG_RECONNECT),
+    cfgInt("mqtt_port",     &Config::mqtt_port,     1883, 1, 65535, CFG_RECONNECT),
+    cfgStr("mqtt_username", &Config::mqtt_username, "", 128, CFG_RECONNECT),
+    cfgStr("mqtt_password", &Config::mqtt_password, "", 256, CFG_RECONNECT),   // anche token di accesso
+    cfgBool("mqtt_persistent_session", &Config::mqtt_persistent_session, true, CFG_RECONNECT),  // raggiungibile anche mentre dorme
+    cfgBool("telemetry_binary",        &Config::telemetry_binary, false),        // topic testuali (dashboard)
+
+    // Report a deadband (deadband 0 = qualunque variazione)
+    cfgInt("report_heartbeat_s",       &Config::report_heartbeat_s,       300, 0, 86400),
+    cfgInt("report_deadband_humidity", &Config::report_deadband_humidity, 2,   0, 100),   // %
+    cfgInt("report_deadband_rssi",     &Config::report_deadband_rssi,     5,   0, 100),   // dBm
+    cfgInt("report_deadband_battery",  &Config::report_deadband_battery,  50,  0, 4095),  // mV sul pin
+
+    // Hardware
+    cfgInt("led_pin",     &Config::led_pin,     4,  0, 39, CFG_PIN | CFG_RESTART),
+    cfgInt("sensor_pin",  &Config::sensor_pin,  32, 0, 39, CFG_PIN | CFG_RESTART),
+    cfgInt("pump_pin",    &Config::pump_pin,    26, 0, 39, CFG_PIN | CFG_RESTART),
+    cfgInt("relay_pin",   &Config::relay_pin,   27, 0, 39, CFG_PIN | CFG_RESTART),
+    cfgInt("battery_pin", &Config::battery_pin, 34, 0, 39, CFG_PIN | CFG_RESTART),
+
+    // Logica irrigazione
+    cfgInt("moisture_threshold",   &Config::moisture_threshold,   25, 0, 100),
+    cfgInt("pump_duration",        &Config::pump_duration,        5,  0, 3600),        // max 1 ora
+    cfgInt("irrigation_pulse_s",   &Config::irrigation_pulse_s,   0,  0, 3600),        // un impulso da pump_duration
+    cfgInt("irrigation_soak_s",    &Config::irrigation_soak_s,    30, 0, 600),
+    cfgInt("irrigation_target",    &Config::irrigation_target,    0,  0, 100),         // moisture_threshold + 10
+    cfgInt("measurement_interval", &Config::measurement_interval, 1800000, 0, INT32_MAX),  // 30 minuti
+    cfgBool("use_pump",          &Config::use_pump, true),
+    cfgBool("debug",             &Config::debug, false),
+    cfgBool("enable_webserver",  &Config::enable_webserver, false, CFG_RESTART),   // risparmio energia
+    cfgInt("webserver_timeout",  &Config::webserver_timeout, 60, 0, INT32_MAX),
+
+    // Sleep
+    cfgInt("sleep_hours",       &Config::sleep_hours,       0,  0, 24),     // no sleep di default
+    cfgInt("maintenance_wakes", &Config::maintenance_wakes, 0,  0, 168),    // max 1 settimana a 1 h
+    cfgBool("adaptive_sleep",   &Config::adaptive_sleep, false),
+    cfgInt("sleep_max_hours",   &Config::sleep_max_hours,   12, 0, 24),
+    cfgInt("low_battery_mv",    &Config::low_battery_mv,    0,  0, 3300),   // dipende dal partitore
+    cfgBool("ulp_monitor",      &Config::ulp_monitor, false),
+
+    // Rete statica
+    cfgBool("use_dhcp",  &Config::use_dhcp, true, CFG_RESTART),
+    cfgStr("ip_address", &Config::ip_address, "", 15, CFG_RESTART),
+    cfgStr("gateway",    &Config::gateway,    "", 15, CFG_RESTART),
+    cfgStr("subnet",     &Config::subnet,     "", 15, CFG_RESTART),
+
+    // OTA / Update
+    cfgStr("ota_manifest_url", &Config::ota_manifest_url, "", 256),
+    cfgStr("update_server",    &Config::update_server,    "", 256),
+    cfgStr("config_version",   &Config::config_version,   "", 32),
+
+    // Timezone (IANA o POSIX)
+    cfgStr("timezone", &Config::timezone, "Europe/Rome", 64),
+  };
+};
+
+static constexpr auto& CONFIG_FIELDS = ConfigSchemaTable::FIELDS;
+
+static constexpr size_t CONFIG_FIELD_COUNT = sizeof(CONFIG_FIELDS) / sizeof(CONFIG_FIELDS[0]);
+
+// ---- Dimensioni calcolate dalla tabella (ricorsione: constexpr C++11) ----
+
+constexpr size_t cfgCstrLen(const char* s)
+{
+  return *s ? 1 + cfgCstrLen(s + 1) : 0;
+}
+
+// Byte di stringa copiati nel documento: valori (e chiavi, nel parse)
+constexpr size_t cfgStringBytes(bool keys, size_t i = 0)
+{
+  return i == CONFIG_FIELD_COUNT ? 0
+       : (CONFIG_FIELDS[i].type == ConfigFieldType::Str ? (size_t)CONFIG_FIELDS[i].max + 1 : 0) +
+         (keys ? cfgCstrLen(CONFIG_FIELDS[i].name) + 1 : 0) +
+         cfgStringBytes(keys, i + 1);
+}
+
+constexpr size_t cfgImageBytes(size_t i = 0)
+{
+  return i == CONFIG_FIELD_COUNT ? 0
+       : (CONFIG_FIELDS[i].type == ConfigFieldType::Int  ? sizeof(int32_t)
+        : CONFIG_FIELDS[i].type == ConfigFieldType::Bool ? 1
+        : (size_t)CONFIG_FIELDS[i].max + 1) +
+         cfgImageBytes(i + 1);
+}
+
+// Testo JSON compatto del config più lungo ammesso: {"k":v,...}
+constexpr size_t cfgJsonTextBytes(size_t i = 0)
+{
+  return i == CONFIG_FIELD_COUNT ? 2
+       : cfgCstrLen(CONFIG_FIELDS[i].name) + 4 +                   // "k":  e la virgola
+         (CONFIG_FIELDS[i].type == ConfigFieldType::Int  ? 11      // -2147483648
+        : CONFIG_FIELDS[i].type == ConfigFieldType::Bool ? 5       // false
+        : (size_t)CONFIG_FIELDS[i].max + 2) +                      // "..."
+         cfgJsonTextBytes(i + 1);
+}
+
+// Serializzazione: chiavi const char* non copiate, valori String sì
+static constexpr size_t CONFIG_JSON_CAPACITY =
+    JSON_OBJECT_SIZE(CONFIG_FIELD_COUNT) + cfgStringBytes(false);
+
+// Parse (File, buffer MQTT/HTTP): ArduinoJson copia chiavi e valori, ma il
+// filtro della tabella scarta le chiavi sconosciute senza allocarle
+static constexpr size_t CONFIG_PARSE_CAPACITY =
+    JSON_OBJECT_SIZE(CONFIG_FIELD_COUNT) + cfgStringBytes(true);
+
+// Filtro: chiavi const char* della tabella, nessuna copia
+static constexpr size_t CONFIG_FILTER_CAPACITY = JSON_OBJECT_SIZE(CONFIG_FIELD_COUNT);
+
+// Body di POST /api/config: config completo più spazi, escape e chiavi extra
+static constexpr size_t CONFIG_TEXT_SLACK = 256;
+static constexpr size_t CONFIG_BODY_MAX = cfgJsonTextBytes() + CONFIG_TEXT_SLACK;
+
+// Immagine binaria (ConfigCache): int32, bool in un byte, stringhe a lunghezza fissa
+static constexpr size_t CONFIG_IMAGE_BYTES = cfgImageBytes();
+
+// I documenti stanno sullo stack di loop() e del task AsyncTCP
+static_assert(CONFIG_PARSE_CAPACITY <= 4096, "Config schema troppo grande per StaticJsonDocument");
+
+namespace ConfigSchema {
+  void applyDefaults(Config& c);
+
+  // Limiti, pin riservati, lunghezze e (se required) campi obbligatori
+  bool validate(const Config& c, bool required = true);
+
+  // Riporta al default solo i campi fuori dai propri limiti, con il nome nel
+  // log: un valore sbagliato non costa il resto del config. Campi corretti.
+  // I campi obbligatori vuoti restano tali (il default è vuoto).
+  uint8_t sanitize(Config& c);
+
+  // Tutti i campi nel documento (chiavi per puntatore, valori copiati)
+  void toJson(const Config& c, JsonDocument& doc);
+
+  // Solo le chiavi presenti e non null: una lookup per campo
+  void fromJson(const JsonDocument& doc, Config& out);
+
+  // {"nome":true,...} per DeserializationOption::Filter, costruito una volta
+  const JsonDocument& filter();
+
+  // Immagine binaria a layout fisso; false se una stringa supera il suo max
+  bool toImage(const Config& c, uint8_t* out);
+  void fromImage(const uint8_t* in, Config& out);
+
+  // Hash di nomi, tipi e dimensioni: cambia quando cambia la tabella
+  uint32_t fingerprint();
+
+  const ConfigField* find(const char* name);
+
+  bool changed(const ConfigField& f, const Config& a, const Config& b);
+
+  // Classe della modifica before → after (la più costosa tra i campi cambiati)
+  ConfigApply applyClass(const Config& before, const Config& after);
+  const char* applyStr(ConfigApply a);
+
+  // Copia in dst solo i campi diversi: le String invariate (broker, credenziali
+  // lette dal worker MQTT) non vengono riscritte
+  void update(Config& dst, const Config& src);
+
+  // Copia in dst i campi di src che hanno uno dei flag (es. CFG_RESTART)
+  void copyFlagged(Config& dst, const Config& src, uint8_t flags);
+}
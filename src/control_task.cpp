@@ -0,0 +1,334 @@
+#include "control_task.h"
+#include "pump_controller.h"
+#include "soil_filter.h"
+#include "adc_sampler.h"
+#include "spsc_queue.h"
+#include <atomic>
+
+extern "C" {
+  #include "esp_task_wdt.h"
+}
+
+extern Config config;
+extern PumpController* pumpController;
+
+static SpscQueue<ControlCmd, 16> s_cmd[(size_t)ControlSource::Count];
+static SpscQueue<ControlEvent, 16> s_evt;
+
+static std::atomic<uint32_t> s_appSent(0);
+static std::atomic<uint32_t> s_appApplied(0);
+
+static std::atomic<bool> s_pumpOn(false);
+static std::atomic<bool> s_emergency(false);
+static std::atomic<bool> s_irrigating(false);
+
+// Creato al primo Irrigate (pumpController esiste già)
+static IrrigationController* s_irrigation = nullptr;
+static int s_lastSoilPct = -1;
+
+static std::atomic<uint32_t> s_iterations(0);
+static std::atomic<uint32_t> s_jitterAvgUs(0);
+static std::atomic<uint32_t> s_jitterMaxUs(0);
+static std::atomic<uint32_t> s_cmdDropped(0);
+static std::atomic<uint32_t> s_evtDropped(0);
+
+// Campionamento non bloccante: raffica DMA se disponibile, altrimenti una
+// analogRead ogni SOIL_SAMPLE_SPACING_MS
+static bool s_soilActive = false;
+static bool s_soilDma = false;
+static uint8_t s_soilCount = 0;
+static uint32_t s_soilNextMs = 0;
+static int s_soilBuf[ControlTask::SOIL_SAMPLES];
+
+static bool s_started = false;
+
+// =======================================================
+// ======================== EVENTI =======================
+// =======================================================
+
+static void emit(ControlEventType type, uint32_t now, int raw = 0, int pct = 0, int batteryMv = 0)
+{
+  ControlEvent ev;
+  ev.type = type;
+  ev.soilRaw = (int16_t)raw;
+  ev.soilPct = (int16_t)pct;
+  ev.batteryMv = (uint16_t)batteryMv;
+  ev.samples = 0;
+  ev.outliers = 0;
+  ev.ms = now;
+  if (!s_evt.push(ev)) s_evtDropped++;
+}
+
+static void publishState()
+{
+  if (!pumpController) return;
+  s_pumpOn.store(pumpController->getState(), std::memory_order_release);
+  s_emergency.store(pumpController->isEmergencyStop(), std::memory_order_release);
+  s_irrigating.store(s_irrigation && s_irrigation->active(), std::memory_order_release);
+}
+
+// Dal task esp_timer: lo stato è visibile subito agli altri task, l'evento
+// EmergencyStop parte dal prossimo step() (≤ PERIOD_MS)
+static void onPumpCutoff(void*)
+{
+  s_pumpOn.store(false, std::memory_order_release);
+  s_emergency.store(true, std::memory_order_release);
+}
+
+static void startSample(uint32_t now)
+{
+  if (s_soilActive) return;
+  s_soilActive = true;
+  s_soilDma = AdcSampler::start();
+  s_soilCount = 0;
+  s_soilNextMs = now;
+}
+
+// Impulsi della sessione: stessi eventi pompa dei comandi manuali (il
+// failsafe resta solo EmergencyStop), più IrrigationDone a fine sessione
+static void irrigationEvents(bool pumpWasOn, uint32_t now)
+{
+  const bool on = pumpController->getState();
+  if (on && !pumpWasOn) emit(ControlEventType::PumpOn, now);
+  else if (!on && pumpWasOn && !pumpController->isEmergencyStop()) emit(ControlEventType::PumpOff, now);
+
+  if (s_irrigation->takeFinished()) {
+    const IrrigationStats& st = s_irrigation->stats();
+    emit(ControlEventType::IrrigationDone, now, 0, st.endPct);
+  }
+}
+
+static void abortIrrigation(uint32_t now)
+{
+  if (!s_irrigation || !s_irrigation->active()) return;
+  const bool wasOn = pumpController->getState();
+  s_irrigation->abort(now);
+  irrigationEvents(wasOn, now);
+}
+
+// =======================================================
+// ======================= CONTROLLO =====================
+// =======================================================
+
+static void apply(ControlCmd cmd, uint32_t now)
+{
+  switch (cmd) {
+    case ControlCmd::PumpOn:
+      // Il comando manuale prende il posto della sessione in corso
+      abortIrrigation(now);
+      if (pumpController && pumpController->turnOn()) emit(ControlEventType::PumpOn, now);
+      break;
+
+    case ControlCmd::PumpOff:
+      abortIrrigation(now);
+      if (pumpController && pumpController->turnOff()) emit(ControlEventType::PumpOff, now);
+      break;
+
+    case ControlCmd::SampleSoil:
+      startSample(now);
+      break;
+
+    case ControlCmd::Irrigate: {
+      if (!pumpController) break;
+      if (!s_irrigation) s_irrigation = new IrrigationController(pumpController);
+      const bool wasOn = pumpController->getState();
+      s_irrigation->start(IrrigationController::paramsFromConfig(config), s_lastSoilPct, now);
+      irrigationEvents(wasOn, now);
+      break;
+    }
+  }
+}
+
+static void soilDone(uint32_t now, int raw, int batteryMv, uint16_t samples, uint16_t outliers)
+{
+  s_lastSoilPct = soilRawToPercent(raw);
+  ControlEvent ev;
+  ev.type = ControlEventType::SoilSample;
+  ev.soilRaw = (int16_t)raw;
+  ev.soilPct = (int16_t)s_lastSoilPct;
+  ev.batteryMv = (uint16_t)batteryMv;
+  ev.samples = (uint8_t)min<uint16_t>(samples, 255);
+  ev.outliers = (uint8_t)min<uint16_t>(outliers, 255);
+  ev.ms = now;
+  if (!s_evt.push(ev)) s_evtDropped++;
+
+  // Misura dopo il soak: la sessione decide se serve un altro impulso
+  if (s_irrigation && s_irrigation->phase() == IrrigationPhase::Measure) {
+    const bool wasOn = pumpController->getState();
+    s_irrigation->onSoilSample(s_lastSoilPct, now);
+    irrigationEvents(wasOn, now);
+  }
+}
+
+static void soilTick(uint32_t now)
+{
+  if (!s_soilActive) return;
+
+  if (s_soilDma) {
+    AdcReading r;
+    switch (AdcSampler::poll(r)) {
+      case AdcBurst::Pending:
+        return;
+      case AdcBurst::Done:
+        s_soilActive = false;
+        soilDone(now, r.soilRaw, r.batteryMv, r.samples, r.outliers);
+        return;
+      case AdcBurst::Failed:
+        s_soilDma = false;   // questa misura prosegue con analogRead
+        s_soilNextMs = now;
+        break;
+    }
+  }
+
+  if ((int32_t)(now - s_soilNextMs) < 0) return;
+
+  s_soilBuf[s_soilCount++] = analogRead(config.sensor_pin);
+  s_soilNextMs = now + ControlTask::SOIL_SAMPLE_SPACING_MS;
+  if (s_soilCount < ControlTask::SOIL_SAMPLES) return;
+
+  // Mediana: regge fino a 2 spike su 5
+  const int raw = soilFilterSamples(s_soilBuf, ControlTask::SOIL_SAMPLES);
+  s_soilActive = false;
+  soilDone(now, raw, (int)analogReadMilliVolts(config.battery_pin), ControlTask::SOIL_SAMPLES, 0);
+}
+
+#if CONTROL_ASYNC_TASK
+// Core 1 insieme a loop() ma a priorità più alta: WiFi, lwIP, worker MQTT e
+// AsyncTCP restano sul core 0, OTA/Telnet in loop() vengono prelazionati.
+static const uint32_t CONTROL_TASK_STACK = 3072;
+static const UBaseType_t CONTROL_TASK_PRIORITY = 5;
+static const BaseType_t CONTROL_TASK_CORE = 1;
+
+static void recordPeriod(uint32_t periodUs)
+{
+  const uint32_t expected = ControlTask::PERIOD_MS * 1000UL;
+  const uint32_t jitter = periodUs > expected ? periodUs - expected : expected - periodUs;
+  if (jitter > s_jitterMaxUs) s_jitterMaxUs = jitter;
+  const uint32_t avg = s_jitterAvgUs;
+  s_jitterAvgUs = s_iterations <= 1 ? jitter : avg - (avg >> 3) + (jitter >> 3);
+}
+
+static void controlTask(void*)
+{
+  esp_task_wdt_add(NULL);
+
+  TickType_t wake = xTaskGetTickCount();
+  uint32_t prevUs = micros();
+  for (;;)
+  {
+    vTaskDelayUntil(&wake, pdMS_TO_TICKS(ControlTask::PERIOD_MS));
+    const uint32_t nowUs = micros();
+    ControlTask::step();
+    recordPeriod(nowUs - prevUs);
+    prevUs = nowUs;
+    esp_task_wdt_reset();
+  }
+}
+#endif
+
+namespace ControlTask {
+
+void step()
+{
+  const uint32_t now = millis();
+
+  ControlCmd cmd;
+  while (s_cmd[(size_t)ControlSource::Web].pop(cmd)) apply(cmd, now);
+
+  // Il contatore App avanza solo dopo apply + publishState: synced() implica stato aggiornato
+  uint32_t applied = 0;
+  while (s_cmd[(size_t)ControlSource::App].pop(cmd)) {
+    apply(cmd, now);
+    applied++;
+  }
+
+  if (pumpController) {
+    const bool wasStopped = pumpController->isEmergencyStop();
+    pumpController->loop();
+    if (!wasStopped && pumpController->isEmergencyStop())
+      emit(ControlEventType::EmergencyStop, now);
+  }
+
+  if (s_irrigation && s_irrigation->active()) {
+    const bool wasOn = pumpController->getState();
+    if (s_irrigation->loop(now)) startSample(now);
+    irrigationEvents(wasOn, now);
+  }
+
+  soilTick(now);
+  publishState();
+  if (applied) s_appApplied.fetch_add(applied, std::memory_order_release);
+  s_iterations++;
+}
+
+void begin()
+{
+  if (pumpController) pumpController->setCutoffListener(onPumpCutoff, nullptr);
+  publishState();
+  if (s_started) return;
+  s_started = true;
+  AdcSampler::begin(config.sensor_pin, config.battery_pin);
+#if CONTROL_ASYNC_TASK
+  xTaskCreatePinnedToCore(controlTask, "control", CONTROL_TASK_STACK, nullptr,
+                          CONTROL_TASK_PRIORITY, nullptr, CONTROL_TASK_CORE);
+#endif
+}
+
+bool send(ControlCmd cmd, ControlSource src)
+{
+  // Prima del push: il task può applicare il comando prima che push() ritorni
+  const bool app = src == ControlSource::App;
+  if (app) s_appSent++;
+  if (!s_cmd[(size_t)src].push(cmd)) {
+    if (app) s_appSent--;
+    s_cmdDropped++;
+    return false;
+  }
+#if !CONTROL_ASYNC_TASK
+  step();
+#endif
+  return true;
+}
+
+bool synced()
+{
+  return s_appApplied.load(std::memory_order_acquire) == s_appSent.load(std::memory_order_relaxed);
+}
+
+bool pollEvent(ControlEvent& ev)
+{
+  return s_evt.pop(ev);
+}
+
+bool pumpOn()
+{
+  return s_pumpOn.load(std::memory_order_acquire);
+}
+
+bool emergencyStop()
+{
+  return s_emergency.load(std::memory_order_acquire);
+}
+
+bool irrigating()
+{
+  return s_irrigating.load(std::memory_order_acquire);
+}
+
+IrrigationStats irrigationStats()
+{
+  return s_irrigation ? s_irrigation->stats() : IrrigationStats();
+}
+
+ControlStats stats()
+{
+  ControlStats st;
+  st.iterations = s_iterations;
+  st.jitterAvgUs = s_jitterAvgUs;
+  st.jitterMaxUs = s_jitterMaxUs;
+  st.cmdDropped = s_cmdDropped;
+  st.evtDropped = s_evtDropped;
+  return st;
+}
+
+} // namespace ControlTask
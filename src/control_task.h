@@ -0,0 +1,85 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+#include "irrigation_controller.h"
+
+// 1 = sensore e pompa in un task FreeRTOS dedicato sul core 1, a priorità
+//     sopra loop(): failsafe e campionamento non aspettano mai rete o web.
+// 0 = step() eseguito inline a ogni comando (env native, test deterministici).
+#ifdef NATIVE_BUILD
+  #define CONTROL_ASYNC_TASK 0
+#else
+  #define CONTROL_ASYNC_TASK 1
+#endif
+
+enum class ControlCmd : uint8_t {
+  PumpOn,
+  PumpOff,
+  SampleSoil,   // raffica DMA sensore + batteria (fallback: 5 analogRead a 50 ms) → SoilSample
+  Irrigate,     // sessione a impulsi/soak (irrigation_controller.h); PumpOn/PumpOff la interrompono
+};
+
+// Ogni produttore ha la sua coda SPSC verso il task di controllo
+enum class ControlSource : uint8_t {
+  App,   // loop(): boot stage, comandi MQTT
+  Web,   // task AsyncTCP: /api/pump/*
+  Count
+};
+
+enum class ControlEventType : uint8_t {
+  PumpOn,
+  PumpOff,         // comando o fine irrigazione (non il failsafe)
+  EmergencyStop,   // failsafe max-run: pompa spenta
+  SoilSample,
+  IrrigationDone,  // statistiche in ControlTask::irrigationStats()
+};
+
+// Dal task di controllo verso loop() (che pubblica e aggiorna i globali)
+struct ControlEvent {
+  ControlEventType type;
+  int16_t  soilRaw;     // solo SoilSample
+  int16_t  soilPct;
+  uint16_t batteryMv;   // mV calibrati (eFuse) sul pin, a valle dell'eventuale partitore
+  uint8_t  samples;     // solo SoilSample: campioni per canale (raffica DMA o analogRead)
+  uint8_t  outliers;    // campioni sostituiti dal filtro Hampel (0 con analogRead)
+  uint32_t ms;
+};
+
+struct ControlStats {
+  uint32_t iterations;
+  uint32_t jitterAvgUs;   // |periodo reale - PERIOD_MS| (EWMA 1/8)
+  uint32_t jitterMaxUs;
+  uint32_t cmdDropped;    // code comandi piene
+  uint32_t evtDropped;    // loop() non ha consumato gli eventi in tempo
+};
+
+// Task di controllo: unico proprietario di pumpController e del pin sensore
+// dopo begin(). Stato letto dagli altri task tramite atomici.
+namespace ControlTask {
+  static const uint32_t PERIOD_MS = 10;
+  static const uint8_t  SOIL_SAMPLES = 5;
+  static const uint32_t SOIL_SAMPLE_SPACING_MS = 50;
+
+  // Dopo esp_task_wdt_init() e la creazione/ripristino di pumpController
+  void begin();
+
+  // Non blocca; false se la coda di `src` è piena
+  bool send(ControlCmd cmd, ControlSource src = ControlSource::App);
+
+  // true quando tutti i comandi App inviati sono stati applicati
+  bool synced();
+
+  // Solo da loop()
+  bool pollEvent(ControlEvent& ev);
+
+  // Un giro del controllo: comandi, failsafe pompa, campionamento
+  void step();
+
+  bool pumpOn();
+  bool emergencyStop();
+  bool irrigating();
+
+  // Valide dopo l'evento IrrigationDone, fino al prossimo Irrigate
+  IrrigationStats irrigationStats();
+  ControlStats stats();
+}
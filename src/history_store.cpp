@@ -0,0 +1,393 @@
+#include "history_store.h"
+#include "record_store.h"   // RecordStore::crc32
+
+static const uint32_t SECTOR_MAGIC = 0x54534948;   // "HIST"
+static const uint32_t NO_TIME = 0xFFFFFFFFUL;      // slot mai scritto
+
+struct SectorHeader {
+  uint32_t magic;
+  uint32_t epoch;
+  uint32_t reserved[2];
+};
+static_assert(sizeof(SectorHeader) == HistoryStore::HEADER, "header di settore");
+
+static uint32_t recordCrc(const HistoryRecord& r)
+{
+  return RecordStore::crc32(&r, offsetof(HistoryRecord, crc));
+}
+
+bool HistoryStore::valid(const HistoryRecord& r)
+{
+  return r.t != NO_TIME && r.crc == recordCrc(r);
+}
+
+// =======================================================
+// ======================== APERTURA =====================
+// =======================================================
+
+HistoryStore::HistoryStore(const esp_partition_t* part)
+    : part_(part), sectors_(part ? (uint16_t)(part->size / SECTOR) : 0) {}
+
+uint32_t HistoryStore::readTime(uint16_t sector, uint32_t slot) const
+{
+  uint32_t t = NO_TIME;
+  esp_partition_read(part_, sector * SECTOR + HEADER + slot * sizeof(HistoryRecord), &t, sizeof(t));
+  return t;
+}
+
+uint16_t HistoryStore::sectorOf(uint32_t epoch) const
+{
+  return (uint16_t)((head_ + sectors_ - (headEpoch_ - epoch) % sectors_) % sectors_);
+}
+
+bool HistoryStore::begin()
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  ready_ = false;
+  if (!part_ || sectors_ < 2 || sectors_ > MAX_SECTORS) return false;
+
+  // Head = epoch più alta; indietro finché le epoch sono consecutive
+  bool any = false;
+  for (uint16_t s = 0; s < sectors_; s++) {
+    SectorHeader h;
+    if (esp_partition_read(part_, s * SECTOR, &h, sizeof(h)) != ESP_OK) continue;
+    if (h.magic != SECTOR_MAGIC) continue;
+    if (!any || h.epoch > headEpoch_) {
+      head_ = s;
+      headEpoch_ = h.epoch;
+    }
+    any = true;
+  }
+  if (!any) return format();
+
+  used_ = 1;
+  while (used_ < sectors_) {
+    const uint16_t prev = (uint16_t)((head_ + sectors_ - used_) % sectors_);
+    SectorHeader h;
+    if (esp_partition_read(part_, prev * SECTOR, &h, sizeof(h)) != ESP_OK) break;
+    if (h.magic != SECTOR_MAGIC || h.epoch != headEpoch_ - used_) break;
+    used_++;
+  }
+
+  // Indice dei blocchi: una lettura per settore
+  for (uint16_t n = 0; n < used_; n++) {
+    const uint16_t s = sectorOf(headEpoch_ - n);
+    firstT_[s] = readTime(s, 0);
+  }
+
+  // Slot liberi in coda al settore head: bisezione sul primo non scritto
+  uint32_t lo = 0, hi = RECORDS_PER_SECTOR;
+  while (lo < hi) {
+    const uint32_t mid = (lo + hi) / 2;
+    if (readTime(head_, mid) == NO_TIME) hi = mid;
+    else lo = mid + 1;
+  }
+  writeSlot_ = lo;
+
+  // Ultimo t valido: da qui append() non torna indietro
+  lastT_ = 0;
+  const uint32_t first = firstLocked();
+  for (uint32_t seq = endLocked(); seq > first && endLocked() - seq < RECORDS_PER_SECTOR;) {
+    seq--;
+    HistoryRecord r;
+    const uint16_t s = sectorOf(seq / RECORDS_PER_SECTOR);
+    if (esp_partition_read(part_, s * SECTOR + HEADER + (seq % RECORDS_PER_SECTOR) * sizeof(r), &r, sizeof(r)) != ESP_OK)
+      break;
+    if (valid(r)) {
+      lastT_ = r.t;
+      break;
+    }
+  }
+
+  ready_ = true;
+  return true;
+}
+
+bool HistoryStore::format()
+{
+  if (esp_partition_erase_range(part_, 0, SECTOR) != ESP_OK) return false;
+  const SectorHeader h = { SECTOR_MAGIC, 1, { 0, 0 } };
+  if (esp_partition_write(part_, 0, &h, sizeof(h)) != ESP_OK) return false;
+  head_ = 0;
+  headEpoch_ = 1;
+  used_ = 1;
+  writeSlot_ = 0;
+  lastT_ = 0;
+  firstT_[0] = NO_TIME;
+  ready_ = true;
+  return true;
+}
+
+// =======================================================
+// ======================= SCRITTURA =====================
+// =======================================================
+
+// Log pieno: il settore successivo è il più vecchio e viene sovrascritto
+bool HistoryStore::openNext()
+{
+  const uint16_t next = (uint16_t)((head_ + 1) % sectors_);
+  if (esp_partition_erase_range(part_, next * SECTOR, SECTOR) != ESP_OK) return false;
+  const SectorHeader h = { SECTOR_MAGIC, headEpoch_ + 1, { 0, 0 } };
+  if (esp_partition_write(part_, next * SECTOR, &h, sizeof(h)) != ESP_OK) return false;
+
+  if (used_ < sectors_) used_++;
+  head_ = next;
+  headEpoch_++;
+  writeSlot_ = 0;
+  firstT_[next] = NO_TIME;
+  return true;
+}
+
+bool HistoryStore::append(HistoryRecord r)
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (!ready_ || r.t == NO_TIME) return false;
+  if (r.t < lastT_) r.t = lastT_;
+  if (writeSlot_ >= RECORDS_PER_SECTOR && !openNext()) return false;
+
+  r.reserved = 0;
+  r.crc = recordCrc(r);
+  const uint32_t off = head_ * SECTOR + HEADER + writeSlot_ * sizeof(r);
+  if (esp_partition_write(part_, off, &r, sizeof(r)) != ESP_OK) {
+    writeSlot_ = RECORDS_PER_SECTOR;   // settore in stato incerto: si chiude
+    return false;
+  }
+
+  if (writeSlot_ == 0) firstT_[head_] = r.t;
+  writeSlot_++;
+  lastT_ = r.t;
+  return true;
+}
+
+// =======================================================
+// ======================== LETTURA ======================
+// =======================================================
+
+uint32_t HistoryStore::firstLocked() const
+{
+  return (headEpoch_ - used_ + 1) * RECORDS_PER_SECTOR;
+}
+
+uint32_t HistoryStore::endLocked() const
+{
+  return headEpoch_ * RECORDS_PER_SECTOR + writeSlot_;
+}
+
+uint32_t HistoryStore::first() const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  return ready_ ? firstLocked() : 0;
+}
+
+uint32_t HistoryStore::end() const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  return ready_ ? endLocked() : 0;
+}
+
+uint32_t HistoryStore::lastTime() const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  return lastT_;
+}
+
+uint32_t HistoryStore::lowerBound(uint32_t t) const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (!ready_) return 0;
+
+  // Primo blocco che parte da t o dopo (un settore head vuoto vale NO_TIME)
+  const uint32_t tailEpoch = headEpoch_ - used_ + 1;
+  uint32_t lo = tailEpoch, hi = headEpoch_ + 1;
+  while (lo < hi) {
+    const uint32_t mid = lo + (hi - lo) / 2;
+    if (firstT_[sectorOf(mid)] >= t) hi = mid;
+    else lo = mid + 1;
+  }
+  if (lo == tailEpoch) return firstLocked();
+
+  // Il risultato è nel blocco prima (dallo slot 1) o all'inizio di lo
+  const uint32_t e = lo - 1;
+  const uint16_t s = sectorOf(e);
+  uint32_t a = 1, b = e == headEpoch_ ? writeSlot_ : RECORDS_PER_SECTOR;
+  while (a < b) {
+    const uint32_t mid = (a + b) / 2;
+    if (readTime(s, mid) >= t) b = mid;
+    else a = mid + 1;
+  }
+  return e * RECORDS_PER_SECTOR + a;
+}
+
+size_t HistoryStore::read(uint32_t seq, HistoryRecord* out, size_t n) const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (!ready_ || seq < firstLocked() || seq >= endLocked()) return 0;
+
+  const uint32_t epoch = seq / RECORDS_PER_SECTOR;
+  const uint32_t slot = seq % RECORDS_PER_SECTOR;
+  const uint32_t avail = (epoch == headEpoch_ ? writeSlot_ : RECORDS_PER_SECTOR) - slot;
+  if (n > avail) n = avail;
+
+  const uint32_t off = sectorOf(epoch) * SECTOR + HEADER + slot * sizeof(HistoryRecord);
+  if (esp_partition_read(part_, off, out, n * sizeof(HistoryRecord)) != ESP_OK) return 0;
+  return n;
+}
+
+// =======================================================
+// ======================== QUERY ========================
+// =======================================================
+
+HistoryStream::HistoryStream(const HistoryStore& store, uint32_t from, uint32_t to, uint32_t step)
+    : store_(store), from_(from), to_(to), step_(step ? step : 1)
+{
+  // Al massimo MAX_POINTS punti, qualunque intervallo chieda il client
+  const uint32_t span = to_ - from_;
+  if (span / step_ >= MAX_POINTS) step_ = span / MAX_POINTS + 1;
+  seq_ = store_.lowerBound(from_);
+}
+
+void HistoryStream::add(const HistoryRecord& r)
+{
+  if (r.kind == (uint8_t)HistoryKind::Pump) {
+    pumpS_ += r.pumpS;
+    return;
+  }
+  if (r.soilPct != HISTORY_NONE) { soilSum_ += r.soilPct; soilN_++; }
+  if (r.batteryMv) { mvSum_ += r.batteryMv; mvN_++; }
+  if (r.rssi) { rssiSum_ += r.rssi; rssiN_++; }
+}
+
+void HistoryStream::formatPoint()
+{
+  char* p = text_;
+  char* const end = text_ + sizeof(text_);
+  auto avg = [&](int32_t sum, uint16_t n) {
+    if (n) p += snprintf(p, end - p, ",%ld", (long)(sum / (int32_t)n));
+    else p += snprintf(p, end - p, ",null");
+  };
+
+  p += snprintf(p, end - p, "%s[%lu", firstPoint_ ? "" : ",", (unsigned long)bucket_);
+  avg((int32_t)soilSum_, soilN_);
+  avg((int32_t)mvSum_, mvN_);
+  avg(rssiSum_, rssiN_);
+  p += snprintf(p, end - p, ",%lu]", (unsigned long)pumpS_);
+
+  textLen_ = (uint8_t)(p - text_);
+  firstPoint_ = false;
+}
+
+bool HistoryStream::nextPoint()
+{
+  while (seq_ != UINT32_MAX) {
+    if (batchPos_ == batchLen_) {
+      batchPos_ = 0;
+      batchLen_ = (uint8_t)store_.read(seq_, batch_, sizeof(batch_) / sizeof(batch_[0]));
+      if (batchLen_ == 0) {
+        // Blocco sovrascritto durante la risposta: si riprende dal più vecchio
+        const uint32_t first = store_.first();
+        if (seq_ < first) {
+          seq_ = first;
+          continue;
+        }
+        seq_ = UINT32_MAX;
+        break;
+      }
+    }
+
+    const HistoryRecord& r = batch_[batchPos_];
+    if (!HistoryStore::valid(r) || r.t < from_) {
+      batchPos_++;
+      seq_++;
+      continue;
+    }
+    if (r.t > to_) {
+      seq_ = UINT32_MAX;
+      break;
+    }
+
+    // Il record che apre un intervallo nuovo resta per la chiamata dopo
+    const uint32_t bucket = from_ + (r.t - from_) / step_ * step_;
+    if (open_ && bucket != bucket_) {
+      formatPoint();
+      open_ = false;
+      return true;
+    }
+    if (!open_) {
+      open_ = true;
+      bucket_ = bucket;
+      soilSum_ = mvSum_ = pumpS_ = 0;
+      rssiSum_ = 0;
+      soilN_ = mvN_ = rssiN_ = 0;
+    }
+    add(r);
+    batchPos_++;
+    seq_++;
+  }
+
+  if (!open_) return false;
+  formatPoint();
+  open_ = false;
+  return true;
+}
+
+size_t HistoryStream::fill(uint8_t* buf, size_t max)
+{
+  size_t n = 0;
+  while (n < max) {
+    if (textPos_ < textLen_) {
+      size_t k = textLen_ - textPos_;
+      if (k > max - n) k = max - n;
+      memcpy(buf + n, text_ + textPos_, k);
+      textPos_ += k;
+      n += k;
+      continue;
+    }
+    textLen_ = textPos_ = 0;
+
+    switch (phase_) {
+      case Phase::Header:
+        textLen_ = (uint8_t)snprintf(text_, sizeof(text_), "{\"from\":%lu,\"to\":%lu,\"step\":%lu,\"points\":[",
+                                     (unsigned long)from_, (unsigned long)to_, (unsigned long)step_);
+        phase_ = Phase::Points;
+        break;
+      case Phase::Points:
+        if (!nextPoint()) phase_ = Phase::Footer;
+        break;
+      case Phase::Footer:
+        textLen_ = (uint8_t)snprintf(text_, sizeof(text_), "]}");
+        phase_ = Phase::Done;
+        break;
+      case Phase::Done:
+        return n;
+    }
+  }
+  return n;
+}
+
+// =======================================================
+// ====================== STORE GLOBALE ==================
+// =======================================================
+
+HistoryStore* historyStore()
+{
+  static HistoryStore* s_history = nullptr;
+  static bool s_tried = false;
+  if (s_tried) return s_history;
+  s_tried = true;
+
+  const esp_partition_t* part = esp_partition_find_first(
+      ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, HISTORY_PARTITION_LABEL);
+  if (!part) {
+    Serial.println("[HISTORY] Partizione " HISTORY_PARTITION_LABEL " assente, storico disattivato");
+    return nullptr;
+  }
+
+  static HistoryStore store(part);
+  if (!store.begin()) {
+    Serial.println("[HISTORY] Apertura fallita");
+    return nullptr;
+  }
+  Serial.printf("[HISTORY] %lu record\n", (unsigned long)(store.end() - store.first()));
+  s_history = &store;
+  return s_history;
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <Arduino.h>
+#include <mutex>
+#include "esp_partition.h"
+
+// =======================================================
+// ===================== HISTORY STORE ===================
+// =======================================================
+//
+// Storico a lungo termine di suolo, batteria, RSSI ed eventi pompa su una
+// partizione dati propria, a buffer circolare: record da 16 byte a posizione
+// fissa, il settore più vecchio viene cancellato quando il log ci arriva.
+// In RAM resta solo l'indice dei blocchi (timestamp del primo record di ogni
+// settore): una ricerca per tempo è una bisezione sui blocchi più una dentro
+// il settore, O(log n) letture da 16 byte.
+//
+// Layout di un settore (4 KB):
+//   [magic "HIST"][epoch][riservato]  255 × HistoryRecord
+// I record sono in ordine di tempo (append() non lascia tornare indietro t):
+// la posizione assoluta seq = epoch * RECORDS_PER_SECTOR + slot cresce sempre.
+//
+// append() dal contesto di loop(); letture anche dal task AsyncTCP
+// (GET /api/history), serializzate dal mutex.
+
+// Partizione dati in partitions_ota.csv; su env native è in RAM
+// (test/native/esp_partition.h)
+#define HISTORY_PARTITION_LABEL "history"
+
+enum class HistoryKind : uint8_t {
+  Sample = 1,   // lettura di suolo/batteria (e RSSI se la radio è su)
+  Pump   = 2    // pompa spenta: pumpS = secondi di accensione
+};
+
+struct HistoryRecord {
+  uint32_t t;           // epoch s
+  uint16_t batteryMv;   // 0 = n/d
+  uint16_t pumpS;
+  uint8_t  kind;        // HistoryKind
+  uint8_t  soilPct;     // HISTORY_NONE = n/d
+  int8_t   rssi;        // 0 = n/d
+  uint8_t  reserved;
+  uint32_t crc;         // primi 12 byte
+};
+static_assert(sizeof(HistoryRecord) == 16, "HistoryRecord deve restare di 16 byte");
+
+static const uint8_t HISTORY_NONE = 0xFF;
+
+class HistoryStore {
+public:
+  static const uint32_t SECTOR = 4096;
+  static const uint32_t HEADER = 16;
+  static const uint32_t RECORDS_PER_SECTOR = (SECTOR - HEADER) / sizeof(HistoryRecord);
+  static const uint16_t MAX_SECTORS = 128;   // indice dei blocchi in RAM: 512 KB al massimo
+
+  explicit HistoryStore(const esp_partition_t* part);
+
+  // Scansione degli header e indice dei blocchi; partizione vuota = log nuovo
+  bool begin();
+  bool ready() const { return ready_; }
+
+  // t prima dell'ultimo record viene portato all'ultimo (orologio corretto
+  // all'indietro): l'ordine del log resta quello della bisezione
+  bool append(HistoryRecord r);
+
+  // Record nel log: seq in [first(), end())
+  uint32_t first() const;
+  uint32_t end() const;
+  uint32_t lastTime() const;
+
+  // Primo seq con t >= t (end() se nessuno)
+  uint32_t lowerBound(uint32_t t) const;
+
+  // Fino a n record consecutivi da seq, senza superare il settore; seq già
+  // sovrascritto: nessun record. I record con CRC errato vanno scartati (valid())
+  size_t read(uint32_t seq, HistoryRecord* out, size_t n) const;
+
+  static bool valid(const HistoryRecord& r);
+
+private:
+  bool format();
+  bool openNext();
+  uint32_t readTime(uint16_t sector, uint32_t slot) const;
+  uint16_t sectorOf(uint32_t epoch) const;
+  uint32_t firstLocked() const;
+  uint32_t endLocked() const;
+
+  const esp_partition_t* part_;
+  uint16_t sectors_;
+  uint16_t head_ = 0;
+  uint32_t headEpoch_ = 0;
+  uint16_t used_ = 0;         // settori con dati, head compreso
+  uint32_t writeSlot_ = 0;    // nel settore head
+  uint32_t lastT_ = 0;
+  bool ready_ = false;
+  uint32_t firstT_[MAX_SECTORS];   // per settore fisico
+  mutable std::mutex mtx_;
+};
+
+// ---- Query a intervalli (GET /api/history) ----
+
+// Risposta JSON prodotta a pezzi nel buffer di AsyncWebServer, senza mai
+// tenerla in RAM: i record di ogni intervallo di step secondi diventano un
+// punto [t, suolo medio, mV medi, RSSI medio, secondi di pompa]
+// (null dove manca il dato). Gli intervalli senza record non compaiono.
+class HistoryStream {
+public:
+  static const uint32_t MAX_POINTS = 1000;   // step alzato se serve
+
+  HistoryStream(const HistoryStore& store, uint32_t from, uint32_t to, uint32_t step);
+
+  uint32_t step() const { return step_; }
+
+  // Riempie buf (max byte); 0 = risposta finita
+  size_t fill(uint8_t* buf, size_t max);
+
+private:
+  enum class Phase : uint8_t { Header, Points, Footer, Done };
+
+  bool nextPoint();   // false: record finiti
+  void formatPoint();
+  void add(const HistoryRecord& r);
+
+  const HistoryStore& store_;
+  uint32_t from_, to_, step_;
+  uint32_t seq_;
+  Phase phase_ = Phase::Header;
+  bool firstPoint_ = true;
+
+  // Intervallo in costruzione
+  bool open_ = false;
+  uint32_t bucket_ = 0;
+  uint32_t soilSum_ = 0, mvSum_ = 0, pumpS_ = 0;
+  int32_t rssiSum_ = 0;
+  uint16_t soilN_ = 0, mvN_ = 0, rssiN_ = 0;
+
+  // Record letti a blocchi dalla flash
+  HistoryRecord batch_[16];
+  uint8_t batchLen_ = 0, batchPos_ = 0;
+
+  // Testo prodotto ma non ancora copiato (un punto non si spezza tra chunk)
+  char text_[96];
+  uint8_t textLen_ = 0, textPos_ = 0;
+};
+
+// Store sulla partizione HISTORY_PARTITION_LABEL, aperto al primo uso;
+// nullptr se la tabella partizioni del device non la prevede
+HistoryStore* historyStore();
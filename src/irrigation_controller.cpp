@@ -0,0 +1,182 @@
+#include "irrigation_controller.h"
+
+IrrigationController::IrrigationController(PumpController* pump)
+    : pump_(pump), params_(), stats_() {}
+
+IrrigationParams IrrigationController::paramsFromConfig(const Config& cfg)
+{
+  IrrigationParams p;
+  p.budgetMs = (uint32_t)cfg.pump_duration * 1000UL;
+  // irrigation_pulse_s = 0: un solo impulso lungo quanto il budget (come prima)
+  p.pulseMs = cfg.irrigation_pulse_s > 0 ? (uint32_t)cfg.irrigation_pulse_s * 1000UL : p.budgetMs;
+  if (p.pulseMs > p.budgetMs) p.pulseMs = p.budgetMs;
+  p.soakMs = (uint32_t)cfg.irrigation_soak_s * 1000UL;
+  p.targetPct = (int16_t)(cfg.irrigation_target > 0
+                              ? cfg.irrigation_target
+                              : min(100, cfg.moisture_threshold + DEFAULT_TARGET_MARGIN));
+  p.maxCycles = IRRIGATION_MAX_CYCLES;
+  return p;
+}
+
+uint32_t IrrigationController::maxDurationMs(const IrrigationParams& p)
+{
+  // L'ultimo impulso chiude senza soak (budget o cicli esauriti)
+  uint32_t cycles = p.pulseMs > 0 ? (p.budgetMs + p.pulseMs - 1) / p.pulseMs : 1;
+  if (cycles > p.maxCycles) cycles = p.maxCycles;
+  if (cycles == 0) cycles = 1;
+  return p.budgetMs + (cycles - 1) * (p.soakMs + MEASURE_ALLOWANCE_MS);
+}
+
+bool IrrigationController::start(const IrrigationParams& p, int soilPct, uint32_t now)
+{
+  if (active() || !pump_) return false;
+
+  params_ = p;
+  stats_ = IrrigationStats();
+  stats_.startPct = (int16_t)soilPct;
+  stats_.endPct = -1;
+  for (uint8_t i = 0; i < IRRIGATION_MAX_CYCLES; i++) stats_.cyclePct[i] = -1;
+  startMs_ = now;
+  finished_ = false;
+
+  // Già all'obiettivo: nessuna sessione, result resta None
+  if (soilPct >= p.targetPct || p.budgetMs == 0) return false;
+  return startPulse(now);
+}
+
+bool IrrigationController::startPulse(uint32_t now)
+{
+  const uint32_t left = params_.budgetMs - stats_.pumpMs;
+  pulseMs_ = params_.pulseMs < left ? params_.pulseMs : left;
+
+  if (!pump_->turnOn()) {
+    // Già accesa (comando manuale) o emergency stop attivo
+    finish(pump_->isEmergencyStop() ? IrrigationResult::Failsafe : IrrigationResult::PumpFailed, now);
+    return false;
+  }
+  stats_.cycles++;
+  phase_ = IrrigationPhase::Pulse;
+  phaseMs_ = now;
+  return true;
+}
+
+void IrrigationController::endPulse(uint32_t now)
+{
+  const uint32_t ran = now - phaseMs_;
+  stats_.cyclePumpMs[stats_.cycles - 1] = ran;
+  stats_.pumpMs += ran;
+}
+
+bool IrrigationController::loop(uint32_t now)
+{
+  switch (phase_) {
+    case IrrigationPhase::Idle:
+    case IrrigationPhase::Measure:
+      return false;
+
+    case IrrigationPhase::Pulse:
+      if (!pump_->getState()) {
+        // Spenta dal failsafe (o da fuori senza passare da abort())
+        endPulse(now);
+        finish(pump_->isEmergencyStop() ? IrrigationResult::Failsafe : IrrigationResult::Aborted, now);
+        return false;
+      }
+      if (now - phaseMs_ < pulseMs_) return false;
+
+      pump_->turnOff();
+      endPulse(now);
+      // Niente soak se non ci sarà un altro impulso: il nodo torna a dormire prima
+      if (stats_.pumpMs >= params_.budgetMs) {
+        finish(IrrigationResult::Budget, now);
+        return false;
+      }
+      if (stats_.cycles >= params_.maxCycles) {
+        finish(IrrigationResult::MaxCycles, now);
+        return false;
+      }
+      phase_ = IrrigationPhase::Soak;
+      phaseMs_ = now;
+      return false;
+
+    case IrrigationPhase::Soak:
+      if (now - phaseMs_ < params_.soakMs) return false;
+      phase_ = IrrigationPhase::Measure;
+      return true;
+  }
+  return false;
+}
+
+void IrrigationController::onSoilSample(int soilPct, uint32_t now)
+{
+  if (phase_ != IrrigationPhase::Measure) return;
+
+  stats_.cyclePct[stats_.cycles - 1] = (int16_t)soilPct;
+  stats_.endPct = (int16_t)soilPct;
+  if (soilPct >= params_.targetPct) {
+    finish(IrrigationResult::Target, now);
+    return;
+  }
+  startPulse(now);
+}
+
+void IrrigationController::abort(uint32_t now)
+{
+  if (!active()) return;
+  if (phase_ == IrrigationPhase::Pulse) {
+    pump_->turnOff();
+    endPulse(now);
+  }
+  finish(IrrigationResult::Aborted, now);
+}
+
+void IrrigationController::finish(IrrigationResult r, uint32_t now)
+{
+  stats_.result = r;
+  stats_.totalMs = now - startMs_;
+  phase_ = IrrigationPhase::Idle;
+  finished_ = true;
+}
+
+bool IrrigationController::takeFinished()
+{
+  const bool f = finished_;
+  finished_ = false;
+  return f;
+}
+
+size_t IrrigationController::formatStats(const IrrigationStats& st, char* out, size_t len)
+{
+  if (!out || len == 0) return 0;
+
+  size_t n = (size_t)snprintf(out, len,
+                              "{\"result\":\"%s\",\"cycles\":%u,\"pump_ms\":%lu,\"total_ms\":%lu,"
+                              "\"start\":%d,\"end\":%d,\"c\":[",
+                              resultStr(st.result), st.cycles,
+                              (unsigned long)st.pumpMs, (unsigned long)st.totalMs,
+                              st.startPct, st.endPct);
+  if (n >= len) return 0;
+
+  for (uint8_t i = 0; i < st.cycles && i < IRRIGATION_MAX_CYCLES; i++) {
+    n += (size_t)snprintf(out + n, len - n, "%s[%lu,%d]", i ? "," : "",
+                          (unsigned long)st.cyclePumpMs[i], st.cyclePct[i]);
+    if (n >= len) return 0;
+  }
+
+  n += (size_t)snprintf(out + n, len - n, "]}");
+  if (n >= len) return 0;
+  return n;
+}
+
+const char* IrrigationController::resultStr(IrrigationResult r)
+{
+  switch (r) {
+    case IrrigationResult::None:       return "none";
+    case IrrigationResult::Target:     return "target";
+    case IrrigationResult::Budget:     return "budget";
+    case IrrigationResult::MaxCycles:  return "max_cycles";
+    case IrrigationResult::Aborted:    return "aborted";
+    case IrrigationResult::Failsafe:   return "failsafe";
+    case IrrigationResult::PumpFailed: return "pump_failed";
+  }
+  return "?";
+}
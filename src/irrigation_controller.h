@@ -0,0 +1,97 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+#include "pump_controller.h"
+
+enum class IrrigationPhase : uint8_t {
+  Idle,
+  Pulse,     // pompa accesa
+  Soak,      // pompa spenta, l'acqua scende nel substrato
+  Measure    // in attesa della misura richiesta da loop()
+};
+
+enum class IrrigationResult : uint8_t {
+  None,        // sessione in corso o mai partita
+  Target,      // umidità obiettivo raggiunta
+  Budget,      // tempo pompa esaurito (pump_duration)
+  MaxCycles,
+  Aborted,     // comando pompa manuale / timeout dello stage
+  Failsafe,    // emergency stop di PumpController
+  PumpFailed   // la pompa non si è accesa
+};
+
+struct IrrigationParams {
+  uint32_t pulseMs;
+  uint32_t soakMs;
+  uint32_t budgetMs;    // pompa accesa in tutto, al più
+  int16_t  targetPct;
+  uint8_t  maxCycles;
+};
+
+static const uint8_t IRRIGATION_MAX_CYCLES = 8;
+
+struct IrrigationStats {
+  IrrigationResult result;
+  uint8_t  cycles;
+  int16_t  startPct;
+  int16_t  endPct;                                  // -1 = non misurata
+  uint32_t pumpMs;
+  uint32_t totalMs;
+  uint32_t cyclePumpMs[IRRIGATION_MAX_CYCLES];
+  int16_t  cyclePct[IRRIGATION_MAX_CYCLES];         // dopo il soak, -1 = nessuna misura
+};
+
+// Irrigazione a impulsi sopra PumpController: impulso, soak, nuova misura,
+// finché l'umidità raggiunge l'obiettivo o il budget di pompa è finito.
+// Non blocca: loop() va chiamato a ogni giro del task di controllo, che
+// esegue le misure richieste e le restituisce con onSoilSample().
+class IrrigationController {
+public:
+  // Oltre moisture_threshold quando irrigation_target = 0
+  static const int DEFAULT_TARGET_MARGIN = 10;
+  // Misura dopo il soak: raffica DMA o, nel caso peggiore, 5 analogRead
+  static const uint32_t MEASURE_ALLOWANCE_MS = 500;
+
+  explicit IrrigationController(PumpController* pump);
+
+  static IrrigationParams paramsFromConfig(const Config& cfg);
+  // Durata massima di una sessione (deadline dello stage di boot)
+  static uint32_t maxDurationMs(const IrrigationParams& p);
+
+  // false se già in corso, se il suolo è già all'obiettivo o la pompa non parte
+  bool start(const IrrigationParams& p, int soilPct, uint32_t now);
+
+  // true quando serve una misura del suolo
+  bool loop(uint32_t now);
+  void onSoilSample(int soilPct, uint32_t now);
+
+  void abort(uint32_t now);
+
+  // true una sola volta a sessione conclusa
+  bool takeFinished();
+
+  bool active() const { return phase_ != IrrigationPhase::Idle; }
+  IrrigationPhase phase() const { return phase_; }
+  const IrrigationStats& stats() const { return stats_; }
+
+  // {"result":"target","cycles":2,"pump_ms":..,"total_ms":..,"start":..,"end":..,
+  //  "c":[[pump_ms,pct],...]}; 0 se il buffer non basta
+  static const size_t MAX_STATS_JSON = 320;   // caso peggiore con IRRIGATION_MAX_CYCLES
+  static size_t formatStats(const IrrigationStats& st, char* out, size_t len);
+
+  static const char* resultStr(IrrigationResult r);
+
+private:
+  bool startPulse(uint32_t now);
+  void endPulse(uint32_t now);
+  void finish(IrrigationResult r, uint32_t now);
+
+  PumpController* pump_;
+  IrrigationParams params_;
+  IrrigationStats stats_;
+  IrrigationPhase phase_ = IrrigationPhase::Idle;
+  uint32_t startMs_ = 0;
+  uint32_t phaseMs_ = 0;
+  uint32_t pulseMs_ = 0;
+  bool finished_ = false;
+};
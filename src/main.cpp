@@ -15,9 +15,23 @@
 #include "webserver.h"
 #include "mqtt.h"
 #include "config_api.h"
+#include "config_cache.h"
+#include "record_store.h"
+#include "history_store.h"
 #include "logger.h"
 #include "telnet_logger.h"
 #include "pump_controller.h"
+#include "boot_profiler.h"
+#include "wifi_connect.h"
+#include "boot_sequencer.h"
+#include "wake_policy.h"
+#include "sleep_scheduler.h"
+#include "ulp_monitor.h"
+#include "wake_stub.h"
+#include "soil_filter.h"
+#include "telemetry_buffer.h"
+#include "report_policy.h"
+#include "control_task.h"
 
 #include "update/UpdateManager.h"
 #include "update/FirmwareUpdateStrategy.h"
@@ -49,12 +63,16 @@ Preferences prefs;
 
 int soilValue = 0;
 int soilPercent = 0;
+int batteryMv = 0;
 
 static const char* SYSLOG_HOST = "192.168.1.10";
 static const uint16_t SYSLOG_PORT = 5140;
 static const char* SYSLOG_APP = "bonsai-esp32";
 static const char* SYSLOG_HOSTNAME = "bonsai-esp32";
 
+// Se il WiFi non è raggiungibile il prossimo wake arriva al più dopo questo intervallo
+static const uint64_t WIFI_RETRY_SLEEP_US = 5ULL * 60ULL * 1000000ULL;
+
 // ----------------- Debug MQTT helper -----------------
 static void debugLog(const String& msg) {
   if (!mqttReady) return;
@@ -133,34 +151,8 @@ void otaCheckNow() {
   }
 }
 
-// ----------------- Time sync -----------------
-static bool timeIsValidLocal(unsigned long timeoutMs = 10000) {
-  unsigned long start = millis();
-  while (millis() - start < timeoutMs) {
-    if (timeIsValid()) return true;
-    delay(200);
-  }
-  return false;
-}
-
-// ----------------- WiFi -----------------
-void setup_wifi() {
-  debugLog("WIFI: starting");
-  Serial.print("Connecting to WiFi: ");
-  Serial.println(config.wifi_ssid);
-
-  WiFi.begin(config.wifi_ssid.c_str(), config.wifi_password.c_str());
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(500);
-    Serial.print(".");
-  }
-
-  Serial.println("\nWiFi connected");
-  Serial.println(WiFi.localIP());
-  debugLog("WIFI: connected");
-
-  Logger::begin(SYSLOG_HOST, SYSLOG_PORT, SYSLOG_HOSTNAME, SYSLOG_APP, LOG_INFO);
-
+// ----------------- Timezone -----------------
+static void setupTimezone() {
   // Use timezone from config, fallback to Europe/Rome if not set or empty
   String tz = config.timezone;
   tz.trim();  // Remove leading/trailing whitespace
@@ -180,77 +172,418 @@ void setup_wifi() {
   setenv("TZ", posixTz.c_str(), 1);
   tzset();
   configTime(0, 0, "pool.ntp.org", "time.nist.gov");
-
-  if (timeIsValidLocal()) debugLog("TIME: ok");
-  else debugLog("TIME: timeout");
 }
 
-// ----------------- Sensore -----------------
-int readSoil() {
-  // Sample 5 times with 50ms delay to reduce noise
-  int samples[5];
-  for (int i = 0; i < 5; i++) {
-    samples[i] = analogRead(config.sensor_pin);
-    delay(50);
+// ----------------- Sensore e pompa -----------------
+// Letture e comandi passano dal task di controllo (control_task.h); qui si
+// consumano i suoi eventi: globali, publish di stato e alert restano in loop().
+static bool soilSampleReady = false;
+static bool pumpAlertPending = false;
+static bool irrigationStatsPending = false;
+
+// ---- Storico su flash (GET /api/history) ----
+static const uint32_t HISTORY_SAMPLE_MIN_S = 300;   // sessioni lunghe: un punto ogni 5 minuti
+static unsigned long pumpOnMs = 0;
+
+static void recordHistory(HistoryKind kind, uint16_t pumpS = 0) {
+  if (!timeIsValid()) return;   // senza ora il punto non si può collocare
+  HistoryStore* h = historyStore();
+  if (!h) return;
+
+  const uint32_t now = (uint32_t)time(nullptr);
+  static uint32_t lastSampleS = 0;
+  HistoryRecord r = {};
+  r.t = now;
+  r.kind = (uint8_t)kind;
+  r.soilPct = HISTORY_NONE;
+  if (kind == HistoryKind::Sample) {
+    if (lastSampleS && now - lastSampleS < HISTORY_SAMPLE_MIN_S) return;
+    lastSampleS = now;
+    r.soilPct = (uint8_t)constrain(soilPercent, 0, 100);
+    r.batteryMv = (uint16_t)constrain(batteryMv, 0, 65535);
+    r.rssi = WiFi.isConnected() ? (int8_t)constrain(WiFi.RSSI(), -127, -1) : 0;
   }
-  
-  // Sort samples for outlier rejection
-  for (int i = 0; i < 4; i++) {
-    for (int j = i + 1; j < 5; j++) {
-      if (samples[i] > samples[j]) {
-        int temp = samples[i];
-        samples[i] = samples[j];
-        samples[j] = temp;
+  r.pumpS = pumpS;
+  if (!h->append(r)) debugLog("HISTORY: append FAIL");
+}
+
+static void handleControlEvents() {
+  ControlEvent ev;
+  while (ControlTask::pollEvent(ev)) {
+    switch (ev.type) {
+      case ControlEventType::SoilSample:
+        soilValue = ev.soilRaw;
+        soilPercent = ev.soilPct;
+        batteryMv = ev.batteryMv;
+        soilSampleReady = true;
+        debugLog("SOIL=" + String(soilPercent) + "% (" + String(ev.samples) + " samples, " +
+                 String(ev.outliers) + " outliers)");
+        break;
+
+      case ControlEventType::PumpOn: {
+        debugLog("PUMP: ON");
+        pumpOnMs = millis();
+        publishMqtt("bonsai/" + deviceId + "/status/pump", "on", true);
+        ReportPolicy::reported(StatusMetric::Pump, 1, millis());
+
+        char buf[32];
+        unsigned long long ms = epochMs();
+        if (ms > 0) {
+          snprintf(buf, sizeof(buf), "%llu", ms);
+          publishMqtt("bonsai/" + deviceId + "/status/last_on", buf, true);
+        }
+        break;
+      }
+
+      case ControlEventType::PumpOff:
+        debugLog("PUMP: OFF");
+        recordHistory(HistoryKind::Pump, (uint16_t)min((millis() - pumpOnMs + 500) / 1000, 65535UL));
+        publishMqtt("bonsai/" + deviceId + "/status/pump", "off", true);
+        ReportPolicy::reported(StatusMetric::Pump, 0, millis());
+        break;
+
+      case ControlEventType::EmergencyStop:
+        pumpAlertPending = true;
+        break;
+
+      case ControlEventType::IrrigationDone: {
+        IrrigationStats st = ControlTask::irrigationStats();
+        debugLog("IRRIGATION: " + String(IrrigationController::resultStr(st.result)) + ", " +
+                 String(st.cycles) + " cycles, pump " + String(st.pumpMs) + " ms, " +
+                 String(st.startPct) + "% -> " + String(st.endPct) + "%");
+        irrigationStatsPending = true;
+        break;
       }
     }
   }
-  
-  // Use median-of-3 (discard min and max outliers)
-  int raw = (samples[1] + samples[2] + samples[3]) / 3;
-  int perc = map(raw, 4095, 0, 0, 100);
-  soilValue = raw;
-  soilPercent = perc;
-  debugLog("SOIL=" + String(perc) + "% (avg of 5 samples)");
-  return perc;
-}
 
-// ----------------- Pompa -----------------
-void turnOnPump() {
-  if (!pumpController) return;
-  debugLog("PUMP: ON");
-  pumpController->turnOn();
-
-  publishMqtt("bonsai/" + deviceId + "/status/pump", "on", true);
+  // Statistiche dell'ultima sessione (retained), anche se l'irrigazione è
+  // avvenuta prima della radio (sensor-first)
+  if (irrigationStatsPending && mqttReady) {
+    char buf[IrrigationController::MAX_STATS_JSON];
+    if (IrrigationController::formatStats(ControlTask::irrigationStats(), buf, sizeof(buf)))
+      publishMqtt("bonsai/" + deviceId + "/status/irrigation", buf, true);
+    irrigationStatsPending = false;
+  }
 
-  char buf[32];
-  unsigned long long ms = epochMs();
-  if (ms > 0) {
-    snprintf(buf, sizeof(buf), "%llu", ms);
-    publishMqtt("bonsai/" + deviceId + "/status/last_on", buf, true);
+  // Alert retained pubblicato una volta, appena MQTT è disponibile
+  if (pumpAlertPending && mqttReady) {
+    publishMqtt("bonsai/" + deviceId + "/alert/pump", "EMERGENCY_STOP", true);
+    pumpAlertPending = false;
+    debugLog("[PUMP] Published emergency stop alert");
   }
 }
 
 void turnOffPump() {
-  if (!pumpController) return;
-  debugLog("PUMP: OFF");
-  pumpController->turnOff();
-  publishMqtt("bonsai/" + deviceId + "/status/pump", "off", true);
+  if (pumpController) ControlTask::send(ControlCmd::PumpOff);
+}
+
+// ----------------- Boot profile -----------------
+// Un solo messaggio per wake con last/min/avg/max (ms) di ogni fase di setup()
+static void publishBootProfile() {
+  if (!mqttReady) return;
+  char report[512];
+  BootProfiler::formatReport(report, sizeof(report));
+  publishMqtt("bonsai/" + deviceId + "/status/boot_profile", report, false);
+}
+
+// ----------------- Servizi periodici -----------------
+static bool netServicesUp = false;
+
+// Lavoro di fondo condiviso da boot e loop(): eventi del controllo, MQTT, OTA, Telnet, WDT.
+// Il failsafe pompa gira nel task di controllo, indipendente da questo giro.
+static void serviceTick() {
+  if (netServicesUp) {
+    ArduinoOTA.handle();
+    loopTelnetLogger();
+  }
+
+  handleControlEvents();
+  serviceConfigApi();
+
+  // Non blocca: l'I/O col broker lo fa il worker MQTT
+  loopMqtt();
+  esp_task_wdt_reset();
 }
 
 // =======================================================
-// ======================== SETUP ========================
+// ===================== BOOT STAGES =====================
 // =======================================================
+// Sensore/pompa e rete avanzano in parallelo; ogni stage ha una deadline e un
+// fallimento degrada solo chi ne dipende (niente WiFi → si irriga comunque).
+// In modalità sensor-first (maintenance_wakes > 1) gli stage di rete vengono
+// registrati solo dopo l'irrigazione e solo se WakePolicy lo richiede.
+
+static BootSequencer boot;
+static int stSoil = -1, stPump = -1, stWifi = -1, stNet = -1, stNtp = -1, stMqtt = -1, stUpdater = -1;
+static int stBatch = -1;
+
+static const uint32_t SOIL_STAGE_DEADLINE_MS = 2000;
+// wifiConnectPoll() termina da solo entro WIFI_CONNECT_MAX_MS (~38 s): la
+// deadline dello stage è solo una rete di sicurezza sopra quel limite
+static const uint32_t WIFI_STAGE_DEADLINE_MS = WIFI_CONNECT_MAX_MS + 2000;
+static const uint32_t NTP_STAGE_DEADLINE_MS  = 10000;
+static const uint32_t MQTT_STAGE_DEADLINE_MS = 20000;
+static const unsigned long MQTT_FLUSH_TIMEOUT_MS = 3000;  // coda MQTT prima del deep sleep
+static const unsigned long SENSOR_REFRESH_MS = 15000;      // come mqttInterval
+static const unsigned long CONTROL_SYNC_TIMEOUT_MS = 100;  // comandi pompa pendenti prima del deep sleep
+static const unsigned long KV_MAINTAIN_MS = 10000;         // compattazione kvstore a riposo (~50 ms per settore)
+static const uint32_t PUMP_STAGE_MARGIN_MS   = 5000;
+static const unsigned long BOOT_TICK_MS      = 5;
+
+// ---- Sensore e batteria (raffica DMA nel task di controllo, pochi ms) ----
+static bool soilStageStart() {
+  soilSampleReady = false;
+  return ControlTask::send(ControlCmd::SampleSoil);
+}
+
+static StageStatus soilStagePoll() {
+  if (!soilSampleReady) return StageStatus::Running;
+
+  // Campione del wake nel ring buffer RTC (inviato a lotti dallo stage "batch")
+  TelemetrySample s = {};
+  time_t nowSec = time(nullptr);
+  s.ts = timeIsValid() ? (uint32_t)nowSec : 0;
+  s.wake = (uint32_t)bootCount;
+  s.soilRaw = (uint16_t)soilValue;
+  s.soilPct = (uint8_t)constrain(soilPercent, 0, 100);
+  s.battery = (uint16_t)batteryMv;
+  s.flags = s.ts ? 0 : TELEMETRY_FLAG_NO_TIME;
+  TelemetryBuffer::append(s);
+  return StageStatus::Done;
+}
+
+// ---- Pompa: sessione a impulsi/soak nel task di controllo ----
+static bool pumpStarting = false;   // Irrigate inviato, in attesa del task di controllo
+static bool wateringActive = false;
+static bool wateredThisWake = false;
+
+static bool pumpStageStart() {
+  wateringActive = false;
+  pumpStarting = false;
+  if (soilPercent >= config.moisture_threshold) {
+    debugLog("SOIL: ok");
+    return true;
+  }
+
+  debugLog("SOIL: dry");
+  if (!config.use_pump || !pumpController) return true;
+
+  ControlTask::send(ControlCmd::Irrigate);
+  pumpStarting = true;
+  return true;
+}
+
+static StageStatus pumpStagePoll() {
+  if (pumpStarting) {
+    if (!ControlTask::synced()) return StageStatus::Running;
+    pumpStarting = false;
+
+    wateringActive = ControlTask::irrigating();
+    wateredThisWake = wateringActive;
+    if (!wateringActive) {
+      // Non partita: già all'obiettivo (ok) oppure pompa bloccata
+      const IrrigationResult r = ControlTask::irrigationStats().result;
+      if (r == IrrigationResult::None) return StageStatus::Done;
+      if (ControlTask::emergencyStop()) TelemetryBuffer::markLast(TELEMETRY_FLAG_PUMP_ALERT);
+      return StageStatus::Failed;
+    }
+    BootProfiler::start(BootPhase::PumpCycle);
+    TelemetryBuffer::markLast(TELEMETRY_FLAG_WATERED);
+  }
+
+  if (!wateringActive) return StageStatus::Done;
+  if (ControlTask::irrigating()) return StageStatus::Running;
+
+  // Obiettivo, budget, comando remoto o failsafe
+  wateringActive = false;
+  BootProfiler::stop(BootPhase::PumpCycle);
+  if (ControlTask::irrigationStats().result == IrrigationResult::Failsafe) {
+    TelemetryBuffer::markLast(TELEMETRY_FLAG_PUMP_ALERT);
+    return StageStatus::Failed;
+  }
+  return StageStatus::Done;
+}
+
+static void pumpStageTimeout() {
+  turnOffPump();
+  if (wateringActive) BootProfiler::stop(BootPhase::PumpCycle);
+  wateringActive = false;
+  pumpStarting = false;
+}
+
+// ---- WiFi ----
+static bool wifiStageStart() {
+  debugLog("WIFI: starting");
+  Serial.print("Connecting to WiFi: ");
+  Serial.println(config.wifi_ssid);
+  wifiConnectBegin(config);
+  return true;
+}
+
+static StageStatus wifiStagePoll() {
+  WifiConnectResult res = wifiConnectPoll();
+  if (res == WifiConnectResult::Pending) return StageStatus::Running;
+
+  if (res == WifiConnectResult::Failed) {
+    Serial.println("WiFi: tentativi esauriti");
+    return StageStatus::Failed;
+  }
+
+  Serial.printf("WiFi connected (%s) in %lu ms\n", wifiConnectResultStr(res), boot.elapsedMs(stWifi));
+  Serial.println(WiFi.localIP());
+  debugLog("WIFI: connected");
+  return StageStatus::Done;
+}
+
+// ---- Servizi di rete (istantanei) ----
+static bool netStageStart() {
+  Logger::begin(SYSLOG_HOST, SYSLOG_PORT, SYSLOG_HOSTNAME, SYSLOG_APP, LOG_INFO);
+  setupTimezone();
+  setupTelnetLogger("bonsai-esp32", 23);
+  ArduinoOTA.begin();
+
+  // Setup webserver solo se abilitato nel config
+  if (config.enable_webserver) {
+    setup_webserver(config.pump_pin);
+    setupConfigApi();  // API config via HTTP
+    debugLog("WEBSERVER: started");
+  } else {
+    debugLog("WEBSERVER: disabled (enable_webserver=false)");
+  }
+
+  netServicesUp = true;
+  return true;
+}
+
+// ---- NTP (SNTP gira in background, qui si attende solo la sync) ----
+static StageStatus ntpStagePoll() {
+  if (!timeIsValid()) return StageStatus::Running;
+  debugLog("TIME: ok");
+  return StageStatus::Done;
+}
+
+static void ntpStageTimeout() {
+  debugLog("TIME: timeout");
+}
+
+// ---- MQTT ----
+static bool mqttStageStart() {
+  setupMqtt();   // avvia il worker, che si connette e riprova da solo
+  debugLog("MQTT: connect start");
+  return true;
+}
+
+static StageStatus mqttStagePoll() {
+  if (!mqttConnected()) return StageStatus::Running;
+
+  publishMqtt("bonsai/debug", "BOOT start", false);
+  debugLog("MQTT: connected");
+  debugLog("DEVICEID=" + deviceId);
+
+  Logger::enableMqtt(true);
+  Logger::setMqttPublish([](const char* topic, const char* payload, bool retain){
+    publishMqtt(topic, payload, retain);
+  });
+
+  // Il report di questo wake parte subito, non dopo mqttInterval
+  publishStatus();
+  return StageStatus::Done;
+}
+
+// ---- OTA (HTTP con timeout espliciti, dopo MQTT) ----
+static bool updaterStageStart() {
+  debugLog("UPDATER: run");
+  fwStrategy = new FirmwareUpdateStrategy();
+  updater.registerStrategy(fwStrategy);
+  updater.runAll();
+  debugLog("UPDATER: done");
+  return true;
+}
+
+static void registerSensorStages() {
+  const uint32_t pumpDeadline =
+      IrrigationController::maxDurationMs(IrrigationController::paramsFromConfig(config)) + PUMP_STAGE_MARGIN_MS;
+
+  stSoil    = boot.add("soil", SOIL_STAGE_DEADLINE_MS, soilStageStart, soilStagePoll,
+                       0, 0, BootPhase::SoilRead);
+  stPump    = boot.add("pump", pumpDeadline, pumpStageStart, pumpStagePoll,
+                       STAGE_BIT(stSoil), 0, BootPhase::Count, pumpStageTimeout);
+}
+
+// ---- Lotto telemetria (un publish per tutti i wake accumulati) ----
+static char batchJson[TelemetryBuffer::MAX_BATCH_JSON];
+
+static bool batchStageStart() {
+  if (TelemetryBuffer::count() == 0) return true;
+
+  size_t n = TelemetryBuffer::formatBatch(batchJson, sizeof(batchJson), (uint32_t)bootCount);
+  if (n == 0) {
+    debugLog("BATCH: format overflow");
+    return false;
+  }
+
+  // Accodato = consegnato prima del deep sleep (mqttFlush) o alla riconnessione
+  String topic = "bonsai/" + deviceId + "/telemetry/batch";
+  if (!mqttEnqueue(topic.c_str(), (const uint8_t*)batchJson, n, false)) {
+    debugLog("BATCH: enqueue FAIL, kept " + String(TelemetryBuffer::count()) + " samples");
+    return false;
+  }
+
+  debugLog("BATCH: queued " + String(TelemetryBuffer::count()) + " samples");
+  TelemetryBuffer::clear();
+  return true;
+}
+
+static void registerRadioStages() {
+  stWifi    = boot.add("wifi", WIFI_STAGE_DEADLINE_MS, wifiStageStart, wifiStagePoll,
+                       0, 0, BootPhase::WifiAssoc);
+  stNet     = boot.add("net", 0, netStageStart, nullptr,
+                       0, STAGE_BIT(stWifi));
+  stNtp     = boot.add("ntp", NTP_STAGE_DEADLINE_MS, nullptr, ntpStagePoll,
+                       0, STAGE_BIT(stNet), BootPhase::NtpSync, ntpStageTimeout);
+  stMqtt    = boot.add("mqtt", MQTT_STAGE_DEADLINE_MS, mqttStageStart, mqttStagePoll,
+                       0, STAGE_BIT(stWifi), BootPhase::Mqtt);
+  stUpdater = boot.add("ota", 0, updaterStageStart, nullptr,
+                       STAGE_BIT(stMqtt), STAGE_BIT(stWifi), BootPhase::Updater);
+  // Dopo la pompa, così l'ultimo campione ha già i flag di irrigazione
+  stBatch   = boot.add("batch", 0, batchStageStart, nullptr,
+                       STAGE_BIT(stSoil) | STAGE_BIT(stPump), STAGE_BIT(stMqtt));
+}
+
+// Il failsafe non deve scattare durante un'irrigazione configurata più lunga di 60 s
+static unsigned long pumpMaxRunMs() {
+  unsigned long configured = (unsigned long)config.pump_duration * 1000UL + PUMP_STAGE_MARGIN_MS;
+  return configured > 60000UL ? configured : 60000UL;
+}
+
+// Hot reload (contesto di loop()): riallinea ciò che setup() ha derivato dal config
+static void onConfigApplied(const Config& before) {
+  if (config.timezone != before.timezone) setupTimezone();
+  if (config.pump_duration != before.pump_duration && pumpController)
+    pumpController->setMaxRunMs(pumpMaxRunMs());
+  debugLog("CONFIG: applied live");
+}
 
 // =======================================================
 // ======================== SETUP ========================
 // =======================================================
 
+static void runBootStages() {
+  while (!boot.done()) {
+    boot.tick();
+    serviceTick();
+    delay(BOOT_TICK_MS);
+  }
+}
+
 unsigned long setupDoneTime = 0;
+static bool radioUp = false;
+static bool wifiFailedThisWake = false;
 
 void setup() {
+  BootProfiler::begin();
   Serial.begin(115200);
-  SPIFFS.begin(true);
-  delay(100);
 
   setupDeviceId();
   esp_ota_mark_app_valid_cancel_rollback();
@@ -266,86 +599,103 @@ void setup() {
   ++bootCount;
   debugLog("BOOTCOUNT=" + String(bootCount));
 
-  if (!loadConfig(config)) {
+  // Timer (report periodico) o ULP (suolo sotto soglia): lo stato RTC è valido
+  esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
+  const bool deepSleepWake = wakeup_reason == ESP_SLEEP_WAKEUP_TIMER ||
+                             wakeup_reason == ESP_SLEEP_WAKEUP_ULP;
+
+  // Wake da deep sleep: config dalla cache binaria (RTC/flash), SPIFFS solo al
+  // cold boot o se la cache non è valida; il JSON solo se config.json è cambiato
+  ConfigSource cfgSource = ConfigSource::Json;
+  BootProfiler::start(BootPhase::LoadConfig);
+  bool cfgOk = ConfigCache::restore(config, deepSleepWake, cfgSource);
+  if (!cfgOk) {
+    BootProfiler::start(BootPhase::FsMount);
+    mountFS(true);
+    BootProfiler::stop(BootPhase::FsMount);
+
+    BootProfiler::start(BootPhase::LoadConfig);   // "cfg" senza il mount
+    cfgOk = loadConfig(config, &cfgSource);
+  }
+  BootProfiler::stop(BootPhase::LoadConfig);
+
+  if (!cfgOk) {
     debugLog("CONFIG: load FAIL");
     // Continue anyway with defaults?
   } else {
-    debugLog("CONFIG: loaded");
+    debugLog("CONFIG: loaded (" + String(ConfigCache::sourceStr(cfgSource)) + ")");
   }
 
-  setup_wifi();
-  
   // Check if wakeup from deep sleep and restore state
-  esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
-  if (wakeup_reason == ESP_SLEEP_WAKEUP_TIMER) {
-    debugLog("WAKEUP: from deep sleep");
+  if (deepSleepWake) {
+    debugLog(wakeup_reason == ESP_SLEEP_WAKEUP_ULP ? "WAKEUP: from deep sleep (ULP: soil dry)"
+                                                   : "WAKEUP: from deep sleep");
     lastWakeupMs = millis();
   } else if (wakeup_reason == ESP_SLEEP_WAKEUP_UNDEFINED) {
     // First boot or reset, not from deep sleep
     debugLog("BOOT: first boot or reset");
     pumpStateAfterWakeup = false;  // Reset to OFF on first boot
   }
-  
-  setupTelnetLogger("bonsai-esp32", 23);
-
-  esp_task_wdt_init(8, true);
-  esp_task_wdt_add(NULL);
-
-  setupMqtt();
-  debugLog("MQTT: connect start");
-
-  if(mqttReady) {
-    publishMqtt("bonsai/debug", "BOOT start", false);
+  WakePolicy::begin(!deepSleepWake);
+  TelemetryBuffer::begin(!deepSleepWake);
+  SleepScheduler::begin(!deepSleepWake);
+
+  // Wake a timer già chiusi dallo stub senza boot completo
+  const uint16_t quickWakes = WakeStub::begin();
+  if (deepSleepWake && quickWakes) {
+    WakePolicy::quickWakes(quickWakes);
+    debugLog("WAKE STUB: " + String(quickWakes) + " quick wakes, last raw " + String(WakeStub::lastRaw()));
   }
 
-  debugLog("MQTT: connected");
-  debugLog("DEVICEID=" + deviceId);
-
-  Logger::enableMqtt(true);
-  Logger::setMqttPublish([](const char* topic, const char* payload, bool retain){
-    publishMqtt(topic, payload, retain);
-  });
+  // Prima del task di controllo: l'ADC torna ai core principali
+  UlpSnapshot ulp = UlpMonitor::begin(deepSleepWake);
+  if (ulp.valid) {
+    debugLog("ULP: " + String(ulp.samples) + " samples, avg raw " + String(ulp.average) +
+             " (" + String(soilRawToPercent(ulp.average)) + "%), last " + String(ulp.last));
+  }
 
-  debugLog("UPDATER: run");
-  fwStrategy = new FirmwareUpdateStrategy();
-  updater.registerStrategy(fwStrategy);
-  updater.runAll();
-  debugLog("UPDATER: done");
+  esp_task_wdt_init(8, true);
+  esp_task_wdt_add(NULL);
 
   pinMode(config.led_pin, OUTPUT);
   pinMode(config.sensor_pin, INPUT);
   
-  // Initialize pump controller with 60-second max runtime failsafe
-  pumpController = new PumpController(config.pump_pin, 60000);
+  // Pump controller with max runtime failsafe (>= 60 s)
+  pumpController = new PumpController(config.pump_pin, pumpMaxRunMs());
   pumpController->begin();
   
   // Restore pump state if wakeup from deep sleep
-  if (wakeup_reason == ESP_SLEEP_WAKEUP_TIMER && pumpController) {
+  if (deepSleepWake && pumpController) {
     debugLog("PUMP: restoring state " + String(pumpStateAfterWakeup ? "ON" : "OFF"));
     pumpController->setState(pumpStateAfterWakeup);
   }
 
-  ArduinoOTA.begin();
-  
-  // Setup webserver solo se abilitato nel config
-  if (config.enable_webserver) {
-    setup_webserver(config.pump_pin);
-    setupConfigApi();  // API config via HTTP
-    debugLog("WEBSERVER: started");
-  } else {
-    debugLog("WEBSERVER: disabled (enable_webserver=false)");
+  // Da qui pompa e sensore appartengono al task di controllo (core 1, WDT proprio)
+  ControlTask::begin();
+  setConfigAppliedHook(onConfigApplied);
+
+  // Boot cooperativo: la durata è quella dello stage più lungo, non la somma
+  registerSensorStages();
+  if (WakePolicy::sensorFirst(config)) {
+    // Sensor-first: misura e irrigazione prima di toccare la radio
+    runBootStages();
   }
 
-  int perc = readSoil();
-  if (perc < config.moisture_threshold) {
-    debugLog("SOIL: dry");
-    if (config.use_pump) {
-      turnOnPump();
-      delay(config.pump_duration * 1000);
-      turnOffPump();
-    }
+  RadioReason reason = WakePolicy::decide(config, soilPercent, wateredThisWake,
+                                          ControlTask::emergencyStop(),
+                                          TelemetryBuffer::almostFull());
+  radioUp = reason != RadioReason::None;
+  debugLog("RADIO: " + String(WakePolicy::reasonStr(reason)) +
+           " (wakes since radio " + String(WakePolicy::wakesSinceRadio()) + ")");
+
+  if (radioUp) {
+    registerRadioStages();
+    runBootStages();
+    wifiFailedThisWake = !boot.ok(stWifi);
+    WakePolicy::radioDone(boot.ok(stMqtt) && boot.ok(stBatch), soilPercent);
+    publishBootProfile();
   } else {
-    debugLog("SOIL: ok");
+    WakePolicy::radioSkipped();
   }
 
   setupDoneTime = millis();
@@ -357,27 +707,28 @@ void setup() {
 // =======================================================
 
 void loop() {
-  ArduinoOTA.handle();
-  
-  // Monitor pump runtime for safety failsafe
-  if (pumpController) {
-    pumpController->loop();
-    
-    // Publish emergency alert if pump exceeded max runtime
-    if (pumpController->isEmergencyStop() && mqttReady) {
-      String alertTopic = "bonsai/" + deviceId + "/alert/pump";
-      mqttClient.publish(alertTopic.c_str(), "EMERGENCY_STOP", true);
-      debugLog("[PUMP] Published emergency stop alert");
-    }
+  serviceTick();
+
+  // Sessioni lunghe (debug/webserver): sensore e batteria restano aggiornati
+  // per publishStatus(); la raffica DMA costa pochi ms al task di controllo
+  static unsigned long lastSampleMs = setupDoneTime;
+  if (millis() - lastSampleMs >= SENSOR_REFRESH_MS) {
+    lastSampleMs = millis();
+    ControlTask::send(ControlCmd::SampleSoil);
   }
-  
-  if (mqttReady) {
-    loopMqtt();
+
+  // Primo giro dopo setup() (radio già su: c'è anche l'RSSI), poi ogni HISTORY_SAMPLE_MIN_S
+  if (soilSampleReady) recordHistory(HistoryKind::Sample);
+
+  // Settori del kvstore liberati fuori dai salvataggi, non durante un put()
+  static unsigned long lastKvMaintainMs = setupDoneTime;
+  if (millis() - lastKvMaintainMs >= KV_MAINTAIN_MS) {
+    lastKvMaintainMs = millis();
+    kvMaintain();
   }
-  loopTelnetLogger();
-  esp_task_wdt_reset();
 
   // Deep sleep management: garantisce almeno un ciclo completo di loop() prima di sleep
+  // (senza radio non c'è niente da servire: si dorme subito)
   if (!config.debug) {
     unsigned long elapsed = millis() - setupDoneTime;
     unsigned long timeoutMs = 0;
@@ -390,16 +741,47 @@ void loop() {
       timeoutMs = 2000;  // Minimo 2 secondi per inizializzazione servizi
     }
     
-    if (elapsed >= timeoutMs) {
+    if (elapsed >= timeoutMs || !radioUp) {
       debugLog("SLEEP: timeout reached (" + String(elapsed) + "ms)");
       
-      // Save pump state before sleep
+      // Save pump state before sleep (dopo che il task ha applicato l'ultimo comando)
       if (pumpController) {
-        pumpStateAfterWakeup = pumpController->getState();
+        const unsigned long t0 = millis();
+        while (!ControlTask::synced() && millis() - t0 < CONTROL_SYNC_TIMEOUT_MS) delay(1);
+        pumpStateAfterWakeup = ControlTask::pumpOn();
         debugLog("PUMP: saving state " + String(pumpStateAfterWakeup ? "ON" : "OFF") + " before sleep");
       }
       
-      esp_sleep_enable_timer_wakeup(config.sleep_hours * 3600ULL * 1000000ULL);
+      // Trend dell'umidità: un punto per wake (solo se la misura è arrivata)
+      const uint32_t nowS = SleepScheduler::nowS();
+      if (soilSampleReady) SleepScheduler::record(nowS, soilPercent, wateredThisWake);
+
+      // Senza lettura in questo wake soilPercent non vale nulla: sleep_hours
+      uint64_t sleepUs = config.sleep_hours * 3600ULL * 1000000ULL;
+      if (config.adaptive_sleep && soilSampleReady) {
+        SleepPlan plan = SleepScheduler::plan(config, soilPercent, batteryMv);
+        sleepUs = plan.sleepS * 1000000ULL;
+        debugLog("SLEEP: " + String(SleepScheduler::reasonStr(plan.reason)) + " " +
+                 String(plan.sleepS) + "s (slope " + String(plan.slopeX100) + "/100 %/h, " +
+                 String(SleepScheduler::historyCount()) + " pts" +
+                 (plan.stretched ? ", low battery)" : ")"));
+      }
+      // Senza rete in questo wake si riprova prima del prossimo ciclo completo
+      if (wifiFailedThisWake && sleepUs > WIFI_RETRY_SLEEP_US) sleepUs = WIFI_RETRY_SLEEP_US;
+
+      if (radioUp && !mqttFlush(MQTT_FLUSH_TIMEOUT_MS)) {
+        debugLog("MQTT: flush timeout, " + String(mqttQueueStats().depth) + " messages lost");
+      }
+      kvMaintain();
+
+      BootProfiler::recordWakeTotal();
+      // Tra un report e l'altro il sensore lo guarda l'ULP
+      if (soilSampleReady && UlpMonitor::arm(config, soilValue)) debugLog("SLEEP: ULP monitor armed");
+      // Wake di routine chiusi nello stub; con la pompa accesa serve il boot completo (failsafe)
+      if (!pumpStateAfterWakeup &&
+          WakeStub::arm(config, sleepUs, WakePolicy::quickWakeBudget(config), WakePolicy::lastReportedPercent()))
+        debugLog("SLEEP: wake stub armed");
+      esp_sleep_enable_timer_wakeup(sleepUs);
       delay(100);
       esp_deep_sleep_start();
     }
@@ -1,16 +1,121 @@
 #include "mqtt.h"
 #include "pump_controller.h"
 #include "trigger_firmware_check.h"
+#include "telemetry_codec.h"
+#include "report_policy.h"
+#include "mqtt_router.h"
+#include "control_task.h"
+#include "config_schema.h"
+#include <atomic>
+
+extern "C" {
+  #include "esp_task_wdt.h"
+}
 
 unsigned long lastMqttPublish = 0;
 const unsigned long mqttInterval = 15000; // 15s
 
+static const unsigned long MQTT_RETRY_MS = 2000;     // pausa tra tentativi (nel worker, non blocca loop())
+static const uint16_t MQTT_SOCKET_TIMEOUT_S = 4;     // limite di attesa per connect/CONNACK
+// Lotto telemetria (~2 KB) o config JSON completo in arrivo, più topic; default 256
+static const uint16_t MQTT_BUFFER_SIZE = CONFIG_BODY_MAX + 256 > 2304 ? CONFIG_BODY_MAX + 256 : 2304;
+static unsigned long lastConnectAttempt = 0;
+static bool connectAttempted = false;
+
+// =======================================================
+// ======================== CODE =========================
+// =======================================================
+// Uscita: publishMqtt() accoda, il worker invia. Entrata: il callback del
+// client accoda, loopMqtt() smista con mqttCallback() nel contesto di loop().
+
+static const size_t MQTT_OUTBOX_ARENA = 4096;     // ~2 lotti telemetria
+static const size_t MQTT_INBOX_ARENA = CONFIG_BODY_MAX + 256;   // config JSON completo + comandi
+static const uint8_t MQTT_TX_BUDGET = 8;          // messaggi inviati per passo del worker
+static const uint32_t MQTT_TASK_STACK = 6144;
+static const uint32_t MQTT_TASK_PERIOD_MS = 10;
+
+static uint8_t s_outboxArena[MQTT_OUTBOX_ARENA];
+static uint8_t s_inboxArena[MQTT_INBOX_ARENA];
+static MqttQueue s_outbox(s_outboxArena, sizeof(s_outboxArena));
+static MqttQueue s_inbox(s_inboxArena, sizeof(s_inboxArena));
+
+static uint8_t s_txBuf[MQTT_BUFFER_SIZE];
+static uint8_t s_rxBuf[MQTT_INBOX_ARENA + 1];
+
+static std::atomic<bool> s_linkUp(false);
+static std::atomic<bool> s_inFlight(false);
+static std::atomic<bool> s_sessionStarted(false);
+static bool s_workerStarted = false;
+
+// Hot reload: loop() chiede la pausa, il worker la conferma e non tocca più config
+static std::atomic<bool> s_pauseReq(false);
+static std::atomic<bool> s_paused(false);
+static std::atomic<bool> s_reconnectReq(false);
+
+// Riavvio chiesto da un comando (reboot, config/set): lo esegue il worker
+static const unsigned long MQTT_RESTART_DRAIN_MS = 1000;   // ack e snapshot in coda
+static const unsigned long MQTT_RESTART_GRACE_MS = 100;    // PUBACK/DISCONNECT escono dallo stack TCP
+static std::atomic<bool> s_restartReq(false);
+static unsigned long s_restartReqMs = 0;
+
+// =======================================================
+// ================== SESSIONE PERSISTENTE ===============
+// =======================================================
+// Con cleanSession off il broker conserva subscription e messaggi QoS 1 tra
+// un wake e l'altro: se l'insieme dei topic non è cambiato i subscribe (e lo
+// snapshot retained) si saltano. PubSubClient non espone il flag
+// sessionPresent del CONNACK, quindi la sessione viene comunque rinnovata
+// ogni MQTT_RESUBSCRIBE_EVERY connessioni nel caso il broker l'abbia persa.
+
+static const uint8_t MQTT_SUB_QOS = 1;
+static const uint16_t MQTT_RESUBSCRIBE_EVERY = 24;
+static const uint32_t MQTT_SESSION_MAGIC = 0x4D515353;  // "MQSS"
+
+struct MqttSessionRtc {
+  uint32_t magic;
+  uint32_t subsHash;                // hash di broker, utente e topic sottoscritti
+  uint16_t connectsSinceSubscribe;
+};
+
+RTC_DATA_ATTR static MqttSessionRtc s_session;
+
+static inline uint32_t fnvAppend(uint32_t h, const char* s)
+{
+  while (*s) {
+    h ^= (uint8_t)*s++;
+    h *= 16777619u;
+  }
+  return h ^ 0xFF;  // separatore: "ab"+"c" ≠ "a"+"bc"
+}
+
+static uint32_t sessionHash()
+{
+  uint32_t h = 2166136261u;
+  h = fnvAppend(h, config.mqtt_broker.c_str());
+  h = fnvAppend(h, String(config.mqtt_port).c_str());
+  h = fnvAppend(h, config.mqtt_username.c_str());
+  h = fnvAppend(h, deviceId.c_str());
+  for (uint8_t i = 0; i < MqttRouter::subscriptionCount(); i++)
+    h = fnvAppend(h, MqttRouter::subscription(i));
+  return h ^ MQTT_SUB_QOS;
+}
+
+// true se la sessione sul broker ha già le subscription correnti
+static bool sessionResumable(uint32_t hash)
+{
+  return config.mqtt_persistent_session &&
+         s_session.magic == MQTT_SESSION_MAGIC &&
+         s_session.subsHash == hash &&
+         s_session.connectsSinceSubscribe < MQTT_RESUBSCRIBE_EVERY;
+}
+
 String deviceId = "";
 
 // Variabili globali
 extern Config config;
 extern int soilValue;
 extern int soilPercent;
+extern int batteryMv;
 extern PumpController* pumpController;
 
 bool mqttReady = false;
@@ -30,7 +135,7 @@ bool isNewerConfigVersion(const String& incoming, const String& current)
   return incoming != current && incoming > current;
 }
 
-// 🔥 Ora usa SEMPRE la API nuova e sicura
+// 🔥 Ora usa SEMPRE la API nuova e sicura (riavvia solo se la modifica lo richiede)
 bool applyConfigJson(const String& json)
 {
   return applyAndPersistConfigJson(json, true);
@@ -42,33 +147,15 @@ bool applyConfigJson(const String& json)
 
 void publishConfigSnapshot()
 {
-  StaticJsonDocument<1024> doc;
-  doc["wifi_ssid"]            = config.wifi_ssid;
-  doc["wifi_password"]        = config.wifi_password;
-  doc["mqtt_broker"]          = config.mqtt_broker;
-  doc["mqtt_port"]            = config.mqtt_port;
-  doc["mqtt_username"]        = config.mqtt_username;
-  doc["mqtt_password"]        = config.mqtt_password;
-  doc["sensor_pin"]           = config.sensor_pin;
-  doc["pump_pin"]             = config.pump_pin;
-  doc["relay_pin"]            = config.relay_pin;
-  doc["battery_pin"]          = config.battery_pin;
-  doc["moisture_threshold"]   = config.moisture_threshold;
-  doc["pump_duration"]        = config.pump_duration;
-  doc["measurement_interval"] = config.measurement_interval;
-  doc["use_pump"]             = config.use_pump;
-  doc["debug"]                = config.debug;
-  doc["enable_webserver"]     = config.enable_webserver;
-  doc["sleep_hours"]          = config.sleep_hours;
-  doc["use_dhcp"]             = config.use_dhcp;
-  doc["ip_address"]           = config.ip_address;
-  doc["gateway"]              = config.gateway;
-  doc["subnet"]               = config.subnet;
-  doc["ota_manifest_url"]     = config.ota_manifest_url;
-  doc["update_server"]        = config.update_server;
-  doc["config_version"]       = config.config_version;
-  doc["timezone"]              = config.timezone;
-  doc["device_id"]            = deviceId;
+  publishConfigSnapshot(config);
+}
+
+void publishConfigSnapshot(const Config& c)
+{
+  // Config completo + device_id ("bonsai-" + MAC)
+  StaticJsonDocument<CONFIG_JSON_CAPACITY + JSON_OBJECT_SIZE(1) + JSON_STRING_SIZE(32)> doc;
+  ConfigSchema::toJson(c, doc);
+  doc["device_id"] = deviceId;
 
   String out;
   serializeJson(doc, out);
@@ -80,173 +167,351 @@ void publishConfigSnapshot()
 // ===================== MQTT CALLBACK ===================
 // =======================================================
 
-void mqttCallback(char *topic, byte *payload, unsigned int length)
+// Confronto case-insensitive tra payload (non terminato) e parola chiave minuscola
+static bool payloadEquals(const char* p, size_t len, const char* word)
 {
-  String message;
-  message.reserve(length);
-  for (unsigned int i = 0; i < length; i++)
-    message += (char)payload[i];
+  size_t i = 0;
+  for (; i < len && word[i]; i++)
+    if (tolower((unsigned char)p[i]) != word[i]) return false;
+  return i == len && word[i] == '\0';
+}
 
-  if (config.debug)
-    Serial.printf("[MQTT] Topic: %s | Msg: %s\n", topic, message.c_str());
+static void publishConfigAck(bool ok)
+{
+  char topic[MqttRouter::MAX_TOPIC_LEN];
+  snprintf(topic, sizeof(topic), "bonsai/%s/config/ack", deviceId.c_str());
+  publishMqtt(topic, ok ? "{\"ok\":true}" : "{\"ok\":false}");
+}
 
-  const String t(topic);
-  String msg = message;
-  msg.trim();
+// Parse direttamente dal buffer di ricezione. Riavvio solo per i campi che
+// non si applicano a caldo (WiFi, pin, rete, webserver)
+static void applyConfigPayload(const char* msg, size_t len)
+{
+  ConfigApply applied;
+  Config saved;
+  bool ok = persistAndApplyConfig(msg, len, applied, saved);
+  publishConfigAck(ok);
+
+  if (ok)
+    finishConfigApply(applied, saved, true);
+}
 
-  // ========= PUMP COMMAND ===========
-  String msgLower = msg; 
-  msgLower.toLowerCase();
+static void handlePumpCommand(const char* msg, size_t len)
+{
+  if (!pumpController) return;
 
-  if (msg.startsWith("{"))
+  // Payload "on"/"off" oppure {"pump":"on"}, letto direttamente dal buffer MQTT
+  const char* cmd = msg;
+  size_t cmdLen = len;
+  StaticJsonDocument<128> j;
+  if (len > 0 && msg[0] == '{')
   {
-    StaticJsonDocument<128> j;
-    if (deserializeJson(j, msg) == DeserializationError::Ok && j.containsKey("pump"))
-      msgLower = String(j["pump"].as<const char*>());
+    if (deserializeJson(j, msg, len) != DeserializationError::Ok) return;
+    cmd = j["pump"] | "";
+    cmdLen = strlen(cmd);
   }
 
-  // ========= CONFIG SET DIRECT ===========
-  if (t == "bonsai/config/set" || t == ("bonsai/" + deviceId + "/config/set"))
-  {
-    bool ok = applyConfigJson(msg);
-    publishMqtt("bonsai/" + deviceId + "/config/ack", ok ? "{\"ok\":true}" : "{\"ok\":false}");
+  bool on = payloadEquals(cmd, cmdLen, "on");
+  bool off = payloadEquals(cmd, cmdLen, "off");
+  if (!on && !off) return;
 
-    if (ok)
-    {
-      publishConfigSnapshot();
-      delay(300);
-      ESP.restart();
-    }
-    return;
-  }
+  // Lo stato (status/pump, last_on) lo pubblica loop() all'evento del task di controllo
+  ControlTask::send(on ? ControlCmd::PumpOn : ControlCmd::PumpOff);
+}
 
-  // ========= CONFIG VERSIONED UPDATE ===========
-  if (t == "bonsai/config" || t == ("bonsai/" + deviceId + "/config"))
+// 🔥 Ora usa SEMPRE la API nuova e sicura
+void mqttCallback(char *topic, byte *payload, unsigned int length)
+{
+  if (config.debug)
+    Serial.printf("[MQTT] Topic: %s | Msg: %.*s\n", topic, (int)length, (const char*)payload);
+
+  // Trim in place: nessuna copia del payload
+  const char* msg = (const char*)payload;
+  size_t len = length;
+  while (len > 0 && isspace((unsigned char)msg[0])) { msg++; len--; }
+  while (len > 0 && isspace((unsigned char)msg[len - 1])) len--;
+
+  switch (MqttRouter::route(topic))
   {
-    StaticJsonDocument<256> j;
-    if (deserializeJson(j, msg) == DeserializationError::Ok)
+    // ========= CONFIG SET DIRECT ===========
+    case MqttRoute::ConfigSet:
+      applyConfigPayload(msg, len);
+      return;
+
+    // ========= CONFIG VERSIONED UPDATE ===========
+    case MqttRoute::ConfigVersioned:
     {
-      const String incomingVer = j["config_version"] | "";
+      // Serve solo config_version: il filtro evita di dimensionare il doc sull'intero config
+      StaticJsonDocument<32> filter;
+      filter["config_version"] = true;
+      StaticJsonDocument<96> j;
+      if (deserializeJson(j, msg, len, DeserializationOption::Filter(filter)) != DeserializationError::Ok)
+        return;
+
+      const char* incomingVer = j["config_version"] | "";
       if (isNewerConfigVersion(incomingVer, config.config_version))
-      {
-        bool ok = applyConfigJson(msg);
-        publishMqtt("bonsai/" + deviceId + "/config/ack", ok ? "{\"ok\":true}" : "{\"ok\":false}");
-
-        if (ok)
-        {
-          publishConfigSnapshot();
-          delay(300);
-          ESP.restart();
-        }
-      }
+        applyConfigPayload(msg, len);
+      return;
     }
-    return;
-  }
 
-  // ========= PUMP CONTROL ===========
-  if (t == ("bonsai/" + deviceId + "/command/pump"))
-  {
-    if (!pumpController) return;
-    
-    bool on = (msgLower == "on");
-    bool off = (msgLower == "off");
-    if (!on && !off) return;
+    // ========= CONFIG (OLD TOPICS) ===========
+    case MqttRoute::ConfigLegacy:
+      applyAndPersistConfigJson(msg, len, true);
+      return;
 
-    const String base = "bonsai/" + deviceId + "/status/";
+    // ========= PUMP CONTROL ===========
+    case MqttRoute::Pump:
+      handlePumpCommand(msg, len);
+      return;
 
-    if (on)
-    {
-      pumpController->turnOn();
-      publishMqtt(base + "pump", "on", true);
-
-      unsigned long long ms = epochMs();
-      if (ms > 0)
-      {
-        char buf[32];
-        snprintf(buf, sizeof(buf), "%llu", ms);
-        publishMqtt(base + "last_on", buf, true);
-      }
-    }
-    else
-    {
-      pumpController->turnOff();
-      publishMqtt(base + "pump", "off", true);
-    }
-    return;
+    // ========= REBOOT ===========
+    case MqttRoute::Reboot:
+      mqttRestart();
+      return;
+
+    // ========= FORCED OTA ===========
+    case MqttRoute::Ota:
+      triggerFirmwareCheck();
+      return;
+
+    case MqttRoute::None:
+      return;
   }
+}
 
-  // ========= REBOOT ===========
-  if (t == ("bonsai/" + deviceId + "/command/reboot") ||
-      t == ("bonsai/" + deviceId + "/command/restart"))
+// =======================================================
+// ===================== CONNECTION ======================
+// =======================================================
+
+// Un solo tentativo, limitato da MQTT_SOCKET_TIMEOUT_S: i retry li decide il chiamante
+bool connectMqtt()
+{
+  if (mqttClient.connected()) return true;
+
+  mqttClient.setServer(config.mqtt_broker.c_str(), config.mqtt_port);
+  lastConnectAttempt = millis();
+  connectAttempted = true;
+
+  Serial.printf("[MQTT] Connessione a %s:%d...\n",
+                config.mqtt_broker.c_str(), config.mqtt_port);
+
+  bool ok = mqttClient.connect(
+    deviceId.c_str(),
+    config.mqtt_username.c_str(),
+    config.mqtt_password.c_str(),
+    ("bonsai/" + deviceId + "/status/online").c_str(),
+    1, true, "0",
+    !config.mqtt_persistent_session
+  );
+
+  if (!ok)
   {
-    ESP.restart();
-    return;
+    Serial.print("❌ Fallita. Stato: ");
+    Serial.println(mqttClient.state());
+    return false;
   }
 
-  // ========= FORCED OTA ===========
-  if (t == ("bonsai/" + deviceId + "/command/ota") ||
-      t == ("bonsai/ota/force/" + deviceId))
+  Serial.println("✅ MQTT connesso!");
+  mqttReady = true;
+  s_linkUp = true;
+  s_sessionStarted = true;  // loopMqtt resetta la politica di report: il primo publishStatus invia tutto
+
+  String base = "bonsai/" + deviceId + "/";
+
+  publishMqtt(base + "status/online", "1", true);
+
+  const uint32_t hash = sessionHash();
+  if (sessionResumable(hash))
   {
-    triggerFirmwareCheck();
-    return;
+    s_session.connectsSinceSubscribe++;
+    Serial.printf("[MQTT] Sessione ripresa (%u/%u), subscribe saltati\n",
+                  s_session.connectsSinceSubscribe, MQTT_RESUBSCRIBE_EVERY);
+    return true;
   }
 
-  // ========= CONFIG API COMMANDS (OLD TOPICS) ===========
-  handleMqttConfigCommands(topic, payload, length);
+  publishMqtt(base + "status/device_id", deviceId, true);
+
+#ifdef FIRMWARE_VERSION
+  // In modalità binaria il firmware non viaggia nel frame: retained una volta per sessione
+  if (config.telemetry_binary)
+    publishMqtt(base + "status/firmware", FIRMWARE_VERSION, true);
+#endif
+
+  // Stessi topic instradati da mqttCallback (tabella in mqtt_router.cpp)
+  bool subscribed = true;
+  for (uint8_t i = 0; i < MqttRouter::subscriptionCount(); i++)
+    subscribed &= mqttClient.subscribe(MqttRouter::subscription(i), MQTT_SUB_QOS);
+
+  // Si ricorda la sessione solo se tutti i subscribe sono partiti
+  s_session.magic = subscribed ? MQTT_SESSION_MAGIC : 0;
+  s_session.subsHash = hash;
+  s_session.connectsSinceSubscribe = 0;
+
+  publishConfigSnapshot();
+  return true;
 }
 
 // =======================================================
-// ===================== CONNECTION ======================
+// ======================= WORKER ========================
 // =======================================================
 
-void connectMqtt()
+// Callback del client (contesto worker): niente logica qui, solo copia in coda
+static void onMqttMessage(char* topic, byte* payload, unsigned int length)
 {
-  mqttClient.setServer(config.mqtt_broker.c_str(), config.mqtt_port);
-  mqttClient.setCallback(mqttCallback);
+  s_inbox.push(topic, payload, length, false);
+}
+
+// PubSubClient manda il PUBACK di un messaggio QoS 1 solo dopo il ritorno del
+// callback, dentro mqttClient.loop(): un riavvio prima lascia il comando non
+// confermato, la sessione persistente lo riconsegna al boot e il dispositivo
+// si riavvia in loop. Qui si passa solo dopo un loop() tornato, con la coda
+// vuota (o scaduto MQTT_RESTART_DRAIN_MS) o il link già caduto.
+static void restartIfRequested()
+{
+  if (!s_restartReq.load(std::memory_order_acquire)) return;
+  const bool linked = mqttClient.connected();
+  if (linked && (s_outbox.depth() > 0 || s_inFlight) &&
+      millis() - s_restartReqMs < MQTT_RESTART_DRAIN_MS) return;
+
+  s_restartReq = false;
+  if (linked) mqttClient.disconnect();
+  delay(MQTT_RESTART_GRACE_MS);
+  ESP.restart();
+}
 
-  while (!mqttClient.connected())
+void mqttWorkerStep()
+{
+  if (s_pauseReq.load(std::memory_order_acquire))
   {
-    Serial.printf("[MQTT] Connessione a %s:%d...\n",
-                  config.mqtt_broker.c_str(), config.mqtt_port);
-
-    bool ok = mqttClient.connect(
-      deviceId.c_str(),
-      config.mqtt_username.c_str(),
-      config.mqtt_password.c_str(),
-      ("bonsai/" + deviceId + "/status/online").c_str(),
-      1, true, "0"
-    );
-
-    if (ok)
+    s_paused.store(true, std::memory_order_release);
+    return;
+  }
+
+  if (s_reconnectReq.exchange(false))
+  {
+    // Broker o credenziali cambiati: nuova connessione subito, senza attesa di retry
+    if (mqttClient.connected()) mqttClient.disconnect();
+    s_linkUp = false;
+    connectAttempted = false;
+  }
+
+  if (!mqttClient.connected())
+  {
+    s_linkUp = false;
+    restartIfRequested();
+    if (connectAttempted && millis() - lastConnectAttempt < MQTT_RETRY_MS) return;
+    if (!connectMqtt()) return;
+  }
+
+  mqttClient.loop();
+
+  MqttMessage m;
+  for (uint8_t i = 0; i < MQTT_TX_BUDGET; i++)
+  {
+    s_inFlight = true;
+    if (!s_outbox.pop(m, s_txBuf, sizeof(s_txBuf)))
+    {
+      s_inFlight = false;
+      break;
+    }
+    bool ok = mqttClient.publish(m.topic, s_txBuf, (unsigned)m.len, m.retain);
+    s_outbox.recordSent(m.enqueuedUs, ok);
+    if (!ok && !mqttClient.connected())
     {
-      Serial.println("✅ MQTT connesso!");
-      mqttReady = true;
+      // Link caduto durante l'invio: torna in coda per la prossima sessione
+      s_outbox.push(m.topic, s_txBuf, m.len, m.retain);
+      s_inFlight = false;
+      break;
+    }
+    s_inFlight = false;
+  }
 
-      String base = "bonsai/" + deviceId + "/";
+  restartIfRequested();
+}
 
-      publishMqtt(base + "status/online", "1", true);
-      publishMqtt(base + "status/device_id", deviceId, true);
+#if MQTT_ASYNC_TASK
+static void mqttTask(void*)
+{
+  // WDT proprio: un connect appeso oltre il timeout del watchdog è un guasto da resettare
+  esp_task_wdt_add(NULL);
+  for (;;)
+  {
+    mqttWorkerStep();
+    esp_task_wdt_reset();
+    vTaskDelay(pdMS_TO_TICKS(MQTT_TASK_PERIOD_MS));
+  }
+}
+#endif
 
-      mqttClient.subscribe((base + "command/pump").c_str());
-      mqttClient.subscribe((base + "command/reboot").c_str());
-      mqttClient.subscribe((base + "command/restart").c_str());
-      mqttClient.subscribe((base + "command/ota").c_str());
-      mqttClient.subscribe((base + "config").c_str());
-      mqttClient.subscribe((base + "config/set").c_str());
-      mqttClient.subscribe(("bonsai/ota/force/" + deviceId).c_str());
+bool mqttEnqueue(const char* topic, const uint8_t* payload, size_t len, bool retain)
+{
+  return s_outbox.push(topic, payload, len, retain);
+}
 
-      mqttClient.subscribe("bonsai/config");
-      mqttClient.subscribe("bonsai/config/set");
+bool mqttConnected()
+{
+  return s_linkUp;
+}
 
-      publishConfigSnapshot();
-    }
-    else
+MqttQueueStats mqttQueueStats()
+{
+  return s_outbox.stats();
+}
+
+bool mqttFlush(unsigned long timeoutMs)
+{
+  const unsigned long t0 = millis();
+  while (s_outbox.depth() > 0 || s_inFlight)
+  {
+    if (millis() - t0 >= timeoutMs) return false;
+#if MQTT_ASYNC_TASK
+    delay(MQTT_TASK_PERIOD_MS);
+#else
+    mqttWorkerStep();
+    if (!mqttClient.connected()) return false;
+#endif
+  }
+  return true;
+}
+
+bool mqttPause(unsigned long timeoutMs)
+{
+  s_paused = false;
+  s_pauseReq.store(true, std::memory_order_release);
+#if MQTT_ASYNC_TASK
+  const unsigned long t0 = millis();
+  while (s_workerStarted && !s_paused.load(std::memory_order_acquire))
+  {
+    if (millis() - t0 >= timeoutMs)
     {
-      Serial.print("❌ Fallita. Stato: ");
-      Serial.println(mqttClient.state());
-      delay(2000);
+      s_pauseReq = false;
+      return false;
     }
+    esp_task_wdt_reset();
+    delay(MQTT_TASK_PERIOD_MS);
+  }
+#else
+  (void)timeoutMs;  // worker inline in loopMqtt(): già fermo
+#endif
+  return true;
+}
+
+void mqttRestart()
+{
+  // Senza worker non c'è nessun comando MQTT da confermare
+  if (!s_workerStarted)
+  {
+    ESP.restart();
+    return;
   }
+  s_restartReqMs = millis();
+  s_restartReq.store(true, std::memory_order_release);
+}
+
+void mqttResume(bool reconnect)
+{
+  if (reconnect) s_reconnectReq = true;
+  s_pauseReq.store(false, std::memory_order_release);
 }
 
 // =======================================================
@@ -255,36 +520,155 @@ void connectMqtt()
 
 void loopMqtt()
 {
-  if (!mqttClient.connected())
-    connectMqtt();
+  if (!s_workerStarted) return;
 
-  mqttClient.loop();
+#if !MQTT_ASYNC_TASK
+  mqttWorkerStep();
+#endif
+
+  if (s_sessionStarted.exchange(false))
+    ReportPolicy::reset();
 
-  unsigned long now = millis();
-  if (now - lastMqttPublish > mqttInterval)
+  // Comandi ricevuti dal worker, eseguiti qui come prima (pompa, config, OTA)
+  MqttMessage m;
+  while (s_inbox.pop(m, s_rxBuf, sizeof(s_rxBuf) - 1))
   {
-    lastMqttPublish = now;
+    s_rxBuf[m.len] = 0;
+    mqttCallback(m.topic, s_rxBuf, (unsigned int)m.len);
+  }
+
+  if (!s_linkUp) return;
+
+  if (millis() - lastMqttPublish > mqttInterval)
+    publishStatus();
+}
+
+// Un solo frame da 14 byte al posto dei topic testuali (vedi telemetry_codec.h)
+static void publishTelemetryFrame(const TelemetryFrame& f, unsigned long now)
+{
+  // Il frame parte se almeno una metrica è fuori deadband o è scaduto l'heartbeat
+  const bool pumpOn = f.flags & TELEMETRY_BIT_PUMP_ON;
+  if (!ReportPolicy::due(config, StatusMetric::Humidity, f.soilPct, now) &&
+      !ReportPolicy::due(config, StatusMetric::Wifi, f.rssi, now) &&
+      !ReportPolicy::due(config, StatusMetric::Battery, f.battery, now) &&
+      !ReportPolicy::due(config, StatusMetric::Pump, pumpOn, now) &&
+      !ReportPolicy::due(config, StatusMetric::LastSeen, 0, now))
+    return;
 
-    String base = "bonsai/" + deviceId + "/status/";
+  uint8_t frame[TELEMETRY_FRAME_V1_LEN];
+  size_t n = encodeTelemetryFrame(f, frame, sizeof(frame));
+  if (!mqttReady || n == 0) return;
 
-    if (timeIsValid())
-      publishMqtt(base + "last_seen", String((long long)epochMs()), true);
+  char topic[64];
+  snprintf(topic, sizeof(topic), "bonsai/%s/telemetry", deviceId.c_str());
+  if (!mqttEnqueue(topic, frame, n, false)) return;
 
-    publishMqtt(base + "wifi", String(WiFi.RSSI()), false);
+  ReportPolicy::reported(StatusMetric::Humidity, f.soilPct, now);
+  ReportPolicy::reported(StatusMetric::Wifi, f.rssi, now);
+  ReportPolicy::reported(StatusMetric::Battery, f.battery, now);
+  ReportPolicy::reported(StatusMetric::Pump, pumpOn, now);
+  ReportPolicy::reported(StatusMetric::LastSeen, 0, now);
+}
+
+// Pubblica status/<name> solo se la politica a deadband lo richiede
+static void reportMetric(StatusMetric m, const char* name, int32_t value,
+                         const char* payload, bool retain, unsigned long now)
+{
+  if (!ReportPolicy::due(config, m, value, now)) return;
+  if (!mqttReady) return;
+
+  char topic[96];
+  snprintf(topic, sizeof(topic), "bonsai/%s/status/%s", deviceId.c_str(), name);
+  if (mqttEnqueue(topic, (const uint8_t*)payload, strlen(payload), retain))
+    ReportPolicy::reported(m, value, now);
+}
+
+static void reportMetric(StatusMetric m, const char* name, int32_t value, bool retain, unsigned long now)
+{
+  char payload[16];
+  snprintf(payload, sizeof(payload), "%ld", (long)value);
+  reportMetric(m, name, value, payload, retain, now);
+}
+
+// Diagnostica della coda in uscita (solo con l'heartbeat)
+static void reportQueueStats(unsigned long now)
+{
+  if (!ReportPolicy::due(config, StatusMetric::MqttQueue, 0, now)) return;
+
+  const MqttQueueStats st = s_outbox.stats();
+  char json[192];
+  snprintf(json, sizeof(json),
+           "{\"depth\":%u,\"max\":%u,\"enq\":%lu,\"sent\":%lu,\"drop\":%lu,"
+           "\"coal\":%lu,\"fail\":%lu,\"lat_avg_us\":%lu,\"lat_max_us\":%lu}",
+           st.depth, st.maxDepth, (unsigned long)st.enqueued, (unsigned long)st.sent,
+           (unsigned long)st.dropped, (unsigned long)st.coalesced, (unsigned long)st.failed,
+           (unsigned long)st.latencyAvgUs, (unsigned long)st.latencyMaxUs);
+  reportMetric(StatusMetric::MqttQueue, "mqtt_queue", 0, json, false, now);
+}
+
+// Jitter del task di controllo (solo con l'heartbeat)
+static void reportControlStats(unsigned long now)
+{
+  if (!ReportPolicy::due(config, StatusMetric::Control, 0, now)) return;
+
+  const ControlStats st = ControlTask::stats();
+  char json[128];
+  snprintf(json, sizeof(json),
+           "{\"iter\":%lu,\"jitter_avg_us\":%lu,\"jitter_max_us\":%lu,\"cmd_drop\":%lu,\"evt_drop\":%lu}",
+           (unsigned long)st.iterations, (unsigned long)st.jitterAvgUs, (unsigned long)st.jitterMaxUs,
+           (unsigned long)st.cmdDropped, (unsigned long)st.evtDropped);
+  reportMetric(StatusMetric::Control, "control", 0, json, false, now);
+}
+
+void publishStatus()
+{
+  const unsigned long now = millis();
+  lastMqttPublish = now;
+
+  // Letture una volta sola, poi ogni metrica passa dalla politica di report
+  TelemetryFrame f = {};
+  time_t nowSec = time(nullptr);
+  if (timeIsValid()) {
+    f.ts = (uint32_t)nowSec;
+    f.flags |= TELEMETRY_BIT_TIME_VALID;
+  }
+  if (pumpController) {
+    if (ControlTask::pumpOn()) f.flags |= TELEMETRY_BIT_PUMP_ON;
+    if (ControlTask::emergencyStop()) f.flags |= TELEMETRY_BIT_PUMP_ALERT;
+  }
+  f.rssi = (int8_t)constrain(WiFi.RSSI(), -128, 127);
+  f.soilPct = (uint8_t)constrain(soilPercent, 0, 100);
+  f.soilRaw = (uint16_t)soilValue;
+  f.battery = (uint16_t)batteryMv;   // dall'ultima misura del task di controllo
+  f.tempC10 = 0;  // nessun sensore di temperatura (come status/temp)
+
+  reportQueueStats(now);
+  reportControlStats(now);
+
+  if (config.telemetry_binary) {
+    publishTelemetryFrame(f, now);
+    return;
+  }
+
+  if (f.flags & TELEMETRY_BIT_TIME_VALID) {
+    char ts[24];
+    snprintf(ts, sizeof(ts), "%llu", epochMs());
+    reportMetric(StatusMetric::LastSeen, "last_seen", 0, ts, true, now);
+  }
+
+  reportMetric(StatusMetric::Wifi, "wifi", f.rssi, false, now);
 
 #ifdef FIRMWARE_VERSION
-    publishMqtt(base + "firmware", FIRMWARE_VERSION, true);
+  reportMetric(StatusMetric::Firmware, "firmware", 0, FIRMWARE_VERSION, true, now);
 #endif
 
-    publishMqtt(base + "humidity", String(soilPercent), false);
-    publishMqtt(base + "temp", "0", false);
-    publishMqtt(base + "battery", String(analogRead(config.battery_pin)), false);
+  reportMetric(StatusMetric::Humidity, "humidity", soilPercent, false, now);
+  reportMetric(StatusMetric::Temp, "temp", f.tempC10 / 10, false, now);
+  reportMetric(StatusMetric::Battery, "battery", f.battery, false, now);
 
-    if (pumpController) {
-      publishMqtt(base + "pump",
-        pumpController->getState() ? "on" : "off", true
-      );
-    }
+  if (pumpController) {
+    const bool on = f.flags & TELEMETRY_BIT_PUMP_ON;
+    reportMetric(StatusMetric::Pump, "pump", on, on ? "on" : "off", true, now);
   }
 }
 
@@ -305,9 +689,19 @@ void setupMqtt()
   {
     secureClient = new WiFiClientSecure();
     secureClient->setInsecure();
+    // Default 120 s: oltre il task watchdog del worker
+    secureClient->setHandshakeTimeout(MQTT_SOCKET_TIMEOUT_S);
     mqttClient.setClient(*secureClient);
   }
 
-  mqttClient.setCallback(mqttCallback);
-  connectMqtt();
+  mqttClient.setCallback(onMqttMessage);
+  mqttClient.setSocketTimeout(MQTT_SOCKET_TIMEOUT_S);
+  mqttClient.setBufferSize(MQTT_BUFFER_SIZE);
+
+  if (s_workerStarted) return;
+  s_workerStarted = true;
+#if MQTT_ASYNC_TASK
+  // Core 0 come lo stack WiFi: connect TLS e socket bloccanti restano fuori da loop()
+  xTaskCreatePinnedToCore(mqttTask, "mqtt", MQTT_TASK_STACK, nullptr, 1, nullptr, 0);
+#endif
 }
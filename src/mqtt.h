@@ -10,6 +10,16 @@
 
 #include "config.h"
 #include "config_api.h"
+#include "mqtt_router.h"
+#include "mqtt_queue.h"
+
+// 1 = I/O MQTT (connect, loop, publish) in un task FreeRTOS dedicato sul core 0:
+//     loop() non aspetta mai il broker. 0 = tutto inline in loopMqtt() (env native).
+#ifdef NATIVE_BUILD
+  #define MQTT_ASYNC_TASK 0
+#else
+  #define MQTT_ASYNC_TASK 1
+#endif
 
 // Forward declaration
 void triggerFirmwareCheck();
@@ -20,6 +30,7 @@ void triggerFirmwareCheck();
 extern Config config;
 extern int soilValue;
 extern int soilPercent;
+extern int batteryMv;
 extern String deviceId;
 
 extern WiFiClient* plainClient;
@@ -47,12 +58,22 @@ static inline unsigned long long epochMs() {
   return 0;
 }
 
+// Accoda un messaggio in uscita (non blocca mai); false se scartato
+bool mqttEnqueue(const char* topic, const uint8_t* payload, size_t len, bool retain);
+
 static inline void publishMqtt(const String& topic, const String& payload, bool retain = false) {
     if (!mqttReady) {
         return; // MQTT non pronto → ignora ma NON rompe niente
     }
-    if (mqttClient.connected())
-    mqttClient.publish(topic.c_str(), payload.c_str(), retain);
+    mqttEnqueue(topic.c_str(), (const uint8_t*)payload.c_str(), payload.length(), retain);
+}
+
+// Variante senza String per i percorsi caldi (topic già formattati in un buffer)
+static inline void publishMqtt(const char* topic, const char* payload, bool retain = false) {
+    if (!mqttReady) {
+        return;
+    }
+    mqttEnqueue(topic, (const uint8_t*)payload, strlen(payload), retain);
 }
 
 static inline void setupDeviceId() {
@@ -60,6 +81,7 @@ static inline void setupDeviceId() {
   deviceId.replace(":", "");
   deviceId.toLowerCase();
   deviceId = "bonsai-" + deviceId;
+  MqttRouter::build(deviceId.c_str());
 }
 
 // =====================
@@ -69,7 +91,21 @@ static inline void setupDeviceId() {
 bool isNewerConfigVersion(const String& incoming, const String& current);
 bool applyConfigJson(const String& json);
 void publishConfigSnapshot();
+void publishConfigSnapshot(const Config& c);
 void mqttCallback(char* topic, byte* payload, unsigned int length);
-void connectMqtt();
-void loopMqtt();
-void setupMqtt();
+bool connectMqtt();   // singolo tentativo (contesto del worker MQTT)
+void loopMqtt();      // contesto di loop(): comandi in arrivo + publishStatus periodico
+void publishStatus(); // humidity, pump, wifi, battery... (periodico in loopMqtt)
+void setupMqtt();     // configura il client e avvia il worker, che si connette da solo
+
+void mqttWorkerStep();              // connect/loop/invio coda: dal task o inline (native)
+bool mqttConnected();               // stato del link visto dal worker
+bool mqttFlush(unsigned long timeoutMs);  // attende lo svuotamento della coda (prima del deep sleep)
+void mqttRestart();                 // riavvio dal worker, dopo il PUBACK del comando e la coda svuotata
+MqttQueueStats mqttQueueStats();
+
+// Hot reload dei campi MQTT: il worker si ferma al passo successivo (false se
+// non ci arriva entro timeoutMs), mqttResume(true) chiude il link e si
+// riconnette con il config corrente
+bool mqttPause(unsigned long timeoutMs);
+void mqttResume(bool reconnect);
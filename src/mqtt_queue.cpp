@@ -0,0 +1,160 @@
+#include "mqtt_queue.h"
+
+// =======================================================
+// ======================== ARENA ========================
+// =======================================================
+
+// Spazio contiguo per `len` byte dopo la coda dell'arena (eventualmente ripartendo da 0)
+bool MqttQueue::reserve(size_t len, size_t& off)
+{
+  if (count_ == 0) {
+    arenaHead_ = arenaTail_ = 0;
+  }
+
+  if (count_ == 0 || arenaTail_ > arenaHead_) {
+    if (arenaSize_ - arenaTail_ >= len) { off = arenaTail_; return true; }
+    // Wrap: con la coda non vuota testa == coda vuol dire arena piena (count_ distingue)
+    if (len <= arenaHead_) { off = 0; return true; }
+    return false;
+  }
+
+  if (arenaTail_ < arenaHead_ && arenaHead_ - arenaTail_ >= len) {
+    off = arenaTail_;
+    return true;
+  }
+  return false;
+}
+
+void MqttQueue::releaseHead()
+{
+  head_ = (uint8_t)((head_ + 1) % MAX_SLOTS);
+  count_--;
+  if (count_ > 0) arenaHead_ = slots_[head_].off;
+}
+
+void MqttQueue::dropHead()
+{
+  if (slots_[head_].live) {
+    live_--;
+    stats_.dropped++;
+  }
+  releaseHead();
+}
+
+// =======================================================
+// ======================== QUEUE ========================
+// =======================================================
+
+bool MqttQueue::push(const char* topic, const uint8_t* payload, size_t len, bool retain)
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+
+  if (!topic || strlen(topic) >= sizeof(slots_[0].topic) || len >= arenaSize_) {
+    stats_.dropped++;
+    return false;
+  }
+
+  // Coalesce: per un topic retained conta solo l'ultimo valore
+  if (retain) {
+    for (uint8_t i = 0; i < count_; i++) {
+      Slot& s = slots_[(head_ + i) % MAX_SLOTS];
+      if (s.live && s.retain && strcmp(s.topic, topic) == 0) {
+        s.live = false;
+        live_--;
+        stats_.coalesced++;
+      }
+    }
+  }
+
+  // Drop-oldest finché slot e arena non bastano.
+  // Almeno 1 byte anche per payload vuoti: testa == coda significa sempre "piena"
+  const size_t need = len ? len : 1;
+  size_t off = 0;
+  while (count_ >= MAX_SLOTS || !reserve(need, off)) {
+    if (count_ == 0) {
+      stats_.dropped++;
+      return false;
+    }
+    dropHead();
+  }
+
+  Slot& s = slots_[(head_ + count_) % MAX_SLOTS];
+  snprintf(s.topic, sizeof(s.topic), "%s", topic);
+  s.off = off;
+  s.len = len;
+  s.enqueuedUs = (uint32_t)micros();
+  s.retain = retain;
+  s.live = true;
+  if (len) memcpy(arena_ + off, payload, len);
+
+  arenaTail_ = off + need;
+  count_++;
+  live_++;
+
+  stats_.enqueued++;
+  if (live_ > stats_.maxDepth) stats_.maxDepth = live_;
+  return true;
+}
+
+bool MqttQueue::pop(MqttMessage& out, uint8_t* buf, size_t bufLen)
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+
+  // Gli slot sostituiti in testa liberano solo spazio
+  while (count_ > 0 && !slots_[head_].live) releaseHead();
+  if (count_ == 0) return false;
+
+  const Slot& s = slots_[head_];
+  if (s.len > bufLen) {
+    // Non può mai essere inviato: scartato per non bloccare la coda
+    dropHead();
+    return false;
+  }
+
+  memcpy(out.topic, s.topic, sizeof(out.topic));
+  if (s.len) memcpy(buf, arena_ + s.off, s.len);
+  out.len = s.len;
+  out.retain = s.retain;
+  out.enqueuedUs = s.enqueuedUs;
+
+  live_--;
+  releaseHead();
+  return true;
+}
+
+void MqttQueue::recordSent(uint32_t enqueuedUs, bool ok)
+{
+  const uint32_t lat = (uint32_t)micros() - enqueuedUs;
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (!ok) {
+    stats_.failed++;
+    return;
+  }
+  stats_.sent++;
+  if (lat > stats_.latencyMaxUs) stats_.latencyMaxUs = lat;
+  stats_.latencyAvgUs = stats_.sent == 1
+    ? lat
+    : stats_.latencyAvgUs - (stats_.latencyAvgUs >> 3) + (lat >> 3);
+}
+
+uint8_t MqttQueue::depth()
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  return live_;
+}
+
+MqttQueueStats MqttQueue::stats()
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  MqttQueueStats st = stats_;
+  st.depth = live_;
+  return st;
+}
+
+void MqttQueue::clear()
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  head_ = count_ = live_ = 0;
+  arenaHead_ = arenaTail_ = 0;
+}
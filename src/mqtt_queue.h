@@ -0,0 +1,76 @@
+#pragma once
+#include <Arduino.h>
+#include <mutex>
+
+// Contatori esposti su bonsai/<id>/status/mqtt_queue
+struct MqttQueueStats {
+  uint8_t  depth;          // messaggi in coda adesso
+  uint8_t  maxDepth;
+  uint32_t enqueued;
+  uint32_t sent;
+  uint32_t dropped;        // scartati per coda piena o messaggio troppo grande
+  uint32_t coalesced;      // retained sostituiti da un valore più recente sullo stesso topic
+  uint32_t failed;         // publish rifiutati dal client
+  uint32_t latencyAvgUs;   // accodamento → publish completato (EWMA 1/8)
+  uint32_t latencyMaxUs;
+};
+
+// Messaggio estratto dalla coda (payload copiato nel buffer del chiamante)
+struct MqttMessage {
+  char     topic[64];
+  size_t   len;
+  bool     retain;
+  uint32_t enqueuedUs;
+};
+
+// Coda MQTT limitata e thread-safe: metadati in slot fissi, payload in un'arena
+// circolare fornita dal chiamante (nessuna allocazione dinamica).
+// Politiche:
+//  - coalesce: un nuovo messaggio retained sostituisce quello ancora in coda
+//    sullo stesso topic (conta solo l'ultimo stato)
+//  - drop-oldest: se slot o arena sono pieni si scarta il messaggio più vecchio
+class MqttQueue {
+public:
+  static const uint8_t MAX_SLOTS = 16;
+
+  MqttQueue(uint8_t* arena, size_t arenaSize) : arena_(arena), arenaSize_(arenaSize) {}
+
+  // false se il messaggio non entra nemmeno a coda vuota
+  bool push(const char* topic, const uint8_t* payload, size_t len, bool retain);
+
+  // Estrae il messaggio più vecchio; false se la coda è vuota o `bufLen` non basta
+  bool pop(MqttMessage& out, uint8_t* buf, size_t bufLen);
+
+  void recordSent(uint32_t enqueuedUs, bool ok);   // da chiamare dopo il publish
+
+  uint8_t depth();
+  MqttQueueStats stats();
+  void clear();
+
+private:
+  struct Slot {
+    char     topic[64];
+    size_t   off;
+    size_t   len;
+    uint32_t enqueuedUs;
+    bool     retain;
+    bool     live;        // false = sostituito (coalesce), spazio recuperato quando arriva in testa
+  };
+
+  bool reserve(size_t len, size_t& off);
+  void dropHead();
+  void releaseHead();
+
+  uint8_t* arena_;
+  size_t   arenaSize_;
+  size_t   arenaHead_ = 0;   // inizio del payload più vecchio
+  size_t   arenaTail_ = 0;   // prossima scrittura
+
+  Slot    slots_[MAX_SLOTS];
+  uint8_t head_ = 0;
+  uint8_t count_ = 0;        // slot occupati (anche non live)
+  uint8_t live_ = 0;
+
+  MqttQueueStats stats_ = {};
+  std::mutex mtx_;
+};
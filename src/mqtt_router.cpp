@@ -0,0 +1,129 @@
+#include "mqtt_router.h"
+
+// =======================================================
+// ===================== TOPIC TABLE =====================
+// =======================================================
+
+struct TopicEntry {
+  char      topic[MqttRouter::MAX_TOPIC_LEN];
+  uint8_t   len;
+  uint32_t  hash;
+  MqttRoute route;
+  bool      subscribe;
+};
+
+// 12 topic in 32 slot: load factor basso, probing quasi sempre a un passo
+static const uint8_t ROUTER_SLOTS = 32;
+static const uint8_t ROUTER_MAX_ENTRIES = 16;
+
+static TopicEntry s_entries[ROUTER_MAX_ENTRIES];
+static uint8_t s_entryCount = 0;
+static int8_t s_slots[ROUTER_SLOTS];          // indice in s_entries, -1 = vuoto
+static uint8_t s_subs[ROUTER_MAX_ENTRIES];    // indici in s_entries da sottoscrivere
+static uint8_t s_subCount = 0;
+
+static inline uint32_t fnv1a(const char* s, size_t& len)
+{
+  uint32_t h = 2166136261u;
+  const char* p = s;
+  while (*p) {
+    h ^= (uint8_t)*p++;
+    h *= 16777619u;
+  }
+  len = (size_t)(p - s);
+  return h;
+}
+
+static void addTopic(MqttRoute route, bool subscribe, const char* fmt, const char* deviceId)
+{
+  if (s_entryCount >= ROUTER_MAX_ENTRIES) return;
+
+  TopicEntry& e = s_entries[s_entryCount];
+  int n = snprintf(e.topic, sizeof(e.topic), fmt, deviceId);
+  if (n <= 0 || n >= (int)sizeof(e.topic)) {
+    Serial.printf("[MQTT] Topic troppo lungo, ignorato: %s\n", fmt);
+    return;
+  }
+
+  size_t len;
+  e.hash = fnv1a(e.topic, len);
+  e.len = (uint8_t)len;
+  e.route = route;
+  e.subscribe = subscribe;
+
+  uint8_t slot = (uint8_t)(e.hash % ROUTER_SLOTS);
+  while (s_slots[slot] >= 0) slot = (uint8_t)((slot + 1) % ROUTER_SLOTS);
+  s_slots[slot] = (int8_t)s_entryCount;
+
+  if (subscribe) s_subs[s_subCount++] = s_entryCount;
+  s_entryCount++;
+}
+
+namespace MqttRouter {
+
+void build(const char* deviceId)
+{
+  s_entryCount = 0;
+  s_subCount = 0;
+  for (uint8_t i = 0; i < ROUTER_SLOTS; i++) s_slots[i] = -1;
+
+  // Sottoscritti (stesso ordine dei subscribe storici di connectMqtt)
+  addTopic(MqttRoute::Pump,            true,  "bonsai/%s/command/pump",    deviceId);
+  addTopic(MqttRoute::Reboot,          true,  "bonsai/%s/command/reboot",  deviceId);
+  addTopic(MqttRoute::Reboot,          true,  "bonsai/%s/command/restart", deviceId);
+  addTopic(MqttRoute::Ota,             true,  "bonsai/%s/command/ota",     deviceId);
+  addTopic(MqttRoute::ConfigVersioned, true,  "bonsai/%s/config",          deviceId);
+  addTopic(MqttRoute::ConfigSet,       true,  "bonsai/%s/config/set",      deviceId);
+  addTopic(MqttRoute::Ota,             true,  "bonsai/ota/force/%s",       deviceId);
+  addTopic(MqttRoute::ConfigVersioned, true,  "bonsai/config",             deviceId);
+  addTopic(MqttRoute::ConfigSet,       true,  "bonsai/config/set",         deviceId);
+
+  // Vecchi topic di handleMqttConfigCommands: instradati ma non sottoscritti
+  addTopic(MqttRoute::ConfigLegacy,    false, "bonsai/config/%s",          deviceId);
+  addTopic(MqttRoute::ConfigLegacy,    false, "bonsai/command/config/update", deviceId);
+  addTopic(MqttRoute::Reboot,          false, "bonsai/command/restart",    deviceId);
+}
+
+MqttRoute route(const char* topic)
+{
+  if (!topic) return MqttRoute::None;
+
+  size_t len;
+  const uint32_t h = fnv1a(topic, len);
+
+  for (uint8_t slot = (uint8_t)(h % ROUTER_SLOTS), probes = 0; probes < ROUTER_SLOTS;
+       slot = (uint8_t)((slot + 1) % ROUTER_SLOTS), probes++) {
+    const int8_t idx = s_slots[slot];
+    if (idx < 0) return MqttRoute::None;
+
+    const TopicEntry& e = s_entries[idx];
+    if (e.hash == h && e.len == len && memcmp(e.topic, topic, len) == 0) return e.route;
+  }
+  return MqttRoute::None;
+}
+
+uint8_t subscriptionCount()
+{
+  return s_subCount;
+}
+
+const char* subscription(uint8_t i)
+{
+  return i < s_subCount ? s_entries[s_subs[i]].topic : "";
+}
+
+const char* routeName(MqttRoute r)
+{
+  switch (r) {
+    case MqttRoute::None:            return "none";
+    case MqttRoute::ConfigSet:       return "config_set";
+    case MqttRoute::ConfigVersioned: return "config";
+    case MqttRoute::ConfigLegacy:    return "config_legacy";
+    case MqttRoute::Pump:            return "pump";
+    case MqttRoute::Reboot:          return "reboot";
+    case MqttRoute::Ota:             return "ota";
+  }
+  return "?";
+}
+
+} // namespace MqttRouter
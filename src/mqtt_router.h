@@ -0,0 +1,29 @@
+#pragma once
+#include <Arduino.h>
+
+// Azione associata a un topic in ingresso
+enum class MqttRoute : uint8_t {
+  None,
+  ConfigSet,         // bonsai/config/set, bonsai/<id>/config/set: applica + riavvia
+  ConfigVersioned,   // bonsai/config, bonsai/<id>/config: applica solo se config_version è più nuova
+  ConfigLegacy,      // bonsai/config/<id>, bonsai/command/config/update (vecchi topic)
+  Pump,              // bonsai/<id>/command/pump
+  Reboot,            // bonsai/<id>/command/reboot|restart, bonsai/command/restart
+  Ota                // bonsai/<id>/command/ota, bonsai/ota/force/<id>
+};
+
+// Tabella dei topic precalcolata una volta (setupDeviceId) e indicizzata per
+// hash FNV-1a: il dispatch in mqttCallback è O(1) e non alloca.
+namespace MqttRouter {
+  static const uint8_t MAX_TOPIC_LEN = 64;
+
+  void build(const char* deviceId);
+
+  MqttRoute route(const char* topic);
+
+  // Topic da sottoscrivere alla connessione (i legacy sono solo instradati)
+  uint8_t subscriptionCount();
+  const char* subscription(uint8_t i);
+
+  const char* routeName(MqttRoute r);
+}
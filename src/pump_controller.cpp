@@ -1,32 +1,57 @@
 #include "pump_controller.h"
+#include "esp_timer.h"
 
 PumpController::PumpController(int pin, unsigned long maxRunMs) 
     : pumpPin_(pin), state_(false), lastChangeMs_(0), 
-      startMs_(0), maxRunMs_(maxRunMs), emergencyStop_(false) {}
+      startMs_(0), maxRunMs_(maxRunMs), emergencyStop_(false),
+      cutoffFired_(false), armed_(false), deadlineUs_(0),
+      cutoffListener_(nullptr), cutoffArg_(nullptr)
+#if PUMP_HW_CUTOFF
+      , cutoffTimer_(nullptr)
+#endif
+{}
 
 void PumpController::begin() {
     pinMode(pumpPin_, OUTPUT);
-    digitalWrite(pumpPin_, PUMP_OFF);  // OFF di default (LOW = ON per relay)
+    writePin(false);  // OFF di default (LOW = ON per relay)
     state_ = false;
     lastChangeMs_ = millis();
     startMs_ = 0;
     emergencyStop_ = false;
+
+#if PUMP_HW_CUTOFF
+    if (!cutoffTimer_) {
+        // Dispatch dal task esp_timer (priorità 22, sopra WiFi/lwIP/MQTT):
+        // latenza di pochi µs, indipendente dal carico di rete
+        esp_timer_create_args_t args = {};
+        args.callback = &PumpController::cutoffCallback;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "pump_cutoff";
+        if (esp_timer_create(&args, &cutoffTimer_) != ESP_OK) {
+            cutoffTimer_ = nullptr;
+            Serial.println("[PUMP] Cutoff timer unavailable, software failsafe only");
+        }
+    }
+#endif
 }
 
 bool PumpController::turnOn() {
     if (state_) return false;  // Già accesa
     if (emergencyStop_) return false;  // Emergency stop active
     
-    digitalWrite(pumpPin_, PUMP_ON);
+    writePin(true);
     state_ = true;
     lastChangeMs_ = millis();
     startMs_ = millis();
+    armCutoff();
     return true;
 }
 
 bool PumpController::turnOff() {
     if (!state_) return false;  // Già spenta
-    digitalWrite(pumpPin_, PUMP_OFF);
+    writePin(false);
+    disarmCutoff();
     state_ = false;
     lastChangeMs_ = millis();
     startMs_ = 0;
@@ -34,22 +59,33 @@ bool PumpController::turnOff() {
 }
 
 void PumpController::loop() {
+    // Il timer ha già spento il pin: qui si allinea lo stato
+    if (cutoffFired_.load(std::memory_order_acquire)) {
+        emergencyStop("Max runtime exceeded (hw timer).");
+        return;
+    }
+
     // Failsafe: Emergency stop if pump runs too long
     if (state_ && startMs_ > 0) {
         unsigned long runningTime = millis() - startMs_;
-        if (runningTime > maxRunMs_) {
-            // EMERGENCY STOP
-            digitalWrite(pumpPin_, PUMP_OFF);
-            state_ = false;
-            emergencyStop_ = true;
-            lastChangeMs_ = millis();
-            startMs_ = 0;
-            
-            Serial.println("[PUMP] EMERGENCY STOP! Max runtime exceeded.");
+        if (runningTime > maxRunMs_.load(std::memory_order_relaxed)) {
+            emergencyStop("Max runtime exceeded.");
+            disarmCutoff();
         }
     }
 }
 
+void PumpController::emergencyStop(const char* why) {
+    // EMERGENCY STOP
+    writePin(false);
+    state_ = false;
+    emergencyStop_ = true;
+    lastChangeMs_ = millis();
+    startMs_ = 0;
+
+    Serial.printf("[PUMP] EMERGENCY STOP! %s\n", why);
+}
+
 unsigned long PumpController::getRunningTimeMs() const {
     if (!state_ || startMs_ == 0) return 0;
     return millis() - startMs_;
@@ -61,13 +97,69 @@ void PumpController::clearEmergencyStop() {
 }
 
 void PumpController::setState(bool on) {
-    digitalWrite(pumpPin_, on ? PUMP_ON : PUMP_OFF);
+    writePin(on);
     state_ = on;
     lastChangeMs_ = millis();
     if (on) {
         startMs_ = millis();
+        armCutoff();
     } else {
         startMs_ = 0;
+        disarmCutoff();
+    }
+}
+
+// =======================================================
+// ==================== CUTOFF HARDWARE ==================
+// =======================================================
+
+// Ogni cambio del pin apre o chiude l'accensione coperta dal cutoff nella
+// stessa sezione critica: cutoff() vede o lo stato prima o quello dopo
+void PumpController::writePin(bool on) {
+    portENTER_CRITICAL(&mux_);
+    digitalWrite(pumpPin_, on ? PUMP_ON : PUMP_OFF);
+    armed_ = on;
+    if (on) deadlineUs_ = esp_timer_get_time() + (int64_t)maxRunMs_.load(std::memory_order_relaxed) * 1000;
+    cutoffFired_.store(false, std::memory_order_release);
+    portEXIT_CRITICAL(&mux_);
+}
+
+void PumpController::cutoff() {
+    // Solo il pin e i flag del cutoff: state_ appartiene al task di controllo.
+    // esp_timer_stop() non ferma una callback già in coda: uno scatto che arriva
+    // dopo turnOff() trova armed_ spento, dopo una riaccensione la deadline nuova
+    portENTER_CRITICAL(&mux_);
+    const bool due = armed_ && esp_timer_get_time() >= deadlineUs_;
+    if (due) {
+        digitalWrite(pumpPin_, PUMP_OFF);
+        armed_ = false;
+        cutoffFired_.store(true, std::memory_order_release);
     }
+    portEXIT_CRITICAL(&mux_);
+    if (due && cutoffListener_) cutoffListener_(cutoffArg_);
 }
 
+void PumpController::setCutoffListener(PumpCutoffListener listener, void* arg) {
+    cutoffArg_ = arg;
+    cutoffListener_ = listener;
+}
+
+#if PUMP_HW_CUTOFF
+void PumpController::cutoffCallback(void* arg) {
+    static_cast<PumpController*>(arg)->cutoff();
+}
+
+// Il timer parte dopo writePin(true): scade non prima di deadlineUs_
+void PumpController::armCutoff() {
+    if (!cutoffTimer_) return;
+    esp_timer_stop(cutoffTimer_);   // riaccensione: riparte da zero
+    esp_timer_start_once(cutoffTimer_, (uint64_t)maxRunMs_.load(std::memory_order_relaxed) * 1000ULL);
+}
+
+void PumpController::disarmCutoff() {
+    if (cutoffTimer_) esp_timer_stop(cutoffTimer_);
+}
+#else
+void PumpController::armCutoff() {}
+void PumpController::disarmCutoff() {}
+#endif
@@ -1,15 +1,50 @@
 #pragma once
 #include <Arduino.h>
+#include <atomic>
 #include "config.h"
 
+// 1 = one-shot esp_timer armato a ogni accensione: spegne il pin allo scadere
+//     di maxRunMs anche se nessuno chiama loop() (task bloccato, rete, OTA).
+// 0 = solo il controllo in loop() (env native; cutoff() simula lo scatto).
+#ifdef NATIVE_BUILD
+  #define PUMP_HW_CUTOFF 0
+#else
+  #define PUMP_HW_CUTOFF 1
+#endif
+
+#if PUMP_HW_CUTOFF
+extern "C" {
+  #include "esp_timer.h"
+}
+#endif
+
+// Chiamato dal contesto del timer subito dopo lo spegnimento del pin
+typedef void (*PumpCutoffListener)(void* arg);
+
 class PumpController {
 private:
     int pumpPin_;
     bool state_;  // true = ON, false = OFF
     unsigned long lastChangeMs_;
     unsigned long startMs_;  // When pump was turned on
-    unsigned long maxRunMs_;  // Maximum runtime in milliseconds
+    std::atomic<unsigned long> maxRunMs_;  // Maximum runtime in milliseconds (hot reload da loop())
     bool emergencyStop_;  // Emergency stop flag
+    std::atomic<bool> cutoffFired_;  // Pin già spento dal timer, loop() non ancora passato
+    // Pin, armed_ e deadlineUs_ cambiano insieme sotto mux_ (task di controllo
+    // e task esp_timer, anche su core diversi)
+    portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+    bool armed_;          // accensione in corso coperta dal cutoff
+    int64_t deadlineUs_;  // esp_timer_get_time() a cui scade l'accensione corrente
+    PumpCutoffListener cutoffListener_;
+    void* cutoffArg_;
+#if PUMP_HW_CUTOFF
+    esp_timer_handle_t cutoffTimer_;
+    static void cutoffCallback(void* arg);
+#endif
+    void writePin(bool on);
+    void armCutoff();
+    void disarmCutoff();
+    void emergencyStop(const char* why);
     
 public:
     PumpController(int pin, unsigned long maxRunMs = 60000);  // Default: 60 seconds
@@ -23,5 +58,16 @@ public:
     bool isEmergencyStop() const { return emergencyStop_; }
     void clearEmergencyStop();  // Reset emergency flag after manual intervention
     void setState(bool on);  // Forza stato (per restore dopo wakeup)
-};
+    // Config ricaricato: il controllo in loop() lo usa subito, il timer dalla prossima accensione
+    void setMaxRunMs(unsigned long ms) { maxRunMs_.store(ms, std::memory_order_relaxed); }
+    unsigned long getMaxRunMs() const { return maxRunMs_.load(std::memory_order_relaxed); }
 
+    // Failsafe hardware: spegne il pin e avvisa il listener. Gira nel task
+    // esp_timer; stato ed emergency flag vengono allineati dal loop() successivo.
+    // Non fa nulla se l'accensione è già stata chiusa o ne è partita un'altra
+    // (scatto arrivato in ritardo rispetto a turnOff()/turnOn()).
+    void cutoff();
+    bool cutoffPending() const { return cutoffFired_.load(std::memory_order_acquire); }
+    // Un solo listener (il task di controllo); deve essere breve e non bloccare
+    void setCutoffListener(PumpCutoffListener listener, void* arg);
+};
@@ -0,0 +1,366 @@
+#include "record_store.h"
+
+static const uint32_t SECTOR_MAGIC = 0x474F4C52;   // "RLOG"
+static const uint8_t FLAG_DATA = 0xFF;             // flag non programmati
+static const uint8_t FLAG_TOMB = 0x00;             // remove()
+
+struct SectorHeader {
+  uint32_t magic;
+  uint32_t epoch;
+};
+
+struct RecordHeader {
+  uint8_t  key;
+  uint8_t  flags;
+  uint16_t len;
+  uint32_t seq;
+  uint32_t crc;        // header (senza crc) + dati
+};
+
+static const uint32_t SECTOR_HDR = sizeof(SectorHeader);
+static const uint32_t RECORD_HDR = sizeof(RecordHeader);
+static_assert(RECORD_HDR == 12, "RecordHeader deve restare di 12 byte");
+
+// Copia di un record durante la compattazione (fuori dallo stack di loop())
+static uint8_t s_copy[RecordStore::MAX_RECORD];
+
+static inline uint32_t align4(uint32_t n)
+{
+  return (n + 3) & ~3UL;
+}
+
+static uint32_t recordCrc(const RecordHeader& h, const void* data)
+{
+  return RecordStore::crc32(data, h.len, RecordStore::crc32(&h, offsetof(RecordHeader, crc)));
+}
+
+// =======================================================
+// ========================= CRC =========================
+// =======================================================
+
+uint32_t RecordStore::crc32(const void* data, size_t len, uint32_t crc)
+{
+  // Bit a bit come ConfigCache: pochi KB a boot, la tabella non serve
+  const uint8_t* p = (const uint8_t*)data;
+  crc = ~crc;
+  while (len--) {
+    crc ^= *p++;
+    for (uint8_t k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320UL & (0U - (crc & 1)));
+  }
+  return ~crc;
+}
+
+// =======================================================
+// ======================== APERTURA =====================
+// =======================================================
+
+RecordStore::RecordStore(const esp_partition_t* part)
+    : part_(part), sectors_(part ? (uint16_t)(part->size / SECTOR) : 0), stats_() {}
+
+bool RecordStore::begin()
+{
+  ready_ = false;
+  stats_ = RecordStoreStats();
+  stats_.sectors = sectors_;
+  for (Slot& s : index_) s = Slot{NO_RECORD, 0, 0, false};
+  seq_ = 0;
+
+  // Testa + riserva + almeno un settore da compattare
+  if (!part_ || sectors_ < 3) return false;
+
+  // Head = epoch più alta; tail = indietro finché le epoch sono consecutive
+  bool any = false;
+  for (uint16_t s = 0; s < sectors_; s++) {
+    SectorHeader h;
+    if (esp_partition_read(part_, s * SECTOR, &h, sizeof(h)) != ESP_OK) continue;
+    if (h.magic != SECTOR_MAGIC) continue;
+    if (!any || h.epoch > epoch_) {
+      head_ = s;
+      epoch_ = h.epoch;
+    }
+    any = true;
+  }
+  if (!any) return format();
+
+  tail_ = head_;
+  uint32_t e = epoch_;
+  for (uint16_t n = 1; n < sectors_; n++) {
+    const uint16_t prev = (uint16_t)((tail_ + sectors_ - 1) % sectors_);
+    SectorHeader h;
+    if (esp_partition_read(part_, prev * SECTOR, &h, sizeof(h)) != ESP_OK) break;
+    if (h.magic != SECTOR_MAGIC || h.epoch != e - 1) break;
+    tail_ = prev;
+    e--;
+  }
+
+  // Dal più vecchio: a parità di seq (copia di una compattazione interrotta) vince l'ultima
+  for (uint16_t s = tail_;; s = (uint16_t)((s + 1) % sectors_)) {
+    scanSector(s, s == head_);
+    if (s == head_) break;
+  }
+
+  ready_ = true;
+  return true;
+}
+
+void RecordStore::scanSector(uint16_t s, bool head)
+{
+  const uint32_t base = s * SECTOR;
+  uint32_t off = SECTOR_HDR;
+
+  while (off + RECORD_HDR <= SECTOR) {
+    RecordHeader h;
+    if (esp_partition_read(part_, base + off, &h, sizeof(h)) != ESP_OK) {
+      off = SECTOR;
+      break;
+    }
+    if (h.key == 0xFF && h.len == 0xFFFF && h.seq == 0xFFFFFFFFUL) break;   // fine del log
+
+    const uint32_t total = align4(RECORD_HDR + h.len);
+    if (h.key >= MAX_KEYS || h.len > MAX_RECORD || off + total > SECTOR) {
+      // Header illeggibile: il resto del settore non si può più interpretare
+      stats_.corrupt++;
+      off = SECTOR;
+      break;
+    }
+
+    // Scrittura interrotta o bit degradati: si salta, vale la versione prima
+    bool ok = esp_partition_read(part_, base + off + RECORD_HDR, s_copy, h.len) == ESP_OK &&
+              recordCrc(h, s_copy) == h.crc;
+    if (ok) {
+      Slot& slot = index_[h.key];
+      if (slot.off == NO_RECORD || h.seq >= slot.seq)
+        slot = Slot{base + off, h.seq, h.len, h.flags == FLAG_TOMB};
+      if (h.seq > seq_) seq_ = h.seq;
+    } else {
+      stats_.corrupt++;
+    }
+    off += total;
+  }
+
+  if (head) writePos_ = off;
+}
+
+// Solo il primo settore: gli altri vengono cancellati quando il log ci arriva
+bool RecordStore::format()
+{
+  if (esp_partition_erase_range(part_, 0, SECTOR) != ESP_OK) return false;
+  stats_.erases++;
+  const SectorHeader h = { SECTOR_MAGIC, 1 };
+  if (esp_partition_write(part_, 0, &h, sizeof(h)) != ESP_OK) return false;
+  head_ = tail_ = 0;
+  epoch_ = 1;
+  writePos_ = SECTOR_HDR;
+  ready_ = true;
+  return true;
+}
+
+// =======================================================
+// ======================= SCRITTURA =====================
+// =======================================================
+
+uint16_t RecordStore::usedSectors() const
+{
+  return (uint16_t)((head_ + sectors_ - tail_) % sectors_ + 1);
+}
+
+uint16_t RecordStore::freeSectors() const
+{
+  return ready_ ? (uint16_t)(sectors_ - usedSectors()) : 0;
+}
+
+bool RecordStore::openNext()
+{
+  const uint16_t next = (uint16_t)((head_ + 1) % sectors_);
+  if (next == tail_) return false;   // pieno: prima va compattato il tail
+
+  if (esp_partition_erase_range(part_, next * SECTOR, SECTOR) != ESP_OK) return false;
+  stats_.erases++;
+  const SectorHeader h = { SECTOR_MAGIC, epoch_ + 1 };
+  if (esp_partition_write(part_, next * SECTOR, &h, sizeof(h)) != ESP_OK) return false;
+
+  head_ = next;
+  epoch_++;
+  writePos_ = SECTOR_HDR;
+  return true;
+}
+
+bool RecordStore::append(uint8_t key, uint8_t flags, const void* data, size_t len, uint32_t seq)
+{
+  const uint32_t total = align4(RECORD_HDR + len);
+  if (writePos_ + total > SECTOR && !openNext()) return false;
+
+  RecordHeader h;
+  h.key = key;
+  h.flags = flags;
+  h.len = (uint16_t)len;
+  h.seq = seq;
+  h.crc = recordCrc(h, data);
+
+  // Header e poi dati: un reset in mezzo lascia un record con CRC errato, ignorato
+  const uint32_t off = head_ * SECTOR + writePos_;
+  if (esp_partition_write(part_, off, &h, sizeof(h)) != ESP_OK) {
+    writePos_ = SECTOR;   // settore in stato incerto: si chiude
+    return false;
+  }
+  if (len && esp_partition_write(part_, off + RECORD_HDR, data, len) != ESP_OK) {
+    writePos_ = SECTOR;
+    return false;
+  }
+  writePos_ += total;
+
+  index_[key] = Slot{off, seq, (uint16_t)len, flags == FLAG_TOMB};
+  if (seq > seq_) seq_ = seq;
+  stats_.appends++;
+  return true;
+}
+
+// Versioni superate o tombstone di chiavi già riscritte: compattare libera spazio
+bool RecordStore::tailHasStale() const
+{
+  if (tail_ == head_) return false;
+
+  const uint32_t base = tail_ * SECTOR;
+  uint32_t off = SECTOR_HDR;
+  while (off + RECORD_HDR <= SECTOR) {
+    RecordHeader h;
+    if (esp_partition_read(part_, base + off, &h, sizeof(h)) != ESP_OK) return false;
+    if (h.key >= MAX_KEYS || h.len > MAX_RECORD) break;
+    const uint32_t total = align4(RECORD_HDR + h.len);
+    if (off + total > SECTOR) break;
+    if (index_[h.key].off != base + off) return true;
+    off += total;
+  }
+  return false;
+}
+
+bool RecordStore::compactTail()
+{
+  if (tail_ == head_) return false;   // un solo settore in uso: niente da liberare
+
+  const uint32_t base = tail_ * SECTOR;
+  uint32_t off = SECTOR_HDR;
+  while (off + RECORD_HDR <= SECTOR) {
+    RecordHeader h;
+    if (esp_partition_read(part_, base + off, &h, sizeof(h)) != ESP_OK) return false;
+    if (h.key >= MAX_KEYS || h.len > MAX_RECORD) break;   // fine del log o header illeggibile
+    const uint32_t total = align4(RECORD_HDR + h.len);
+    if (off + total > SECTOR) break;
+
+    // Ancora l'ultima versione della sua chiave: si ricopia con lo stesso seq
+    // (tombstone compresi: sotto potrebbero esserci versioni più vecchie)
+    if (index_[h.key].off == base + off) {
+      if (esp_partition_read(part_, base + off + RECORD_HDR, s_copy, h.len) != ESP_OK) return false;
+      if (!append(h.key, h.flags, s_copy, h.len, h.seq)) return false;
+    }
+    off += total;
+  }
+
+  if (esp_partition_erase_range(part_, base, SECTOR) != ESP_OK) return false;
+  stats_.erases++;
+  stats_.compactions++;
+  tail_ = (uint16_t)((tail_ + 1) % sectors_);
+  return true;
+}
+
+// Prima di aprire un settore nuovo ne resta sempre uno per la compattazione.
+// Al più un giro completo: se tutto è ancora attuale lo store è pieno.
+bool RecordStore::makeRoom(size_t len)
+{
+  if (writePos_ + align4(RECORD_HDR + len) <= SECTOR) return true;
+  for (uint16_t n = 0; freeSectors() <= RESERVE_SECTORS; n++) {
+    if (n == sectors_ || !compactTail()) return false;
+  }
+  return true;
+}
+
+bool RecordStore::put(uint8_t key, const void* data, size_t len)
+{
+  if (!ready_ || key >= MAX_KEYS || len > MAX_RECORD) return false;
+  if (!makeRoom(len)) return false;
+  return append(key, FLAG_DATA, data, len, seq_ + 1);
+}
+
+bool RecordStore::remove(uint8_t key)
+{
+  if (!has(key)) return ready_;
+  if (!makeRoom(0)) return false;
+  return append(key, FLAG_TOMB, nullptr, 0, seq_ + 1);
+}
+
+bool RecordStore::maintain(uint8_t freeTarget)
+{
+  // Un tail tutto attuale si sposterebbe soltanto: un erase senza guadagno
+  if (!ready_ || freeSectors() >= freeTarget || !tailHasStale()) return false;
+  return compactTail();
+}
+
+// =======================================================
+// ======================== LETTURA ======================
+// =======================================================
+
+int RecordStore::get(uint8_t key, void* out, size_t cap) const
+{
+  if (!has(key)) return -1;
+  const Slot& s = index_[key];
+  if (s.len > cap) return -1;
+  if (esp_partition_read(part_, s.off + RECORD_HDR, out, s.len) != ESP_OK) return -1;
+  return s.len;
+}
+
+bool RecordStore::has(uint8_t key) const
+{
+  return ready_ && key < MAX_KEYS && index_[key].off != NO_RECORD && !index_[key].tomb;
+}
+
+uint32_t RecordStore::version(uint8_t key) const
+{
+  return has(key) ? index_[key].seq : 0;
+}
+
+RecordStoreStats RecordStore::stats() const
+{
+  RecordStoreStats st = stats_;
+  st.freeSectors = freeSectors();
+  st.seq = seq_;
+  return st;
+}
+
+// =======================================================
+// ====================== STORE GLOBALE ==================
+// =======================================================
+
+static RecordStore* s_kv = nullptr;
+static bool s_kvTried = false;
+
+// Settori liberi sotto cui la compattazione a riposo interviene
+static const uint8_t KV_FREE_TARGET = 4;
+
+RecordStore* kvStore()
+{
+  if (s_kvTried) return s_kv;
+  s_kvTried = true;
+
+  const esp_partition_t* part = esp_partition_find_first(
+      ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, KV_PARTITION_LABEL);
+  if (!part) {
+    Serial.println("[KV] Partizione " KV_PARTITION_LABEL " assente, uso NVS");
+    return nullptr;
+  }
+
+  static RecordStore store(part);
+  if (!store.begin()) {
+    Serial.println("[KV] Apertura fallita");
+    return nullptr;
+  }
+  const RecordStoreStats st = store.stats();
+  Serial.printf("[KV] %u settori, %u liberi, seq %lu, %u record scartati\n",
+                st.sectors, st.freeSectors, (unsigned long)st.seq, st.corrupt);
+  s_kv = &store;
+  return s_kv;
+}
+
+void kvMaintain()
+{
+  if (s_kv) s_kv->maintain(KV_FREE_TARGET);
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <Arduino.h>
+#include "esp_partition.h"
+
+// =======================================================
+// ====================== RECORD STORE ===================
+// =======================================================
+//
+// Log di record versionati su una partizione dati raw. Ogni put() è un
+// append (header + dati + CRC): il record precedente resta intatto finché il
+// nuovo non è scritto per intero, quindi un reset a metà non lascia mai la
+// chiave senza valore. All'avvio una scansione degli header ricostruisce
+// l'indice in RAM (chiave → ultimo record); get() è una lookup diretta più
+// una lettura. I settori si usano a rotazione: il più vecchio viene
+// compattato (record ancora attuali ricopiati in testa) e cancellato, così le
+// cancellazioni si distribuiscono su tutta la partizione.
+//
+// Layout di un settore (4 KB):
+//   [magic "RLOG"][epoch]  [key flags len seq crc | dati, padding a 4]  ...
+// L'epoch cresce di uno a ogni settore aperto: i settori validi formano un
+// anello contiguo dal più vecchio (tail) a quello in scrittura (head).
+//
+// Non thread-safe: put/remove/maintain solo dal contesto di loop()/setup().
+
+// Partizione dati in partitions_ota.csv; su env native è in RAM
+// (test/native/esp_partition.h)
+#define KV_PARTITION_LABEL "kvstore"
+
+struct RecordStoreStats {
+  uint16_t sectors;
+  uint16_t freeSectors;
+  uint32_t seq;           // ultima versione scritta
+  uint32_t appends;       // da begin()
+  uint32_t erases;
+  uint32_t compactions;
+  uint16_t corrupt;       // record scartati dal CRC in begin()
+};
+
+class RecordStore {
+public:
+  static const uint32_t SECTOR = 4096;
+  static const uint8_t MAX_KEYS = 16;
+  static const size_t MAX_RECORD = 2048;       // payload di un record (ConfigImage)
+  static const uint8_t RESERVE_SECTORS = 1;    // riservati alla compattazione
+
+  explicit RecordStore(const esp_partition_t* part);
+
+  // Scansione e indice; partizione vuota o illeggibile = log nuovo
+  bool begin();
+  bool ready() const { return ready_; }
+
+  // Nuova versione di key (0..MAX_KEYS-1); compatta in linea se lo spazio manca
+  bool put(uint8_t key, const void* data, size_t len);
+  bool remove(uint8_t key);
+
+  // Byte copiati in out, -1 se la chiave non c'è o cap non basta
+  int get(uint8_t key, void* out, size_t cap) const;
+  bool has(uint8_t key) const;
+  uint32_t version(uint8_t key) const;   // seq dell'ultimo record, 0 se assente
+
+  // Compattazione in background: al più un settore, solo se ne restano
+  // meno di freeTarget liberi e il tail ha record superati.
+  // true se ha cancellato un settore.
+  bool maintain(uint8_t freeTarget);
+
+  uint16_t freeSectors() const;
+  RecordStoreStats stats() const;
+
+  // CRC-32 IEEE concatenabile: crc32(b, nb, crc32(a, na)) = crc32(a+b)
+  static uint32_t crc32(const void* data, size_t len, uint32_t crc = 0);
+
+private:
+  struct Slot {
+    uint32_t off;     // assoluto nella partizione, NO_RECORD se assente
+    uint32_t seq;
+    uint16_t len;
+    bool tomb;
+  };
+
+  static const uint32_t NO_RECORD = 0xFFFFFFFFUL;
+
+  bool format();
+  bool openNext();
+  bool compactTail();
+  bool tailHasStale() const;
+  bool makeRoom(size_t len);
+  void scanSector(uint16_t s, bool head);
+  bool append(uint8_t key, uint8_t flags, const void* data, size_t len, uint32_t seq);
+  uint16_t usedSectors() const;
+
+  const esp_partition_t* part_;
+  uint16_t sectors_;
+  uint16_t head_ = 0;
+  uint16_t tail_ = 0;
+  uint32_t writePos_ = 0;   // offset nel settore head
+  uint32_t epoch_ = 0;
+  uint32_t seq_ = 0;
+  bool ready_ = false;
+  Slot index_[MAX_KEYS];
+  RecordStoreStats stats_;
+};
+
+// Chiavi dei record (un byte nell'header): mai riusare un valore
+static const uint8_t REC_CONFIG      = 1;   // ConfigImage (config_cache.cpp)
+static const uint8_t REC_CONFIG_SEED = 2;   // CRC del config.json importato
+
+// Store sulla partizione KV_PARTITION_LABEL, aperto al primo uso; nullptr se
+// la tabella partizioni del device non la prevede (es. aggiornato via OTA
+// da un firmware con la tabella vecchia)
+RecordStore* kvStore();
+
+// A riposo (loop(), prima del deep sleep): un passo di compattazione se lo
+// store è stato aperto in questo boot, altrimenti niente
+void kvMaintain();
@@ -0,0 +1,59 @@
+#include "report_policy.h"
+
+static const size_t METRICS = (size_t)StatusMetric::Count;
+
+struct MetricState {
+  bool          sent;
+  int32_t       value;
+  unsigned long atMs;
+};
+
+static MetricState s_metrics[METRICS];
+
+static int32_t deadbandFor(const Config& cfg, StatusMetric m)
+{
+  switch (m) {
+    case StatusMetric::Humidity: return cfg.report_deadband_humidity;
+    case StatusMetric::Wifi:     return cfg.report_deadband_rssi;
+    case StatusMetric::Battery:  return cfg.report_deadband_battery;
+    default:                     return 0;
+  }
+}
+
+// Metriche che cambiano a ogni lettura ma non portano informazione: solo heartbeat
+static bool heartbeatOnly(StatusMetric m)
+{
+  return m == StatusMetric::Firmware || m == StatusMetric::LastSeen ||
+         m == StatusMetric::MqttQueue || m == StatusMetric::Control;
+}
+
+namespace ReportPolicy {
+
+void reset()
+{
+  for (size_t i = 0; i < METRICS; i++) s_metrics[i].sent = false;
+}
+
+bool due(const Config& cfg, StatusMetric m, int32_t value, unsigned long nowMs)
+{
+  if (cfg.report_heartbeat_s <= 0) return true;
+
+  const MetricState& s = s_metrics[(size_t)m];
+  if (!s.sent) return true;
+  if (nowMs - s.atMs >= (unsigned long)cfg.report_heartbeat_s * 1000UL) return true;
+  if (heartbeatOnly(m)) return false;
+
+  const int32_t delta = value > s.value ? value - s.value : s.value - value;
+  const int32_t band = deadbandFor(cfg, m);
+  return band > 0 ? delta >= band : delta != 0;
+}
+
+void reported(StatusMetric m, int32_t value, unsigned long nowMs)
+{
+  MetricState& s = s_metrics[(size_t)m];
+  s.sent = true;
+  s.value = value;
+  s.atMs = nowMs;
+}
+
+} // namespace ReportPolicy
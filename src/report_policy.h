@@ -0,0 +1,32 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// Metriche di stato pubblicate da publishStatus()
+enum class StatusMetric : uint8_t {
+  Humidity,   // %           deadband: report_deadband_humidity
+  Wifi,       // RSSI dBm    deadband: report_deadband_rssi
+  Battery,    // mV          deadband: report_deadband_battery
+  Temp,       // °C × 10     qualunque variazione
+  Pump,       // 0/1         qualunque variazione
+  Firmware,   // costante    solo heartbeat
+  LastSeen,   // timestamp   solo heartbeat
+  MqttQueue,  // contatori   solo heartbeat
+  Control,    // jitter      solo heartbeat
+  Count
+};
+
+// Politica di report a deadband: una metrica viene pubblicata solo se si è
+// spostata oltre la sua deadband dall'ultimo valore inviato, oppure se è
+// scaduto l'heartbeat (report_heartbeat_s). report_heartbeat_s = 0 disattiva
+// la politica: tutto a ogni giro di mqttInterval, come prima.
+namespace ReportPolicy {
+  // Nessun valore inviato: al prossimo giro parte tutto (nuova sessione MQTT)
+  void reset();
+
+  // true se `value` va pubblicato adesso; non modifica lo stato
+  bool due(const Config& cfg, StatusMetric m, int32_t value, unsigned long nowMs);
+
+  // Da chiamare dopo un publish riuscito
+  void reported(StatusMetric m, int32_t value, unsigned long nowMs);
+}
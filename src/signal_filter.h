@@ -0,0 +1,193 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// =====================================================================
+// Filtri streaming per segnali dei sensori: header-only, interi/fixed-point,
+// finestre a dimensione fissa in compilazione, nessuna allocazione.
+// Compilano anche nell'env `native` (test e benchmark su tracce registrate).
+// =====================================================================
+
+namespace SignalFilter {
+
+// ----------------------------------------------------------------
+// Mediana mobile sugli ultimi N campioni.
+// Ring per l'ordine di arrivo + copia ordinata aggiornata per inserimento:
+// O(N) per campione, nessun sort completo.
+// ----------------------------------------------------------------
+template <typename T, size_t N>
+class RunningMedian {
+  static_assert(N >= 1 && N <= 255, "RunningMedian: 1 <= N <= 255");
+
+public:
+  void reset() { count_ = 0; head_ = 0; }
+
+  T push(T x)
+  {
+    if (count_ == N) {
+      // Esce il più vecchio: lo si toglie dalla copia ordinata
+      removeSorted(ring_[head_]);
+      ring_[head_] = x;
+      head_ = (uint8_t)((head_ + 1) % N);
+    } else {
+      ring_[(head_ + count_) % N] = x;
+    }
+    insertSorted(x);
+    return median();
+  }
+
+  // Per N pari (o finestra non ancora piena e pari) media dei due centrali
+  T median() const
+  {
+    if (count_ == 0) return T(0);
+    const uint8_t m = count_ / 2;
+    if (count_ & 1) return sorted_[m];
+    return (T)(((int32_t)sorted_[m - 1] + (int32_t)sorted_[m]) / 2);
+  }
+
+  uint8_t size() const { return count_; }
+  bool full() const { return count_ == N; }
+
+  // Campione i-esimo in ordine crescente (0 = minimo della finestra)
+  T sorted(uint8_t i) const { return sorted_[i]; }
+
+private:
+  void insertSorted(T x)
+  {
+    uint8_t i = count_;
+    while (i > 0 && sorted_[i - 1] > x) {
+      sorted_[i] = sorted_[i - 1];
+      i--;
+    }
+    sorted_[i] = x;
+    count_++;
+  }
+
+  void removeSorted(T x)
+  {
+    uint8_t i = 0;
+    while (i < count_ && sorted_[i] != x) i++;
+    for (; i + 1 < count_; i++) sorted_[i] = sorted_[i + 1];
+    count_--;
+  }
+
+  T ring_[N];
+  T sorted_[N];
+  uint8_t head_ = 0;    // più vecchio (finestra piena)
+  uint8_t count_ = 0;
+};
+
+// ----------------------------------------------------------------
+// Filtro di Hampel causale: se il nuovo campione dista dalla mediana della
+// finestra più di k · 1.4826 · MAD viene sostituito dalla mediana.
+// K_Q8 = k in Q8 (768 = 3.0); MIN_DEV evita di scartare tutto quando la
+// finestra è costante (MAD = 0, tipico con l'ADC quantizzato).
+// ----------------------------------------------------------------
+template <typename T, size_t N, uint16_t K_Q8 = 768, T MIN_DEV = 2>
+class HampelFilter {
+  static_assert(N >= 3, "HampelFilter: finestra di almeno 3 campioni");
+
+public:
+  void reset() { window_.reset(); outliers_ = 0; }
+
+  T push(T x)
+  {
+    const T med = window_.push(x);
+    const uint8_t n = window_.size();
+    if (n < 3) return x;
+
+    // MAD: mediana delle deviazioni assolute (finestra piccola → insertion sort)
+    int32_t dev[N];
+    for (uint8_t i = 0; i < n; i++) {
+      int32_t d = (int32_t)window_.sorted(i) - (int32_t)med;
+      if (d < 0) d = -d;
+      uint8_t j = i;
+      while (j > 0 && dev[j - 1] > d) {
+        dev[j] = dev[j - 1];
+        j--;
+      }
+      dev[j] = d;
+    }
+    const int32_t mad = (n & 1) ? dev[n / 2] : (dev[n / 2 - 1] + dev[n / 2]) / 2;
+
+    // 1.4826 in Q8 = 380: σ stimata da MAD per rumore gaussiano
+    int32_t thr = (mad * 380 * (int32_t)K_Q8) >> 16;
+    if (thr < (int32_t)MIN_DEV) thr = (int32_t)MIN_DEV;
+
+    int32_t d = (int32_t)x - (int32_t)med;
+    if (d < 0) d = -d;
+    if (d <= thr) return x;
+
+    outliers_++;
+    return med;
+  }
+
+  uint16_t outliers() const { return outliers_; }
+
+private:
+  RunningMedian<T, N> window_;
+  uint16_t outliers_ = 0;
+};
+
+// ----------------------------------------------------------------
+// IIR esponenziale del primo ordine: y += (x - y) / 2^SHIFT.
+// Stato in Q(FRAC) per non perdere i passi piccoli con ingressi interi.
+// ----------------------------------------------------------------
+template <uint8_t SHIFT, uint8_t FRAC = 8>
+class ExpIir {
+  static_assert(SHIFT >= 1 && SHIFT <= 15, "ExpIir: 1 <= SHIFT <= 15");
+  static_assert(FRAC >= 1 && FRAC <= 16, "ExpIir: 1 <= FRAC <= 16");
+
+public:
+  void reset() { primed_ = false; }
+
+  int32_t push(int32_t x)
+  {
+    const int32_t xq = x * (1 << FRAC);
+    if (!primed_) {
+      // Primo campione: niente rampa da 0
+      state_ = xq;
+      primed_ = true;
+    } else {
+      state_ += (xq - state_) / (1 << SHIFT);
+    }
+    return value();
+  }
+
+  // Arrotondato all'intero
+  int32_t value() const { return (state_ + (1 << (FRAC - 1))) >> FRAC; }
+  int32_t raw() const { return state_; }   // Q(FRAC)
+  bool primed() const { return primed_; }
+
+private:
+  int32_t state_ = 0;
+  bool primed_ = false;
+};
+
+// ----------------------------------------------------------------
+// Minimo/massimo da reset() in poi
+// ----------------------------------------------------------------
+template <typename T>
+class MinMaxTracker {
+public:
+  void reset() { count_ = 0; }
+
+  void push(T x)
+  {
+    if (count_ == 0 || x < min_) min_ = x;
+    if (count_ == 0 || x > max_) max_ = x;
+    if (count_ < UINT16_MAX) count_++;
+  }
+
+  T min() const { return count_ ? min_ : T(0); }
+  T max() const { return count_ ? max_ : T(0); }
+  T span() const { return count_ ? (T)(max_ - min_) : T(0); }
+  uint16_t count() const { return count_; }
+
+private:
+  T min_ = T(0);
+  T max_ = T(0);
+  uint16_t count_ = 0;
+};
+
+} // namespace SignalFilter
@@ -0,0 +1,151 @@
+#include "sleep_scheduler.h"
+#include "esp_private/esp_clk.h"
+
+// =======================================================
+// ===================== RTC STATE =======================
+// =======================================================
+
+static const uint32_t SLEEP_SCHED_MAGIC = 0x534C5050;  // "SLPP"
+
+struct SleepRtcState {
+  uint32_t magic;
+  uint32_t ts[SleepScheduler::HISTORY];       // orologio dello scheduler
+  uint8_t  pct[SleepScheduler::HISTORY];
+  uint8_t  head;                              // prossimo slot libero
+  uint8_t  count;
+};
+
+RTC_DATA_ATTR static SleepRtcState s_sleep;
+
+static uint8_t slot(uint8_t i)
+{
+  // i = 0 → campione più vecchio
+  return (uint8_t)((s_sleep.head + SleepScheduler::HISTORY - s_sleep.count + i) %
+                   SleepScheduler::HISTORY);
+}
+
+static void clearHistory()
+{
+  s_sleep.head = 0;
+  s_sleep.count = 0;
+}
+
+// Retta ai minimi quadrati sullo storico: pendenza in centesimi di % all'ora.
+// Tempi relativi al campione più vecchio, somme in int64 (8 punti, span di giorni).
+static bool fitSlope(int32_t& slopeX100)
+{
+  if (s_sleep.count < SleepScheduler::MIN_POINTS) return false;
+
+  const uint32_t t0 = s_sleep.ts[slot(0)];
+  if (s_sleep.ts[slot(s_sleep.count - 1)] - t0 < SleepScheduler::MIN_SPAN_S) return false;
+
+  int64_t st = 0, sp = 0, stt = 0, stp = 0;
+  for (uint8_t i = 0; i < s_sleep.count; i++) {
+    const int64_t t = (int64_t)(s_sleep.ts[slot(i)] - t0);
+    const int64_t p = s_sleep.pct[slot(i)];
+    st += t;
+    sp += p;
+    stt += t * t;
+    stp += t * p;
+  }
+  const int64_t n = s_sleep.count;
+  const int64_t den = n * stt - st * st;
+  if (den <= 0) return false;
+
+  slopeX100 = (int32_t)((n * stp - st * sp) * 100 * 3600 / den);
+  return true;
+}
+
+namespace SleepScheduler {
+
+void begin(bool coldBoot)
+{
+  if (coldBoot || s_sleep.magic != SLEEP_SCHED_MAGIC) {
+    s_sleep.magic = SLEEP_SCHED_MAGIC;
+    clearHistory();
+  }
+}
+
+uint32_t nowS()
+{
+  // Timer RTC: conta anche in deep sleep, qualunque cosa chiuda lo sleep
+  // (timer, ULP, wake stub) e comunque sia durato
+  return (uint32_t)(esp_clk_rtc_time() / 1000000ULL);
+}
+
+void record(uint32_t now, int soilPercent, bool watered)
+{
+  const uint8_t pct = (uint8_t)constrain(soilPercent, 0, 100);
+
+  if (s_sleep.count > 0) {
+    const uint8_t last = slot(s_sleep.count - 1);
+    // Orologio tornato indietro o suolo bagnato da fuori: il trend non vale più
+    if (now < s_sleep.ts[last] || (int)pct - (int)s_sleep.pct[last] >= REWET_DELTA)
+      clearHistory();
+  }
+
+  s_sleep.ts[s_sleep.head] = now;
+  s_sleep.pct[s_sleep.head] = pct;
+  s_sleep.head = (uint8_t)((s_sleep.head + 1) % HISTORY);
+  if (s_sleep.count < HISTORY) s_sleep.count++;
+
+  // Il campione è di prima dell'irrigazione: dal prossimo wake si ricomincia
+  if (watered) clearHistory();
+}
+
+SleepPlan plan(const Config& cfg, int soilPercent, int batteryMv)
+{
+  uint32_t minS = cfg.measurement_interval > 0 ? (uint32_t)cfg.measurement_interval / 1000 : 0;
+  if (minS < MIN_SLEEP_S) minS = MIN_SLEEP_S;
+  const int maxHours = cfg.sleep_max_hours > 0 ? cfg.sleep_max_hours : cfg.sleep_hours;
+  uint32_t maxS = (uint32_t)maxHours * 3600UL;
+  if (maxS < minS) maxS = minS;
+
+  SleepPlan p = {};
+  p.sleepS = (uint32_t)cfg.sleep_hours * 3600UL;
+  p.reason = SleepReason::NoTrend;
+
+  int32_t slope = 0;
+  const bool trend = fitSlope(slope);
+  if (trend) p.slopeX100 = slope;
+
+  if (soilPercent < cfg.moisture_threshold) {
+    // L'irrigazione (o l'alert) è già in corso: si ricontrolla presto
+    p.sleepS = minS;
+    p.reason = SleepReason::Dry;
+  } else if (trend && slope > -FLAT_SLOPE_X100) {
+    p.sleepS = maxS;
+    p.reason = SleepReason::Steady;
+  } else if (trend) {
+    // Margine di 1/8 sull'orizzonte: l'incertezza della retta cresce con la distanza
+    p.crossS = (uint32_t)((int64_t)(soilPercent - cfg.moisture_threshold) * 100 * 3600 / -slope);
+    p.sleepS = p.crossS - p.crossS / 8;
+    p.reason = SleepReason::Predicted;
+  }
+
+  if (cfg.low_battery_mv > 0 && batteryMv > 0 && batteryMv < cfg.low_battery_mv) {
+    p.sleepS *= LOW_BATTERY_STRETCH;
+    p.stretched = true;
+  }
+
+  p.sleepS = constrain(p.sleepS, minS, maxS);
+  return p;
+}
+
+uint8_t historyCount()
+{
+  return s_sleep.count;
+}
+
+const char* reasonStr(SleepReason r)
+{
+  switch (r) {
+    case SleepReason::NoTrend:   return "no_trend";
+    case SleepReason::Steady:    return "steady";
+    case SleepReason::Predicted: return "predicted";
+    case SleepReason::Dry:       return "dry";
+  }
+  return "?";
+}
+
+} // namespace SleepScheduler
@@ -0,0 +1,50 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// Perché il prossimo deep sleep dura quanto dura
+enum class SleepReason : uint8_t {
+  NoTrend,     // storico insufficiente (boot, dopo irrigazione): sleep_hours
+  Steady,      // umidità stabile o in salita: intervallo massimo
+  Predicted,   // sveglia poco prima dell'attraversamento previsto della soglia
+  Dry          // già sotto soglia: intervallo minimo
+};
+
+struct SleepPlan {
+  uint32_t    sleepS;
+  int32_t     slopeX100;   // pendenza stimata, centesimi di punto % all'ora
+  uint32_t    crossS;      // attraversamento previsto tra crossS secondi (0 = nessuno)
+  SleepReason reason;
+  bool        stretched;   // allungato per batteria scarica
+};
+
+// Scheduler adattivo del deep sleep (`adaptive_sleep`): un campione di
+// umidità per wake in RTC memory, retta ai minimi quadrati sugli ultimi
+// HISTORY punti e prossimo wake appena prima che l'umidità scenda a
+// moisture_threshold. Limiti: measurement_interval (min) e sleep_max_hours
+// (max); sotto low_battery_mv l'intervallo raddoppia.
+// L'orologio è il timer RTC, che in deep sleep continua a contare: un wake
+// anticipato dall'ULP non lo sposta, non dipende da NTP e non salta quando
+// l'ora viene sincronizzata.
+namespace SleepScheduler {
+  static const uint8_t  HISTORY = 8;
+  static const uint8_t  MIN_POINTS = 3;
+  static const uint32_t MIN_SPAN_S = 1800;          // punti troppo vicini: solo rumore
+  static const uint32_t MIN_SLEEP_S = 60;
+  static const int32_t  FLAT_SLOPE_X100 = 5;        // |pendenza| < 0.05 %/h = stabile
+  static const int      REWET_DELTA = 10;           // salita brusca (pioggia, acqua a mano): nuovo storico
+  static const uint8_t  LOW_BATTERY_STRETCH = 2;
+
+  void begin(bool coldBoot);
+
+  // Secondi dal reset del timer RTC (power-on)
+  uint32_t nowS();
+
+  // Umidità letta in questo wake; watered = pompa partita: lo storico riparte
+  void record(uint32_t nowS, int soilPercent, bool watered);
+
+  SleepPlan plan(const Config& cfg, int soilPercent, int batteryMv);
+
+  uint8_t historyCount();
+  const char* reasonStr(SleepReason r);
+}
@@ -0,0 +1,23 @@
+#include "soil_filter.h"
+#include "signal_filter.h"
+#include <Arduino.h>
+
+int soilFilterSamples(const int* samples, size_t count)
+{
+  // La mediana regge fino a (n-1)/2 spike, la media dei centrali solo uno per lato
+  SignalFilter::RunningMedian<int, SOIL_FILTER_WINDOW> median;
+  for (size_t i = 0; i < count; i++) median.push(samples[i]);
+  return median.median();
+}
+
+int soilRawToPercent(int raw)
+{
+  return map(raw, 4095, 0, 0, 100);
+}
+
+int soilPercentToRaw(int percent)
+{
+  // percent ≤ (4095 - raw) · 100 / 4095  ⇔  raw ≤ 4095 - ⌈percent · 4095 / 100⌉
+  percent = constrain(percent, 0, 100);
+  return 4095 - (percent * 4095 + 99) / 100;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <stddef.h>
+
+// Filtro anti-outlier per le letture grezze del sensore di umidità.
+// Separato da readSoil() così gira anche nell'env `native` (test/benchmark).
+
+// Mediana dei campioni (al più gli ultimi SOIL_FILTER_WINDOW), via
+// SignalFilter::RunningMedian. L'array in ingresso non viene modificato.
+static const size_t SOIL_FILTER_WINDOW = 9;
+int soilFilterSamples(const int* samples, size_t count);
+
+// Converte il valore ADC grezzo (0..4095, sensore capacitivo) in percentuale.
+int soilRawToPercent(int raw);
+
+// Inversa di soilRawToPercent(): il grezzo più alto (più secco) che dà
+// ancora almeno `percent`. Per soglie confrontate sul grezzo (ULP).
+int soilPercentToRaw(int percent);
@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+
+// Coda single-producer/single-consumer senza lock tra due task.
+// Esattamente un task chiama push() e uno solo chiama pop(): gli indici sono
+// atomici con acquire/release, niente mutex né sezioni critiche.
+// N potenza di 2; uno slot resta libero per distinguere piena da vuota.
+template <typename T, uint32_t N>
+class SpscQueue {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue: N deve essere potenza di 2");
+
+public:
+  static const uint32_t CAPACITY = N - 1;
+
+  // Solo dal produttore; false se piena (il chiamante conta lo scarto)
+  bool push(const T& v)
+  {
+    const uint32_t t = tail_.load(std::memory_order_relaxed);
+    const uint32_t next = (t + 1) & (N - 1);
+    if (next == head_.load(std::memory_order_acquire)) return false;
+    items_[t] = v;
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Solo dal consumatore
+  bool pop(T& out)
+  {
+    const uint32_t h = head_.load(std::memory_order_relaxed);
+    if (h == tail_.load(std::memory_order_acquire)) return false;
+    out = items_[h];
+    head_.store((h + 1) & (N - 1), std::memory_order_release);
+    return true;
+  }
+
+  // Indicativo se letto dall'altro lato
+  uint32_t size() const
+  {
+    return (tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire)) & (N - 1);
+  }
+
+  bool empty() const { return size() == 0; }
+
+private:
+  T items_[N];
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+};
@@ -0,0 +1,93 @@
+#include "telemetry_buffer.h"
+
+// =======================================================
+// ===================== RTC STATE =======================
+// =======================================================
+
+static const uint32_t TELEMETRY_MAGIC = 0x54454C31;  // "TEL1"
+
+struct TelemetryStore {
+  uint32_t magic;
+  uint8_t  head;      // prossimo slot da scrivere
+  uint8_t  count;
+  uint32_t dropped;
+  TelemetrySample samples[TelemetryBuffer::CAPACITY];
+};
+
+RTC_DATA_ATTR static TelemetryStore s_tel;
+
+namespace TelemetryBuffer {
+
+void begin(bool coldBoot)
+{
+  if (coldBoot || s_tel.magic != TELEMETRY_MAGIC ||
+      s_tel.head >= CAPACITY || s_tel.count > CAPACITY) {
+    s_tel.magic = TELEMETRY_MAGIC;
+    s_tel.head = 0;
+    s_tel.count = 0;
+    s_tel.dropped = 0;
+  }
+}
+
+void append(const TelemetrySample& s)
+{
+  s_tel.samples[s_tel.head] = s;
+  s_tel.head = (uint8_t)((s_tel.head + 1) % CAPACITY);
+  if (s_tel.count < CAPACITY) s_tel.count++;
+  else s_tel.dropped++;
+}
+
+void markLast(uint8_t flags)
+{
+  if (s_tel.count == 0) return;
+  uint8_t last = (uint8_t)((s_tel.head + CAPACITY - 1) % CAPACITY);
+  s_tel.samples[last].flags |= flags;
+}
+
+uint8_t count()
+{
+  return s_tel.count;
+}
+
+bool almostFull()
+{
+  return s_tel.count >= CAPACITY - 1;
+}
+
+uint32_t dropped()
+{
+  return s_tel.dropped;
+}
+
+void clear()
+{
+  s_tel.head = 0;
+  s_tel.count = 0;
+  s_tel.dropped = 0;
+}
+
+size_t formatBatch(char* out, size_t len, uint32_t wake)
+{
+  if (!out || len == 0) return 0;
+
+  size_t n = (size_t)snprintf(out, len, "{\"wake\":%lu,\"dropped\":%lu,\"s\":[",
+                              (unsigned long)wake, (unsigned long)s_tel.dropped);
+  if (n >= len) return 0;
+
+  const uint8_t first = (uint8_t)((s_tel.head + CAPACITY - s_tel.count) % CAPACITY);
+  for (uint8_t i = 0; i < s_tel.count; i++) {
+    const TelemetrySample& s = s_tel.samples[(first + i) % CAPACITY];
+    n += (size_t)snprintf(out + n, len - n, "%s[%lu,%lu,%u,%u,%u,%u]",
+                          i ? "," : "",
+                          (unsigned long)s.ts, (unsigned long)s.wake,
+                          (unsigned)s.soilPct, (unsigned)s.soilRaw,
+                          (unsigned)s.battery, (unsigned)s.flags);
+    if (n >= len) return 0;
+  }
+
+  n += (size_t)snprintf(out + n, len - n, "]}");
+  if (n >= len) return 0;
+  return n;
+}
+
+} // namespace TelemetryBuffer
@@ -0,0 +1,41 @@
+#pragma once
+#include <Arduino.h>
+
+// Flag per campione
+#define TELEMETRY_FLAG_WATERED    0x01   // la pompa è partita in questo wake
+#define TELEMETRY_FLAG_PUMP_ALERT 0x02   // failsafe pompa scattato
+#define TELEMETRY_FLAG_NO_TIME    0x04   // orologio non ancora sincronizzato (ts = 0)
+
+// Un campione per wake (16 byte)
+struct TelemetrySample {
+  uint32_t ts;        // epoch s, 0 se l'ora non è valida
+  uint32_t wake;      // bootCount del wake
+  uint16_t soilRaw;
+  uint16_t battery;   // mV calibrati sul pin
+  uint8_t  soilPct;
+  uint8_t  flags;
+  uint16_t reserved;
+};
+
+// Ring buffer di campioni in RTC memory: i wake senza radio accodano, il primo
+// wake con MQTT invia tutto il lotto in un solo publish e svuota il buffer.
+// Se il buffer si riempie i campioni più vecchi vengono sovrascritti (contati in dropped).
+namespace TelemetryBuffer {
+  static const uint8_t CAPACITY = 48;
+  // Caso peggiore di formatBatch() con CAPACITY campioni
+  static const size_t MAX_BATCH_JSON = 2048;
+
+  void begin(bool coldBoot);
+
+  void append(const TelemetrySample& s);
+  void markLast(uint8_t flags);    // aggiunge flag all'ultimo campione (es. esito pompa)
+
+  uint8_t count();
+  bool almostFull();               // basta un altro wake per perdere campioni
+  uint32_t dropped();
+  void clear();                    // dopo un upload riuscito
+
+  // {"wake":N,"dropped":D,"s":[[ts,wake,pct,raw,batt,flags],...]} dal più vecchio
+  // Ritorna 0 se il buffer di uscita non basta (nessun troncamento parziale)
+  size_t formatBatch(char* out, size_t len, uint32_t wake);
+}
@@ -0,0 +1,56 @@
+#include "telemetry_codec.h"
+
+// Scrittura esplicita little-endian: il layout non dipende da padding o endianness del compilatore
+
+static inline void putU16(uint8_t* p, uint16_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void putU32(uint8_t* p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint16_t getU16(const uint8_t* p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t getU32(const uint8_t* p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+size_t encodeTelemetryFrame(const TelemetryFrame& f, uint8_t* out, size_t len)
+{
+  if (!out || len < TELEMETRY_FRAME_V1_LEN) return 0;
+
+  out[0] = TELEMETRY_FRAME_VERSION;
+  out[1] = f.flags;
+  putU32(out + 2, f.ts);
+  out[6] = (uint8_t)f.rssi;
+  out[7] = f.soilPct;
+  putU16(out + 8, f.soilRaw);
+  putU16(out + 10, f.battery);
+  putU16(out + 12, (uint16_t)f.tempC10);
+  return TELEMETRY_FRAME_V1_LEN;
+}
+
+bool decodeTelemetryFrame(const uint8_t* in, size_t len, TelemetryFrame& out)
+{
+  if (!in || len < TELEMETRY_FRAME_V1_LEN || in[0] != TELEMETRY_FRAME_VERSION) return false;
+
+  out.flags = in[1];
+  out.ts = getU32(in + 2);
+  out.rssi = (int8_t)in[6];
+  out.soilPct = in[7];
+  out.soilRaw = getU16(in + 8);
+  out.battery = getU16(in + 10);
+  out.tempC10 = (int16_t)getU16(in + 12);
+  return true;
+}
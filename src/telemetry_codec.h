@@ -0,0 +1,40 @@
+#pragma once
+#include <Arduino.h>
+
+// =====================================================================
+// Telemetria binaria compatta su bonsai/<id>/telemetry (config.telemetry_binary)
+//
+// Frame v1, 14 byte little-endian, sostituisce i 7 topic testuali di publishStatus():
+//   [0]      version   (= 1, la lunghezza dipende dalla versione)
+//   [1]      flags     bit0 pompa accesa, bit1 ora valida, bit2 failsafe pompa
+//   [2..5]   ts        epoch s (0 se l'ora non è valida)
+//   [6]      rssi      dBm, int8
+//   [7]      soil_pct  0..100
+//   [8..9]   soil_raw  ADC grezzo
+//   [10..11] battery   mV (calibrati, sul pin)
+//   [12..13] temp      °C × 10, int16
+// Decoder di riferimento: scripts/decode_telemetry.py
+// =====================================================================
+
+#define TELEMETRY_FRAME_VERSION 1
+#define TELEMETRY_FRAME_V1_LEN  14
+
+#define TELEMETRY_BIT_PUMP_ON    0x01
+#define TELEMETRY_BIT_TIME_VALID 0x02
+#define TELEMETRY_BIT_PUMP_ALERT 0x04
+
+struct TelemetryFrame {
+  uint8_t  flags;
+  uint32_t ts;
+  int8_t   rssi;
+  uint8_t  soilPct;
+  uint16_t soilRaw;
+  uint16_t battery;
+  int16_t  tempC10;
+};
+
+// Ritorna i byte scritti, 0 se `len` non basta
+size_t encodeTelemetryFrame(const TelemetryFrame& f, uint8_t* out, size_t len);
+
+// Inverso di encodeTelemetryFrame (test e strumenti); false su versione/lunghezza errate
+bool decodeTelemetryFrame(const uint8_t* in, size_t len, TelemetryFrame& out);
@@ -0,0 +1,164 @@
+#include "ulp_monitor.h"
+#include "adc_sampler.h"
+#include "soil_filter.h"
+
+#if ULP_MONITOR_ENABLED
+extern "C" {
+  #include "esp32/ulp.h"
+  #include "driver/adc.h"
+  #include "soc/rtc_cntl_reg.h"
+  #include "esp_sleep.h"
+}
+
+// =======================================================
+// ================ RTC SLOW MEMORY (ULP) ================
+// =======================================================
+
+// Parole dati a inizio RTC_SLOW_MEM (l'ULP usa i 16 bit bassi), programma dopo:
+// ~50 parole in tutto, dentro i 512 byte che il core Arduino riserva all'ULP
+// (CONFIG_ESP32_ULP_COPROC_RESERVE_MEM) prima delle variabili RTC_DATA_ATTR
+enum UlpWord : uint32_t {
+  ULP_AVG = 0,
+  ULP_LAST,
+  ULP_SAMPLES,
+  ULP_ARMED,     // scritto solo dai core principali
+  ULP_PROG_START = 16
+};
+
+static const uint32_t ULP_ARMED_MAGIC = 0x554C;   // "UL"
+
+enum UlpLabel : uint32_t {
+  LBL_RUNNING = 1,
+  LBL_STORE,
+  LBL_WAKE,
+  LBL_DONE
+};
+
+static inline uint16_t ulpWord(UlpWord w)
+{
+  return (uint16_t)(RTC_SLOW_MEM[w] & 0xFFFF);
+}
+
+namespace UlpMonitor {
+
+bool enabled(const Config& cfg)
+{
+  return cfg.ulp_monitor && cfg.sleep_hours > 0 && !cfg.debug &&
+         AdcSampler::gpioToAdc1Channel(cfg.sensor_pin) >= 0;
+}
+
+UlpSnapshot begin(bool deepSleepWake)
+{
+  // Da sveglio l'ULP non deve contendere l'ADC a DMA e analogRead
+  CLEAR_PERI_REG_MASK(RTC_CNTL_STATE0_REG, RTC_CNTL_ULP_CP_SLP_TIMER_EN);
+
+  UlpSnapshot s = {};
+  s.valid = deepSleepWake && ulpWord(ULP_ARMED) == ULP_ARMED_MAGIC;
+  if (s.valid) {
+    s.average = ulpWord(ULP_AVG);
+    s.last = ulpWord(ULP_LAST);
+    s.samples = ulpWord(ULP_SAMPLES);
+  }
+  RTC_SLOW_MEM[ULP_ARMED] = 0;
+  return s;
+}
+
+bool arm(const Config& cfg, int soilRaw)
+{
+  if (!enabled(cfg)) return false;
+
+  // Grezzo più secco ancora ≥ moisture_threshold: oltre si sveglia
+  const int wetRaw = soilPercentToRaw(cfg.moisture_threshold);
+  if (soilRaw > wetRaw) return false;
+
+  const int ch = AdcSampler::gpioToAdc1Channel(cfg.sensor_pin);
+  adc1_config_width(ADC_WIDTH_BIT_12);
+  adc1_config_channel_atten((adc1_channel_t)ch, ADC_ATTEN_DB_11);   // come DMA/analogRead
+  adc1_ulp_enable();
+
+  // R3 = base dati, R1 = lettura, R2 = media
+  const ulp_insn_t program[] = {
+    I_MOVI(R3, 0),
+
+    // 4 conversioni (4 × 4095 sta nei 16 bit) → media
+    I_ADC(R1, 0, ch),
+    I_ADC(R0, 0, ch),
+    I_ADDR(R1, R1, R0),
+    I_ADC(R0, 0, ch),
+    I_ADDR(R1, R1, R0),
+    I_ADC(R0, 0, ch),
+    I_ADDR(R1, R1, R0),
+    I_RSHI(R1, R1, 2),
+    I_ST(R1, R3, ULP_LAST),
+
+    I_LD(R0, R3, ULP_SAMPLES),
+    I_ADDI(R0, R0, 1),
+    I_ST(R0, R3, ULP_SAMPLES),
+
+    // Media seminata dal core principale (samples = 1): si prosegue l'EWMA,
+    // altrimenti (contatore ripartito da 0) la lettura fa da primo valore
+    M_BGE(LBL_RUNNING, 2),
+    I_MOVR(R2, R1),
+    M_BX(LBL_STORE),
+
+    M_LABEL(LBL_RUNNING),
+    I_LD(R2, R3, ULP_AVG),
+    I_RSHI(R0, R2, 2),      // avg -= avg / 4
+    I_SUBR(R2, R2, R0),
+    I_RSHI(R0, R1, 2),      // avg += x / 4
+    I_ADDR(R2, R2, R0),
+
+    M_LABEL(LBL_STORE),
+    I_ST(R2, R3, ULP_AVG),
+    I_MOVR(R0, R2),
+    M_BGE(LBL_WAKE, (uint16_t)(wetRaw + 1)),
+    M_BX(LBL_DONE),
+
+    M_LABEL(LBL_WAKE),
+    // Il SoC deve essere già in sleep, altrimenti si riprova al prossimo giro
+    I_RD_REG(RTC_CNTL_LOW_POWER_ST_REG, RTC_CNTL_RDY_FOR_WAKEUP_S, RTC_CNTL_RDY_FOR_WAKEUP_S),
+    M_BL(LBL_DONE, 1),
+    I_WAKE(),
+    I_END(),                // ferma il timer ULP: lo riarma il prossimo sleep
+
+    M_LABEL(LBL_DONE),
+    I_HALT(),
+  };
+
+  RTC_SLOW_MEM[ULP_AVG] = (uint32_t)soilRaw;
+  RTC_SLOW_MEM[ULP_LAST] = (uint32_t)soilRaw;
+  RTC_SLOW_MEM[ULP_SAMPLES] = 1;
+
+  size_t size = sizeof(program) / sizeof(ulp_insn_t);
+  if (ulp_process_macros_and_load(ULP_PROG_START, program, &size) != ESP_OK) {
+    Serial.println("[ULP] load FAIL: solo timer");
+    return false;
+  }
+
+  uint32_t periodMs = cfg.measurement_interval > 0 ? (uint32_t)cfg.measurement_interval : MAX_PERIOD_MS;
+  periodMs = constrain(periodMs, MIN_PERIOD_MS, MAX_PERIOD_MS);
+  ulp_set_wakeup_period(0, periodMs * 1000UL);
+
+  if (ulp_run(ULP_PROG_START) != ESP_OK || esp_sleep_enable_ulp_wakeup() != ESP_OK) {
+    CLEAR_PERI_REG_MASK(RTC_CNTL_STATE0_REG, RTC_CNTL_ULP_CP_SLP_TIMER_EN);
+    Serial.println("[ULP] start FAIL: solo timer");
+    return false;
+  }
+
+  RTC_SLOW_MEM[ULP_ARMED] = ULP_ARMED_MAGIC;
+  Serial.printf("[ULP] armato: ch%d ogni %lu ms, sveglia sopra raw %d\n", ch,
+                (unsigned long)periodMs, wetRaw);
+  return true;
+}
+
+} // namespace UlpMonitor
+
+#else
+
+namespace UlpMonitor {
+bool enabled(const Config&) { return false; }
+UlpSnapshot begin(bool) { return UlpSnapshot(); }
+bool arm(const Config&, int) { return false; }
+}
+
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// 1 = programma per il coprocessore ULP (FSM, macro di esp32/ulp.h).
+// 0 = env native: enabled() è sempre false e si dorme solo a timer.
+#ifdef NATIVE_BUILD
+  #define ULP_MONITOR_ENABLED 0
+#else
+  #define ULP_MONITOR_ENABLED 1
+#endif
+
+// Contatori lasciati dal programma ULP in RTC slow memory
+struct UlpSnapshot {
+  bool     valid;      // il wake precedente aveva armato l'ULP
+  uint16_t average;    // media mobile (EWMA 1/4) del grezzo
+  uint16_t last;       // ultima lettura (media di 4 conversioni)
+  uint16_t samples;    // letture fatte durante il deep sleep
+};
+
+// Monitor del sensore durante il deep sleep (`ulp_monitor`): ogni
+// measurement_interval l'ULP legge l'ADC1 e aggiorna la media; sveglia i core
+// principali solo quando la media scende sotto moisture_threshold. Il report
+// periodico resta affidato al timer (sleep_hours / sleep adattivo).
+namespace UlpMonitor {
+  // Limite di ulp_set_wakeup_period() (periodo in µs su 32 bit)
+  static const uint32_t MAX_PERIOD_MS = 3600000;
+  static const uint32_t MIN_PERIOD_MS = 1000;
+
+  // ulp_monitor attivo, deep sleep abilitato e sensore su ADC1
+  bool enabled(const Config& cfg);
+
+  // Al boot, prima del task di controllo: ferma il timer ULP (l'ADC torna
+  // ai core principali) e legge i contatori del sleep appena finito
+  UlpSnapshot begin(bool deepSleepWake);
+
+  // Subito prima di esp_deep_sleep_start(). Non arma se il suolo è già
+  // sotto soglia (si sveglierebbe a ogni giro): resta solo il timer.
+  bool arm(const Config& cfg, int soilRaw);
+}
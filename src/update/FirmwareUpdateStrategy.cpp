@@ -11,6 +11,9 @@ extern "C" {
 
 extern Config config;
 
+static const int32_t  HTTP_CONNECT_TIMEOUT_MS = 3000;
+static const uint16_t HTTP_READ_TIMEOUT_MS    = 4000;
+
 // --------------------------------------------------------
 // Costruttore: prende URL dal config
 // --------------------------------------------------------
@@ -54,6 +57,10 @@ bool FirmwareUpdateStrategy::httpGetToString_(const String& url, String& out)
     HTTPClient http;
     if (!http.begin(url)) return false;
 
+    // Limiti espliciti: il check gira nel boot sequencer, non deve superare il WDT (8 s)
+    http.setConnectTimeout(HTTP_CONNECT_TIMEOUT_MS);
+    http.setTimeout(HTTP_READ_TIMEOUT_MS);
+
     int code = http.GET();
     if (code != HTTP_CODE_OK) {
         http.end();
@@ -11,6 +11,10 @@ public:
     bool performUpdate() override;
     const char* getName() override { return "Firmware"; }
 
+    // Confronto "vX.Y.Z" (-1/0/1); statici per i benchmark host
+    static bool isBadVersion_(const String& v);
+    static int compareVersions_(const String& a, const String& b);
+
 private:
     String manifestUrl_;
     String availableVersion_;
@@ -19,8 +23,6 @@ private:
     bool   hasUpdate_ = false;
 
     // internals
-    bool isBadVersion_(const String& v);
-    int compareVersions_(const String& a, const String& b);
     bool httpGetToString_(const String& url, String& out);
     bool downloadAndFlash_(const String& url, const String& sha256);
 
@@ -0,0 +1,118 @@
+#include "wake_policy.h"
+
+// =======================================================
+// ===================== RTC STATE =======================
+// =======================================================
+
+static const uint32_t WAKE_POLICY_MAGIC = 0x57414B45;  // "WAKE"
+
+struct WakeRtcState {
+  uint32_t magic;
+  int16_t  lastReportedPercent;   // -1 = mai inviato
+  uint16_t wakesSinceRadio;
+  bool     reportPending;         // report richiesto ma non consegnato
+};
+
+RTC_DATA_ATTR static WakeRtcState s_wake;
+
+static bool s_coldBoot = true;
+
+namespace WakePolicy {
+
+void begin(bool coldBoot)
+{
+  s_coldBoot = coldBoot;
+  if (coldBoot || s_wake.magic != WAKE_POLICY_MAGIC) {
+    s_wake.magic = WAKE_POLICY_MAGIC;
+    s_wake.lastReportedPercent = -1;
+    s_wake.wakesSinceRadio = 0;
+    s_wake.reportPending = false;
+  }
+}
+
+bool sensorFirst(const Config& cfg)
+{
+  // Senza deep sleep il dispositivo resta acceso: la radio serve sempre
+  return cfg.maintenance_wakes > 1 && cfg.sleep_hours > 0 &&
+         !cfg.debug && !cfg.enable_webserver;
+}
+
+RadioReason decide(const Config& cfg, int soilPercent, bool watered, bool pumpAlert,
+                   bool batchFull)
+{
+  if (!sensorFirst(cfg)) return RadioReason::AlwaysOn;
+  if (s_coldBoot) return RadioReason::ColdBoot;
+  if (pumpAlert) return RadioReason::PumpAlert;
+  if (watered) return RadioReason::Watered;
+  if (s_wake.reportPending) return RadioReason::Retry;
+  if (batchFull) return RadioReason::BatchFull;
+
+  if (s_wake.lastReportedPercent < 0 ||
+      abs(soilPercent - s_wake.lastReportedPercent) >= MOISTURE_REPORT_DELTA)
+    return RadioReason::MoistureDelta;
+
+  // +1: conta anche il wake corrente
+  if (s_wake.wakesSinceRadio + 1 >= cfg.maintenance_wakes) return RadioReason::Maintenance;
+
+  return RadioReason::None;
+}
+
+void radioDone(bool reported, int soilPercent)
+{
+  if (reported) {
+    s_wake.lastReportedPercent = (int16_t)soilPercent;
+    s_wake.wakesSinceRadio = 0;
+    s_wake.reportPending = false;
+  } else {
+    // Radio accesa ma broker irraggiungibile: si riprova al prossimo wake
+    if (s_wake.wakesSinceRadio < UINT16_MAX) s_wake.wakesSinceRadio++;
+    s_wake.reportPending = true;
+  }
+}
+
+void radioSkipped()
+{
+  if (s_wake.wakesSinceRadio < UINT16_MAX) s_wake.wakesSinceRadio++;
+}
+
+void quickWakes(uint16_t n)
+{
+  const uint32_t w = (uint32_t)s_wake.wakesSinceRadio + n;
+  s_wake.wakesSinceRadio = w > UINT16_MAX ? UINT16_MAX : (uint16_t)w;
+}
+
+uint16_t quickWakeBudget(const Config& cfg)
+{
+  if (!sensorFirst(cfg) || s_wake.reportPending || s_wake.lastReportedPercent < 0) return 0;
+  // Il wake completo dopo il budget è proprio quello di manutenzione (vedi decide())
+  const int budget = cfg.maintenance_wakes - 1 - (int)s_wake.wakesSinceRadio;
+  return budget > 0 ? (uint16_t)budget : 0;
+}
+
+int16_t lastReportedPercent()
+{
+  return s_wake.lastReportedPercent;
+}
+
+uint16_t wakesSinceRadio()
+{
+  return s_wake.wakesSinceRadio;
+}
+
+const char* reasonStr(RadioReason r)
+{
+  switch (r) {
+    case RadioReason::None:          return "none";
+    case RadioReason::ColdBoot:      return "cold_boot";
+    case RadioReason::AlwaysOn:      return "always_on";
+    case RadioReason::Watered:       return "watered";
+    case RadioReason::PumpAlert:     return "pump_alert";
+    case RadioReason::MoistureDelta: return "moisture_delta";
+    case RadioReason::Retry:         return "retry";
+    case RadioReason::BatchFull:     return "batch_full";
+    case RadioReason::Maintenance:   return "maintenance";
+  }
+  return "?";
+}
+
+} // namespace WakePolicy
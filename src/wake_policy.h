@@ -0,0 +1,48 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// Motivo per cui in questo wake si accende la radio
+enum class RadioReason : uint8_t {
+  None,           // niente da riportare: si torna a dormire senza WiFi
+  ColdBoot,       // primo avvio o reset
+  AlwaysOn,       // sensor-first disattivo, debug, webserver o niente deep sleep
+  Watered,        // la pompa è partita in questo wake
+  PumpAlert,      // failsafe pompa scattato
+  MoistureDelta,  // umidità cambiata rispetto all'ultimo valore inviato
+  Retry,          // il report del wake precedente non è stato consegnato
+  BatchFull,      // ring buffer telemetria quasi pieno
+  Maintenance     // finestra periodica per OTA, config e NTP
+};
+
+// Wake sensor-first: sensore e pompa girano subito dopo loadConfig, la radio
+// si accende solo se c'è qualcosa da riportare o è dovuta la manutenzione.
+// Lo stato (ultimo valore inviato, wake senza radio) vive in RTC memory.
+namespace WakePolicy {
+  // Variazione minima di umidità (punti %) che giustifica un report
+  static const int MOISTURE_REPORT_DELTA = 5;
+
+  void begin(bool coldBoot);
+
+  // true se la configurazione abilita i wake senza radio
+  bool sensorFirst(const Config& cfg);
+
+  RadioReason decide(const Config& cfg, int soilPercent, bool watered, bool pumpAlert,
+                     bool batchFull);
+
+  // Esito del wake: reported = MQTT connesso e stato pubblicato
+  void radioDone(bool reported, int soilPercent);
+  void radioSkipped();
+
+  // Wake gestiti dallo stub (wake_stub.h) senza boot completo: contano come
+  // wake senza radio verso la manutenzione
+  void quickWakes(uint16_t n);
+
+  // Quanti wake a timer possono chiudersi nello stub prima che la
+  // manutenzione sia dovuta (0 = serve il boot completo al prossimo wake)
+  uint16_t quickWakeBudget(const Config& cfg);
+
+  int16_t lastReportedPercent();
+  uint16_t wakesSinceRadio();
+  const char* reasonStr(RadioReason r);
+}
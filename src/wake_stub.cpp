@@ -0,0 +1,197 @@
+#include "wake_stub.h"
+#include "soil_filter.h"
+#include "adc_sampler.h"
+#include "wake_policy.h"
+
+// =======================================================
+// ====================== BANDA RAPIDA ===================
+// =======================================================
+
+namespace WakeStub {
+
+bool quickBand(int threshold, int lastReportedPct, int delta, int16_t& lo, int16_t& hi)
+{
+  if (lastReportedPct < 0) return false;
+
+  // Umidità ammessa: [low, high)
+  const int low = max(threshold, lastReportedPct - delta + 1);
+  const int high = lastReportedPct + delta;
+  if (low >= high || low > 100) return false;
+
+  hi = (int16_t)soilPercentToRaw(low);                                // raw ≤ hi ⇔ % ≥ low
+  lo = high > 100 ? (int16_t)-1 : (int16_t)soilPercentToRaw(high);    // raw > lo ⇔ % < high
+  return lo < hi;
+}
+
+} // namespace WakeStub
+
+// =======================================================
+// ========================= STUB ========================
+// =======================================================
+
+#if WAKE_STUB_ENABLED
+extern "C" {
+  #include "esp_sleep.h"
+  #include "esp_attr.h"
+  #include "soc/soc.h"
+  #include "soc/rtc.h"
+  #include "soc/rtc_cntl_reg.h"
+  #include "soc/sens_reg.h"
+  #include "soc/timer_group_reg.h"
+  #include "esp32/clk.h"
+}
+
+static const uint32_t WAKE_STUB_MAGIC = 0x53545542;  // "STUB"
+
+// Tutto ciò che lo stub legge sta qui (RTC slow memory, fuori dal CRC della
+// fast memory che il ROM verifica prima di saltare allo stub)
+struct WakeStubRtcState {
+  uint32_t magic;
+  uint32_t armed;
+  uint32_t sleepTicksLo;   // durata del sleep in cicli di RTC slow clock,
+  uint32_t sleepTicksHi;   // precalcolata con la calibrazione del wake completo
+  uint16_t budget;
+  uint16_t done;
+  int16_t  lo;
+  int16_t  hi;
+  uint16_t lastRaw;
+  uint8_t  channel;
+};
+
+RTC_DATA_ATTR static WakeStubRtcState s_stub;
+
+// Media di SAMPLES conversioni SAR ADC1 dal controller RTC, 12 bit, 11 dB
+// (come analogRead). I registri di controllo vengono ripristinati: se il
+// monitor ULP è armato l'ADC deve tornare suo.
+static uint16_t RTC_IRAM_ATTR stubReadSoil(uint8_t ch)
+{
+  const uint32_t savedStart = READ_PERI_REG(SENS_SAR_MEAS_START1_REG);
+  const uint32_t savedRead = READ_PERI_REG(SENS_SAR_READ_CTRL_REG);
+  const uint32_t savedWait = READ_PERI_REG(SENS_SAR_MEAS_WAIT2_REG);
+
+  SET_PERI_REG_BITS(SENS_SAR_MEAS_WAIT2_REG, SENS_FORCE_XPD_SAR, 3, SENS_FORCE_XPD_SAR_S);
+  CLEAR_PERI_REG_MASK(SENS_SAR_READ_CTRL_REG, SENS_SAR1_DIG_FORCE);
+  SET_PERI_REG_BITS(SENS_SAR_READ_CTRL_REG, SENS_SAR1_SAMPLE_BIT, 3, SENS_SAR1_SAMPLE_BIT_S);
+  SET_PERI_REG_BITS(SENS_SAR_START_FORCE_REG, SENS_SAR1_BIT_WIDTH, 3, SENS_SAR1_BIT_WIDTH_S);
+  SET_PERI_REG_BITS(SENS_SAR_ATTEN1_REG, 3, 3, ch * 2);
+  SET_PERI_REG_MASK(SENS_SAR_MEAS_START1_REG, SENS_MEAS1_START_FORCE | SENS_SAR1_EN_PAD_FORCE);
+  SET_PERI_REG_BITS(SENS_SAR_MEAS_START1_REG, SENS_SAR1_EN_PAD, 1U << ch, SENS_SAR1_EN_PAD_S);
+
+  uint32_t sum = 0;
+  for (uint8_t i = 0; i < WakeStub::SAMPLES; i++) {
+    CLEAR_PERI_REG_MASK(SENS_SAR_MEAS_START1_REG, SENS_MEAS1_START_SAR);
+    SET_PERI_REG_MASK(SENS_SAR_MEAS_START1_REG, SENS_MEAS1_START_SAR);
+    uint32_t guard = 100000;
+    while (!GET_PERI_REG_MASK(SENS_SAR_MEAS_START1_REG, SENS_MEAS1_DONE_SAR) && --guard) {}
+    if (!guard) {
+      sum = 0xFFFFUL * WakeStub::SAMPLES;   // ADC bloccato: fuori banda, boot completo
+      break;
+    }
+    sum += GET_PERI_REG_BITS2(SENS_SAR_MEAS_START1_REG, SENS_MEAS1_DATA_SAR, SENS_MEAS1_DATA_SAR_S);
+  }
+
+  WRITE_PERI_REG(SENS_SAR_MEAS_START1_REG, savedStart & ~SENS_MEAS1_START_SAR);
+  WRITE_PERI_REG(SENS_SAR_READ_CTRL_REG, savedRead);
+  WRITE_PERI_REG(SENS_SAR_MEAS_WAIT2_REG, savedWait);
+  return (uint16_t)(sum / WakeStub::SAMPLES);
+}
+
+static void RTC_IRAM_ATTR stubSleepAgain()
+{
+  // Il ROM abilita il watchdog di TIMG0 durante il boot da flash
+  WRITE_PERI_REG(TIMG_WDTWPROTECT_REG(0), TIMG_WDT_WKEY_VALUE);
+  WRITE_PERI_REG(TIMG_WDTFEED_REG(0), 1);
+  WRITE_PERI_REG(TIMG_WDTWPROTECT_REG(0), 0);
+
+  // Ora RTC corrente + durata precalcolata
+  SET_PERI_REG_MASK(RTC_CNTL_TIME_UPDATE_REG, RTC_CNTL_TIME_UPDATE);
+  while (GET_PERI_REG_MASK(RTC_CNTL_TIME_UPDATE_REG, RTC_CNTL_TIME_VALID) == 0) {}
+  SET_PERI_REG_MASK(RTC_CNTL_INT_CLR_REG, RTC_CNTL_TIME_VALID_INT_CLR);
+  uint64_t now = READ_PERI_REG(RTC_CNTL_TIME0_REG);
+  now |= (uint64_t)READ_PERI_REG(RTC_CNTL_TIME1_REG) << 32;
+
+  // 64 bit solo somme/shift: niente helper di libgcc, che starebbero in flash
+  const uint64_t ticks = ((uint64_t)s_stub.sleepTicksHi << 32) | s_stub.sleepTicksLo;
+  const uint64_t target = now + ticks;
+  WRITE_PERI_REG(RTC_CNTL_SLP_TIMER0_REG, (uint32_t)target);
+  WRITE_PERI_REG(RTC_CNTL_SLP_TIMER1_REG, (uint32_t)(target >> 32));
+
+  // Stesse sorgenti di wake del sleep precedente, si rientra nello stub
+  REG_WRITE(RTC_ENTRY_ADDR_REG, (uint32_t)(uintptr_t)&esp_wake_deep_sleep);
+  CLEAR_PERI_REG_MASK(RTC_CNTL_STATE0_REG, RTC_CNTL_SLEEP_EN);
+  SET_PERI_REG_MASK(RTC_CNTL_STATE0_REG, RTC_CNTL_SLEEP_EN);
+  while (true) {}
+}
+
+// Sostituisce lo stub weak dell'IDF: gira dalla RTC fast memory prima del bootloader
+extern "C" void RTC_IRAM_ATTR esp_wake_deep_sleep(void)
+{
+  esp_default_wake_deep_sleep();
+
+  if (s_stub.magic != WAKE_STUB_MAGIC || !s_stub.armed) return;
+  // Solo wake a timer: ULP e reset vanno sempre al boot completo
+  if (!(REG_GET_FIELD(RTC_CNTL_WAKEUP_STATE_REG, RTC_CNTL_WAKEUP_CAUSE) & RTC_TIMER_TRIG_EN)) return;
+  // Budget finito: questo è il wake di manutenzione/report
+  if (s_stub.done >= s_stub.budget) return;
+
+  const uint16_t raw = stubReadSoil(s_stub.channel);
+  s_stub.lastRaw = raw;
+  if ((int)raw <= s_stub.lo || (int)raw > s_stub.hi) return;   // da irrigare o da riportare
+
+  s_stub.done++;
+  stubSleepAgain();
+}
+
+namespace WakeStub {
+
+uint16_t begin()
+{
+  if (s_stub.magic != WAKE_STUB_MAGIC) {
+    s_stub = WakeStubRtcState();
+    s_stub.magic = WAKE_STUB_MAGIC;
+  }
+  const uint16_t done = s_stub.armed ? s_stub.done : 0;
+  s_stub.armed = 0;
+  s_stub.done = 0;
+  return done;
+}
+
+uint16_t lastRaw()
+{
+  return s_stub.lastRaw;
+}
+
+bool arm(const Config& cfg, uint64_t sleepUs, uint16_t budget, int lastReportedPct)
+{
+  s_stub.armed = 0;
+  if (budget == 0 || sleepUs == 0) return false;
+
+  const int ch = AdcSampler::gpioToAdc1Channel(cfg.sensor_pin);
+  if (ch < 0) return false;
+
+  int16_t lo, hi;
+  if (!quickBand(cfg.moisture_threshold, lastReportedPct, WakePolicy::MOISTURE_REPORT_DELTA, lo, hi)) return false;
+
+  const uint64_t ticks = rtc_time_us_to_slowclk(sleepUs, esp_clk_slowclk_cal_get());
+  s_stub.sleepTicksLo = (uint32_t)ticks;
+  s_stub.sleepTicksHi = (uint32_t)(ticks >> 32);
+  s_stub.budget = budget;
+  s_stub.done = 0;
+  s_stub.lo = lo;
+  s_stub.hi = hi;
+  s_stub.channel = (uint8_t)ch;
+  s_stub.armed = 1;
+  return true;
+}
+
+} // namespace WakeStub
+
+#else
+
+namespace WakeStub {
+uint16_t begin() { return 0; }
+uint16_t lastRaw() { return 0; }
+bool arm(const Config&, uint64_t, uint16_t, int) { return false; }
+}
+
+#endif
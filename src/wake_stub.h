@@ -0,0 +1,39 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// 1 = esp_wake_deep_sleep() in RTC fast memory (solo registri, niente flash).
+// 0 = env native: arm() non arma niente, resta la parte pura (quickBand).
+#ifdef NATIVE_BUILD
+  #define WAKE_STUB_ENABLED 0
+#else
+  #define WAKE_STUB_ENABLED 1
+#endif
+
+// Wake rapidi nello stub di deep sleep: sui wake a timer di routine (modalità
+// sensor-first) lo stub legge il sensore direttamente dai registri SAR ADC1,
+// aggiorna un contatore e torna a dormire senza bootloader, app, SPIFFS e
+// loadConfig. Il boot completo riparte quando la lettura esce dalla banda
+// (sotto moisture_threshold o spostata di MOISTURE_REPORT_DELTA dall'ultimo
+// report), quando è dovuta la manutenzione o dopo qualunque wake non a timer.
+namespace WakeStub {
+  // Letture SAR mediate per ogni controllo nello stub
+  static const uint8_t SAMPLES = 4;
+
+  // Al boot: wake chiusi dallo stub dall'ultimo boot completo (e disarma)
+  uint16_t begin();
+
+  // Ultima lettura grezza fatta dallo stub (0 = nessuna)
+  uint16_t lastRaw();
+
+  // Subito prima di esp_deep_sleep_start(). budget = wake rapidi concessi
+  // (WakePolicy::quickWakeBudget), lastReportedPct = ultimo valore inviato.
+  bool arm(const Config& cfg, uint64_t sleepUs, uint16_t budget, int lastReportedPct);
+
+  // ---- Parte pura (host-testabile) ----
+
+  // Banda del grezzo in cui il wake resta rapido: lo < raw <= hi equivale a
+  // umidità ≥ threshold e |umidità - lastReportedPct| < delta.
+  // false se la banda è vuota o non c'è ancora un report.
+  bool quickBand(int threshold, int lastReportedPct, int delta, int16_t& lo, int16_t& hi);
+}
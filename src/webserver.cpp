@@ -1,12 +1,22 @@
 #include "webserver.h"
 #include "config.h"
 #include "pump_controller.h"
+#include "control_task.h"
+#include "history_store.h"
 #include <ArduinoJson.h>
 #include <FS.h>
 #include <SPIFFS.h>
+#include <memory>
 
 AsyncWebServer server(80);
 
+static const uint32_t HISTORY_DEFAULT_SPAN_S = 7 * 86400UL;
+
+static uint32_t paramU32(AsyncWebServerRequest* req, const char* name, uint32_t def) {
+  if (!req->hasParam(name)) return def;
+  return (uint32_t)strtoul(req->getParam(name)->value().c_str(), nullptr, 10);
+}
+
 int globalSoil = 0;
 int globalPerc = 0;
 
@@ -23,7 +33,7 @@ void setup_webserver(int pumpPin) {
     doc["soilValue"] = globalSoil;
     doc["percentage"] = globalPerc;
     if (pumpController) {
-      doc["pumpStatus"] = pumpController->getState() ? "on" : "off";
+      doc["pumpStatus"] = ControlTask::pumpOn() ? "on" : "off";
     } else {
       doc["pumpStatus"] = digitalRead(pumpPin) == PUMP_ON ? "on" : "off";
     }
@@ -34,8 +44,9 @@ void setup_webserver(int pumpPin) {
   });
 
   server.on("/api/pump/on", HTTP_POST, [pumpPin](AsyncWebServerRequest* req){
+    // Handler nel task AsyncTCP: la pompa la comanda solo il task di controllo
     if (pumpController) {
-      pumpController->turnOn();
+      ControlTask::send(ControlCmd::PumpOn, ControlSource::Web);
     } else {
       digitalWrite(pumpPin, PUMP_ON);
     }
@@ -44,12 +55,34 @@ void setup_webserver(int pumpPin) {
 
   server.on("/api/pump/off", HTTP_POST, [pumpPin](AsyncWebServerRequest* req){
     if (pumpController) {
-      pumpController->turnOff();
+      ControlTask::send(ControlCmd::PumpOff, ControlSource::Web);
     } else {
       digitalWrite(pumpPin, PUMP_OFF);
     }
     req->send(200, "application/json", "{\"status\":\"off\"}");
   });
 
+  // Storico: ?from=&to= epoch s (default: ultimi 7 giorni), &step= s per punto
+  // (0 = automatico). Risposta chunked generata dalla flash, mai tutta in RAM.
+  // Lo store si apre qui, nel contesto di setup(), non nel task AsyncTCP.
+  historyStore();
+  server.on("/api/history", HTTP_GET, [](AsyncWebServerRequest* req){
+    HistoryStore* h = historyStore();
+    if (!h) {
+      req->send(503, "application/json", "{\"error\":\"no history partition\"}");
+      return;
+    }
+    const uint32_t to = paramU32(req, "to", h->lastTime());
+    const uint32_t from = paramU32(req, "from", to > HISTORY_DEFAULT_SPAN_S ? to - HISTORY_DEFAULT_SPAN_S : 0);
+    if (from > to) {
+      req->send(400, "application/json", "{\"error\":\"from > to\"}");
+      return;
+    }
+
+    auto stream = std::make_shared<HistoryStream>(*h, from, to, paramU32(req, "step", 0));
+    req->send(req->beginChunkedResponse("application/json",
+        [stream](uint8_t* buf, size_t maxLen, size_t) { return stream->fill(buf, maxLen); }));
+  });
+
   server.begin();
 }
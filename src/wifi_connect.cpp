@@ -0,0 +1,271 @@
+#include "wifi_connect.h"
+#include <WiFi.h>
+#include "esp_netif.h"
+#include "esp_netif_net_stack.h"
+#include "esp_private/esp_clk.h"
+#include "lwip/dhcp.h"
+
+// ---------------------------------------------------------------------------
+// Parametri
+// ---------------------------------------------------------------------------
+
+static const uint32_t CACHE_MAGIC          = 0x57494649;  // "WIFI"
+static const uint32_t FAST_TIMEOUT_MS      = 2500;        // associazione diretta a BSSID noto
+static const uint32_t FULL_TIMEOUT_MS      = 8000;        // per tentativo con scan
+static const uint8_t  FULL_MAX_ATTEMPTS    = 4;
+static const uint32_t BACKOFF_BASE_MS      = 500;         // 0.5s, 1s, 2s, ...
+static const uint32_t LEASE_DEFAULT_S      = 3600;        // durata non leggibile dal client DHCP
+static const uint32_t MIN_FAIL_MS          = 500;         // status precedenti a WiFi.begin() ignorati
+
+// Backoff dopo i tentativi 1..N-1: BASE * (2^(N-1) - 1)
+static_assert(FAST_TIMEOUT_MS + FULL_MAX_ATTEMPTS * FULL_TIMEOUT_MS +
+              BACKOFF_BASE_MS * ((1u << (FULL_MAX_ATTEMPTS - 1)) - 1) == WIFI_CONNECT_MAX_MS,
+              "WIFI_CONNECT_MAX_MS non corrisponde ai parametri di retry");
+
+// ---------------------------------------------------------------------------
+// Cache RTC (sopravvive al deep sleep, azzerata al power-on)
+// ---------------------------------------------------------------------------
+
+struct WifiRtcCache {
+  uint32_t magic;
+  uint32_t ssidHash;
+  uint8_t  bssid[6];
+  int32_t  channel;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  uint32_t leaseStartS;   // timer RTC all'assegnazione del lease
+  uint32_t leaseS;        // durata concessa dal server
+};
+
+RTC_DATA_ATTR static WifiRtcCache s_cache;
+
+// FNV-1a: la cache vale solo per l'SSID con cui è stata scritta
+static uint32_t hashSsid(const String& ssid)
+{
+  uint32_t h = 2166136261u;
+  for (unsigned int i = 0; i < ssid.length(); i++) {
+    h ^= (uint8_t)ssid[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// Timer RTC in secondi: continua in deep sleep, riparte solo al power-on
+// (quando anche la cache viene azzerata)
+static uint32_t rtcNowS()
+{
+  return (uint32_t)(esp_clk_rtc_time() / 1000000ULL);
+}
+
+// Durata del lease appena ottenuto (s); 0 se il client DHCP non la espone
+static uint32_t dhcpLeaseS()
+{
+  esp_netif_t* sta = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+  struct netif* nif = sta ? (struct netif*)esp_netif_get_netif_impl(sta) : nullptr;
+  const struct dhcp* dhcp = nif ? netif_dhcp_data(nif) : nullptr;
+  return dhcp ? dhcp->offered_t0_lease : 0;
+}
+
+// Lease riusabile fino a metà durata (T1): da lì in poi un client DHCP
+// normale lo rinnoverebbe, e il server può già averlo riassegnato alla scadenza
+static bool leaseFresh()
+{
+  const uint32_t now = rtcNowS();
+  return s_cache.ip != 0 && now >= s_cache.leaseStartS &&
+         now - s_cache.leaseStartS < s_cache.leaseS / 2;
+}
+
+static bool cacheValid(const Config& cfg)
+{
+  return s_cache.magic == CACHE_MAGIC &&
+         s_cache.ssidHash == hashSsid(cfg.wifi_ssid) &&
+         s_cache.channel > 0;
+}
+
+void wifiCacheInvalidate()
+{
+  memset(&s_cache, 0, sizeof(s_cache));
+}
+
+static void cacheStore(const Config& cfg, bool leaseFromDhcp)
+{
+  const uint8_t* bssid = WiFi.BSSID();
+  if (!bssid) return;
+
+  s_cache.magic = CACHE_MAGIC;
+  s_cache.ssidHash = hashSsid(cfg.wifi_ssid);
+  memcpy(s_cache.bssid, bssid, sizeof(s_cache.bssid));
+  s_cache.channel = WiFi.channel();
+  s_cache.ip = (uint32_t)WiFi.localIP();
+  s_cache.gateway = (uint32_t)WiFi.gatewayIP();
+  s_cache.subnet = (uint32_t)WiFi.subnetMask();
+  s_cache.dns = (uint32_t)WiFi.dnsIP();
+  if (leaseFromDhcp) {
+    const uint32_t lease = dhcpLeaseS();
+    s_cache.leaseStartS = rtcNowS();
+    s_cache.leaseS = lease ? lease : LEASE_DEFAULT_S;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+// IP statico da config (use_dhcp=false); false se i campi non sono validi
+static bool applyStaticIp(const Config& cfg)
+{
+  IPAddress ip, gw, mask;
+  if (!ip.fromString(cfg.ip_address) || !gw.fromString(cfg.gateway) || !mask.fromString(cfg.subnet))
+    return false;
+  return WiFi.config(ip, gw, mask, gw);
+}
+
+static void useDhcp()
+{
+  WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+}
+
+// ---------------------------------------------------------------------------
+// State machine
+// ---------------------------------------------------------------------------
+
+enum class WifiStep : uint8_t { Idle, FastWait, FullBackoff, FullWait, Finished };
+
+static WifiStep          s_step = WifiStep::Idle;
+static WifiConnectResult s_result = WifiConnectResult::Pending;
+static const Config*     s_cfg = nullptr;
+static bool              s_staticIp = false;
+static bool              s_reuseLease = false;
+static uint8_t           s_attempt = 0;
+static unsigned long     s_stepStart = 0;
+
+static void enterStep(WifiStep step)
+{
+  s_step = step;
+  s_stepStart = millis();
+}
+
+static void beginFull()
+{
+  WiFi.begin(s_cfg->wifi_ssid.c_str(), s_cfg->wifi_password.c_str());
+  enterStep(WifiStep::FullWait);
+}
+
+static void finishWith(WifiConnectResult r)
+{
+  s_result = r;
+  enterStep(WifiStep::Finished);
+}
+
+// Fallimento di un tentativo: prossimo retry con backoff, o resa
+static void attemptFailed()
+{
+  s_attempt++;
+  if (s_attempt >= FULL_MAX_ATTEMPTS) {
+    WiFi.disconnect(false, false);
+    finishWith(WifiConnectResult::Failed);
+    return;
+  }
+  Serial.printf("[WIFI] retry %u/%u tra %lu ms\n", s_attempt + 1, FULL_MAX_ATTEMPTS,
+                (unsigned long)(BACKOFF_BASE_MS << (s_attempt - 1)));
+  WiFi.disconnect(false, false);
+  enterStep(WifiStep::FullBackoff);
+}
+
+// ---------------------------------------------------------------------------
+// API
+// ---------------------------------------------------------------------------
+
+void wifiConnectBegin(const Config& cfg)
+{
+  s_cfg = &cfg;
+  s_attempt = 0;
+  s_result = WifiConnectResult::Pending;
+
+  if (cfg.wifi_ssid.length() == 0) {
+    finishWith(WifiConnectResult::Failed);
+    return;
+  }
+
+  WiFi.persistent(false);   // niente scrittura NVS delle credenziali ad ogni wake
+  WiFi.mode(WIFI_STA);
+
+  s_staticIp = !cfg.use_dhcp && applyStaticIp(cfg);
+
+  // ---- Fast path: BSSID + canale noti, lease riusato ----
+  if (cacheValid(cfg)) {
+    s_reuseLease = !s_staticIp && leaseFresh();
+    if (s_reuseLease) {
+      WiFi.config(IPAddress(s_cache.ip), IPAddress(s_cache.gateway),
+                  IPAddress(s_cache.subnet), IPAddress(s_cache.dns));
+    }
+    WiFi.begin(cfg.wifi_ssid.c_str(), cfg.wifi_password.c_str(), s_cache.channel, s_cache.bssid, true);
+    enterStep(WifiStep::FastWait);
+    return;
+  }
+
+  // ---- Full path: scan + DHCP ----
+  beginFull();
+}
+
+WifiConnectResult wifiConnectPoll()
+{
+  const unsigned long inStep = millis() - s_stepStart;
+
+  switch (s_step) {
+    case WifiStep::Idle:
+    case WifiStep::Finished:
+      return s_result;
+
+    case WifiStep::FastWait: {
+      const wl_status_t st = WiFi.status();
+      if (st == WL_CONNECTED) {
+        cacheStore(*s_cfg, !s_reuseLease && !s_staticIp);
+        finishWith(WifiConnectResult::Fast);
+        break;
+      }
+      if (inStep >= FAST_TIMEOUT_MS ||
+          (inStep >= MIN_FAIL_MS && (st == WL_CONNECT_FAILED || st == WL_NO_SSID_AVAIL))) {
+        // AP cambiato, canale diverso o lease non più valido: si riparte da zero
+        Serial.println("[WIFI] fast reconnect fallito, scan completo");
+        wifiCacheInvalidate();
+        WiFi.disconnect(false, false);
+        if (!s_staticIp) useDhcp();
+        beginFull();
+      }
+      break;
+    }
+
+    case WifiStep::FullBackoff:
+      if (inStep >= (BACKOFF_BASE_MS << (s_attempt - 1))) beginFull();
+      break;
+
+    case WifiStep::FullWait: {
+      const wl_status_t st = WiFi.status();
+      if (st == WL_CONNECTED) {
+        cacheStore(*s_cfg, !s_staticIp);
+        finishWith(WifiConnectResult::Full);
+        break;
+      }
+      if (inStep >= FULL_TIMEOUT_MS ||
+          (inStep >= MIN_FAIL_MS && (st == WL_CONNECT_FAILED || st == WL_NO_SSID_AVAIL)))
+        attemptFailed();
+      break;
+    }
+  }
+
+  return s_step == WifiStep::Finished ? s_result : WifiConnectResult::Pending;
+}
+
+const char* wifiConnectResultStr(WifiConnectResult r)
+{
+  switch (r) {
+    case WifiConnectResult::Pending: return "pending";
+    case WifiConnectResult::Fast:   return "fast";
+    case WifiConnectResult::Full:   return "full";
+    case WifiConnectResult::Failed: return "failed";
+  }
+  return "?";
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// Esito della connessione WiFi
+enum class WifiConnectResult : uint8_t {
+  Pending,  // connessione in corso
+  Fast,     // riconnessione da cache RTC (BSSID + canale + lease, niente scan/DHCP)
+  Full,     // scan completo + DHCP (o IP statico da config)
+  Failed    // tentativi esauriti
+};
+
+// Connessione WiFi con fast-path da RTC memory dopo deep sleep:
+// BSSID, canale e ultimo lease DHCP (o IP statico se use_dhcp=false) evitano
+// scan e DHCP; il lease si riusa fino a metà della durata concessa dal server,
+// poi il fast path passa comunque da DHCP. In caso di errore: scan completo
+// con retry limitati e backoff esponenziale. Non dura mai oltre WIFI_CONNECT_MAX_MS.
+// A polling, per il boot non bloccante: wifiConnectBegin() avvia,
+// wifiConnectPoll() restituisce Pending finché non termina.
+void wifiConnectBegin(const Config& cfg);
+
+// Caso peggiore della state machine (fast path fallito + tutti i tentativi
+// completi con i backoff), verificato in wifi_connect.cpp contro i parametri
+static const uint32_t WIFI_CONNECT_MAX_MS = 38000;
+
+WifiConnectResult wifiConnectPoll();
+
+// Dimentica BSSID/canale/lease (es. dopo cambio SSID)
+void wifiCacheInvalidate();
+
+const char* wifiConnectResultStr(WifiConnectResult r);
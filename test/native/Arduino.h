@@ -0,0 +1,121 @@
+#pragma once
+// =====================================================================
+// Shim host del core Arduino-ESP32 per l'env PlatformIO `native`.
+// Header-only: basta -I test/native per compilare i moduli di src/ su Linux.
+// Lo stato simulato (pin, ADC, riavvii) vive nel namespace `native`
+// così i test possono pilotarlo e verificarlo.
+// =====================================================================
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <mutex>
+
+#include "WString.h"
+#include "Stream.h"
+#include "esp_system.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_IRAM_ATTR
+#define RTC_RODATA_ATTR
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+// Sezioni critiche FreeRTOS (spinlock tra i core): un mutex sull'host
+struct portMUX_TYPE { std::mutex m; };
+#define portMUX_INITIALIZER_UNLOCKED {}
+#define portENTER_CRITICAL(mux) (mux)->m.lock()
+#define portEXIT_CRITICAL(mux)  (mux)->m.unlock()
+
+#ifndef constrain
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#endif
+
+using std::min;
+using std::max;
+
+namespace native {
+  inline int pinLevel[40] = {};
+  inline int pinModes[40] = {};
+  inline int analogValue[40] = {};
+  inline unsigned restartCount = 0;
+
+  inline std::chrono::steady_clock::time_point bootTime() {
+    static const auto t0 = std::chrono::steady_clock::now();
+    return t0;
+  }
+}
+
+inline unsigned long millis() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - native::bootTime()).count();
+}
+
+inline unsigned long micros() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - native::bootTime()).count();
+}
+
+inline void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+inline void delayMicroseconds(unsigned int us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+inline void yield() {}
+
+inline void pinMode(uint8_t pin, uint8_t mode) { if (pin < 40) native::pinModes[pin] = mode; }
+inline void digitalWrite(uint8_t pin, uint8_t val) { if (pin < 40) native::pinLevel[pin] = val; }
+inline int digitalRead(uint8_t pin) { return pin < 40 ? native::pinLevel[pin] : LOW; }
+inline uint16_t analogRead(uint8_t pin) { return pin < 40 ? (uint16_t)native::analogValue[pin] : 0; }
+inline uint32_t analogReadMilliVolts(uint8_t pin) { return (uint32_t)analogRead(pin) * 3300UL / 4095UL; }
+
+inline long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  const long run = in_max - in_min;
+  if (run == 0) return -1;
+  const long rise = out_max - out_min;
+  const long delta = x - in_min;
+  return (delta * rise) / run + out_min;
+}
+
+inline void configTime(long gmtOffset, int dstOffset, const char*, const char* = nullptr, const char* = nullptr) {
+  (void)gmtOffset; (void)dstOffset;
+}
+
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long) {}
+  size_t write(uint8_t b) override { return fputc(b, stdout) == EOF ? 0 : 1; }
+  size_t write(const uint8_t* buf, size_t n) override { return fwrite(buf, 1, n, stdout); }
+  using Print::write;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  void flush() override { fflush(stdout); }
+  operator bool() const { return true; }
+};
+
+inline HardwareSerial Serial;
+
+class EspClass {
+public:
+  void restart() { native::restartCount++; }
+  uint32_t getFreeHeap() { return 200000; }
+  uint32_t getMinFreeHeap() { return 150000; }
+  uint32_t getMaxAllocHeap() { return 110000; }
+};
+
+inline EspClass ESP;
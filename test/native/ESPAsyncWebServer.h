@@ -0,0 +1,132 @@
+#pragma once
+// Shim host di ESPAsyncWebServer per l'env `native`.
+// Gli handler registrati restano accessibili (`native::routes`) così i test
+// possono invocarli con richieste simulate.
+#include <functional>
+#include <vector>
+#include "Arduino.h"
+#include "FS.h"
+
+typedef enum {
+  HTTP_GET     = 0b00000001,
+  HTTP_POST    = 0b00000010,
+  HTTP_DELETE  = 0b00000100,
+  HTTP_PUT     = 0b00001000,
+  HTTP_PATCH   = 0b00010000,
+  HTTP_HEAD    = 0b00100000,
+  HTTP_OPTIONS = 0b01000000,
+  HTTP_ANY     = 0b01111111,
+} WebRequestMethod;
+
+class AsyncWebParameter {
+public:
+  AsyncWebParameter(const String& name, const String& value, bool post = false)
+    : name_(name), value_(value), post_(post) {}
+  const String& name() const { return name_; }
+  const String& value() const { return value_; }
+  bool isPost() const { return post_; }
+private:
+  String name_;
+  String value_;
+  bool post_;
+};
+
+class AsyncWebServerRequest;
+
+class AsyncWebServerResponse {
+public:
+  virtual ~AsyncWebServerResponse() {}
+  void addHeader(const char*, const char*) {}
+};
+
+typedef std::function<size_t(uint8_t*, size_t, size_t)> AwsResponseFiller;
+
+class AsyncWebServerRequest {
+public:
+  std::vector<AsyncWebParameter> params;
+  int sentCode = 0;
+  String sentType;
+  String sentBody;
+  void* _tempObject = nullptr;
+
+  bool hasParam(const char* name, bool post = false) const { return findParam(name, post) != nullptr; }
+  bool hasParam(const String& name, bool post = false) const { return hasParam(name.c_str(), post); }
+  const AsyncWebParameter* getParam(const char* name, bool post = false) const { return findParam(name, post); }
+  const AsyncWebParameter* getParam(const String& name, bool post = false) const { return getParam(name.c_str(), post); }
+
+  void send(int code, const char* type = "", const String& body = String()) {
+    sentCode = code;
+    sentType = type;
+    sentBody = body;
+  }
+  void send(int code, const String& type, const String& body) { send(code, type.c_str(), body); }
+  void send(fs::FS& fs, const String& path, const String& type) {
+    File f = fs.open(path, "r");
+    if (!f) { send(404); return; }
+    send(200, type, f.readString());
+  }
+  void send(AsyncWebServerResponse* r) { sentCode = 200; delete r; }
+
+  AsyncWebServerResponse* beginChunkedResponse(const String& type, AwsResponseFiller filler) {
+    sentType = type;
+    uint8_t buf[512];
+    size_t index = 0, n;
+    while ((n = filler(buf, sizeof(buf), index)) > 0) {
+      sentBody.concat((const char*)buf, (unsigned)n);
+      index += n;
+    }
+    return new AsyncWebServerResponse();
+  }
+
+private:
+  const AsyncWebParameter* findParam(const char* name, bool post) const {
+    for (auto& p : params)
+      if (p.isPost() == post && p.name() == name) return &p;
+    return nullptr;
+  }
+};
+
+typedef std::function<void(AsyncWebServerRequest*)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest*, const String&, size_t, uint8_t*, size_t, bool)> ArUploadHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest*, uint8_t*, size_t, size_t, size_t)> ArBodyHandlerFunction;
+
+namespace native {
+  struct Route {
+    String uri;
+    WebRequestMethod method;
+    ArRequestHandlerFunction onRequest;
+    ArBodyHandlerFunction onBody;
+  };
+  inline std::vector<Route> routes;
+
+  inline Route* findRoute(const char* uri, WebRequestMethod method) {
+    for (auto& r : routes)
+      if (r.uri == uri && r.method == method) return &r;
+    return nullptr;
+  }
+}
+
+class AsyncCallbackWebHandler {
+public:
+  AsyncCallbackWebHandler& setFilter(std::function<bool(AsyncWebServerRequest*)>) { return *this; }
+};
+
+class AsyncWebServer {
+public:
+  explicit AsyncWebServer(uint16_t) {}
+  void begin() {}
+  void end() {}
+
+  AsyncCallbackWebHandler& on(const char* uri, WebRequestMethod method, ArRequestHandlerFunction onRequest) {
+    native::routes.push_back({String(uri), method, onRequest, nullptr});
+    return handler_;
+  }
+  AsyncCallbackWebHandler& on(const char* uri, WebRequestMethod method, ArRequestHandlerFunction onRequest,
+                              ArUploadHandlerFunction, ArBodyHandlerFunction onBody = nullptr) {
+    native::routes.push_back({String(uri), method, onRequest, onBody});
+    return handler_;
+  }
+
+private:
+  AsyncCallbackWebHandler handler_;
+};
@@ -0,0 +1,107 @@
+#pragma once
+// Shim host del filesystem Arduino (FS/File) per l'env `native`.
+// I file vivono in memoria: i test partono da un FS vuoto e deterministico.
+
+#include <map>
+#include <memory>
+#include <string>
+#include "Arduino.h"
+
+namespace fs {
+
+class File : public Stream {
+public:
+  File() {}
+  File(std::shared_ptr<std::string> data, bool writable, std::string name)
+    : data_(std::move(data)), writable_(writable), name_(std::move(name)) {}
+
+  size_t write(uint8_t b) override {
+    if (!data_ || !writable_) return 0;
+    data_->push_back((char)b);
+    return 1;
+  }
+  size_t write(const uint8_t* buf, size_t n) override {
+    if (!data_ || !writable_) return 0;
+    data_->append((const char*)buf, n);
+    return n;
+  }
+  using Print::write;
+
+  int available() override { return data_ ? (int)(data_->size() - pos_) : 0; }
+  int read() override {
+    if (!data_ || pos_ >= data_->size()) return -1;
+    return (uint8_t)(*data_)[pos_++];
+  }
+  int peek() override {
+    if (!data_ || pos_ >= data_->size()) return -1;
+    return (uint8_t)(*data_)[pos_];
+  }
+  size_t read(uint8_t* buf, size_t n) { return readBytes((char*)buf, n); }
+  bool seek(uint32_t p) { if (!data_ || p > data_->size()) return false; pos_ = p; return true; }
+  size_t position() const { return pos_; }
+  size_t size() const { return data_ ? data_->size() : 0; }
+  const char* name() const { return name_.c_str(); }
+  void flush() override {}
+  void close() { data_.reset(); }
+  operator bool() const { return (bool)data_; }
+
+private:
+  std::shared_ptr<std::string> data_;
+  bool writable_ = false;
+  size_t pos_ = 0;
+  std::string name_;
+};
+
+class FS {
+public:
+  bool begin(bool formatOnFail = false, const char* = "/spiffs", uint8_t = 10, const char* = nullptr) {
+    (void)formatOnFail;
+    mounted_ = true;
+    return true;
+  }
+  void end() { mounted_ = false; }
+  bool format() { files_.clear(); return true; }
+
+  File open(const char* path, const char* mode = "r", bool create = false) {
+    (void)create;
+    std::string p(path);
+    if (mode[0] == 'r') {
+      auto it = files_.find(p);
+      if (it == files_.end()) return File();
+      return File(it->second, false, p);
+    }
+    auto& slot = files_[p];
+    if (!slot || mode[0] == 'w') slot = std::make_shared<std::string>();
+    return File(slot, true, p);
+  }
+  File open(const String& path, const char* mode = "r", bool create = false) { return open(path.c_str(), mode, create); }
+
+  bool exists(const char* path) { return files_.count(path) > 0; }
+  bool exists(const String& path) { return exists(path.c_str()); }
+  bool remove(const char* path) { return files_.erase(path) > 0; }
+  bool remove(const String& path) { return remove(path.c_str()); }
+  bool rename(const char* from, const char* to) {
+    auto it = files_.find(from);
+    if (it == files_.end()) return false;
+    files_[to] = it->second;
+    files_.erase(std::string(from));
+    return true;
+  }
+  bool rename(const String& from, const String& to) { return rename(from.c_str(), to.c_str()); }
+
+  size_t totalBytes() { return 0x80000; }
+  size_t usedBytes() {
+    size_t n = 0;
+    for (auto& f : files_) n += f.second ? f.second->size() : 0;
+    return n;
+  }
+
+private:
+  std::map<std::string, std::shared_ptr<std::string>> files_;
+  bool mounted_ = false;
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
@@ -0,0 +1,24 @@
+#pragma once
+// Shim host di HTTPClient per l'env `native` (ogni GET fallisce: niente rete).
+#include "Arduino.h"
+#include "WiFiClient.h"
+
+#define HTTP_CODE_OK 200
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+
+class HTTPClient {
+public:
+  bool begin(const String&) { return true; }
+  bool begin(WiFiClient&, const String&) { return true; }
+  void setTimeout(uint16_t) {}
+  void setConnectTimeout(int32_t) {}
+  int GET() { return HTTPC_ERROR_CONNECTION_REFUSED; }
+  int getSize() { return -1; }
+  String getString() { return String(); }
+  WiFiClient* getStreamPtr() { return &client_; }
+  WiFiClient& getStream() { return client_; }
+  bool connected() { return false; }
+  void end() {}
+private:
+  WiFiClient client_;
+};
@@ -0,0 +1,36 @@
+#pragma once
+// Shim host di IPAddress per l'env `native`.
+#include "Arduino.h"
+
+class IPAddress {
+public:
+  IPAddress() {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) { b_[0] = a; b_[1] = b; b_[2] = c; b_[3] = d; }
+  explicit IPAddress(uint32_t v) { memcpy(b_, &v, 4); }
+
+  bool fromString(const char* s) {
+    unsigned a, b, c, d;
+    if (!s || sscanf(s, "%u.%u.%u.%u", &a, &b, &c, &d) != 4) return false;
+    if (a > 255 || b > 255 || c > 255 || d > 255) return false;
+    b_[0] = (uint8_t)a; b_[1] = (uint8_t)b; b_[2] = (uint8_t)c; b_[3] = (uint8_t)d;
+    return true;
+  }
+  bool fromString(const String& s) { return fromString(s.c_str()); }
+
+  operator uint32_t() const { uint32_t v; memcpy(&v, b_, 4); return v; }
+  uint8_t operator[](int i) const { return b_[i]; }
+  uint8_t& operator[](int i) { return b_[i]; }
+  bool operator==(const IPAddress& o) const { return memcmp(b_, o.b_, 4) == 0; }
+  bool operator!=(const IPAddress& o) const { return !(*this == o); }
+
+  String toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", b_[0], b_[1], b_[2], b_[3]);
+    return String(buf);
+  }
+
+private:
+  uint8_t b_[4] = {0, 0, 0, 0};
+};
+
+inline const IPAddress INADDR_NONE(0, 0, 0, 0);
@@ -0,0 +1,5 @@
+#pragma once
+// Shim host di LittleFS per l'env `native` (FS in memoria, vedi FS.h).
+#include "FS.h"
+
+inline fs::FS LittleFS;
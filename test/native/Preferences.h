@@ -0,0 +1,66 @@
+#pragma once
+// Shim host di Preferences (NVS) per l'env `native`: namespace in memoria.
+#include <map>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+
+namespace native {
+  inline std::map<std::string, std::map<std::string, std::vector<uint8_t>>> nvs;
+}
+
+class Preferences {
+public:
+  bool begin(const char* ns, bool readOnly = false) { ns_ = ns; ro_ = readOnly; open_ = true; return true; }
+  void end() { open_ = false; }
+  bool clear() { if (!writable()) return false; space().clear(); return true; }
+  bool remove(const char* key) { return writable() && space().erase(key) > 0; }
+  bool isKey(const char* key) { return open_ && space().count(key) > 0; }
+
+  size_t putBytes(const char* key, const void* v, size_t n) {
+    if (!writable()) return 0;
+    auto p = (const uint8_t*)v;
+    space()[key] = std::vector<uint8_t>(p, p + n);
+    return n;
+  }
+  size_t getBytesLength(const char* key) {
+    auto it = space().find(key);
+    return it == space().end() ? 0 : it->second.size();
+  }
+  size_t getBytes(const char* key, void* buf, size_t maxLen) {
+    auto it = space().find(key);
+    if (it == space().end() || it->second.size() > maxLen) return 0;
+    memcpy(buf, it->second.data(), it->second.size());
+    return it->second.size();
+  }
+
+  size_t putString(const char* key, const String& v) { return putBytes(key, v.c_str(), v.length() + 1); }
+  String getString(const char* key, const String& def = String()) {
+    auto it = space().find(key);
+    return it == space().end() ? def : String((const char*)it->second.data());
+  }
+
+  size_t putUInt(const char* key, uint32_t v) { return putT(key, v); }
+  uint32_t getUInt(const char* key, uint32_t def = 0) { return getT(key, def); }
+  size_t putInt(const char* key, int32_t v) { return putT(key, v); }
+  int32_t getInt(const char* key, int32_t def = 0) { return getT(key, def); }
+  size_t putULong64(const char* key, uint64_t v) { return putT(key, v); }
+  uint64_t getULong64(const char* key, uint64_t def = 0) { return getT(key, def); }
+  size_t putLong64(const char* key, int64_t v) { return putT(key, v); }
+  int64_t getLong64(const char* key, int64_t def = 0) { return getT(key, def); }
+  size_t putBool(const char* key, bool v) { return putT(key, (uint8_t)v); }
+  bool getBool(const char* key, bool def = false) { return getT(key, (uint8_t)def) != 0; }
+
+private:
+  template <typename T> size_t putT(const char* key, T v) { return putBytes(key, &v, sizeof(v)); }
+  template <typename T> T getT(const char* key, T def) {
+    T v;
+    return getBytes(key, &v, sizeof(v)) == sizeof(v) ? v : def;
+  }
+  bool writable() const { return open_ && !ro_; }
+  std::map<std::string, std::vector<uint8_t>>& space() { return native::nvs[ns_]; }
+
+  std::string ns_;
+  bool ro_ = false;
+  bool open_ = false;
+};
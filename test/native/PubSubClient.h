@@ -0,0 +1,77 @@
+#pragma once
+// Shim host di PubSubClient per l'env `native`.
+// Nessun socket: connect() riesce sempre e i publish vengono solo contati;
+// l'ultimo topic/payload resta in un buffer fisso (zero allocazioni, così i
+// benchmark non misurano il mock).
+#include <functional>
+#include "Arduino.h"
+#include "WiFiClient.h"
+
+#define MQTT_CONNECTED 0
+#define MQTT_DISCONNECTED -1
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+
+class PubSubClient {
+public:
+  PubSubClient() {}
+  explicit PubSubClient(WiFiClient&) {}
+
+  PubSubClient& setClient(WiFiClient&) { return *this; }
+  PubSubClient& setServer(const char*, uint16_t) { return *this; }
+  PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE) { this->callback = callback; return *this; }
+  PubSubClient& setKeepAlive(uint16_t) { return *this; }
+  PubSubClient& setSocketTimeout(uint16_t) { return *this; }
+  bool setBufferSize(uint16_t size) { bufferSize_ = size; return true; }
+  uint16_t getBufferSize() { return bufferSize_; }
+
+  bool connect(const char* id) { return connect(id, nullptr, nullptr, nullptr, 0, false, nullptr, true); }
+  bool connect(const char* id, const char* u, const char* p) { return connect(id, u, p, nullptr, 0, false, nullptr, true); }
+  bool connect(const char* id, const char* u, const char* p, const char* wt, uint8_t wq, bool wr, const char* wm) {
+    return connect(id, u, p, wt, wq, wr, wm, true);
+  }
+  bool connect(const char*, const char*, const char*, const char*, uint8_t, bool, const char*, bool cleanSession) {
+    connected_ = true;
+    lastCleanSession = cleanSession;
+    connectCount++;
+    return true;
+  }
+  void disconnect() { connected_ = false; }
+  bool connected() { return connected_; }
+  int state() { return connected_ ? MQTT_CONNECTED : MQTT_DISCONNECTED; }
+  bool loop() { return connected_; }
+
+  bool publish(const char* topic, const char* payload) { return publish(topic, payload, false); }
+  bool publish(const char* topic, const char* payload, bool retained) {
+    return publish(topic, (const uint8_t*)payload, payload ? (unsigned)strlen(payload) : 0, retained);
+  }
+  bool publish(const char* topic, const uint8_t* payload, unsigned int len) { return publish(topic, payload, len, false); }
+  bool publish(const char* topic, const uint8_t* payload, unsigned int len, bool retained) {
+    if (!connected_) return false;
+    publishCount++;
+    lastRetained = retained;
+    snprintf(lastTopic, sizeof(lastTopic), "%s", topic ? topic : "");
+    lastPayloadLen = len < sizeof(lastPayload) - 1 ? len : (unsigned)sizeof(lastPayload) - 1;
+    if (payload) memcpy(lastPayload, payload, lastPayloadLen);
+    lastPayload[lastPayloadLen] = 0;
+    return true;
+  }
+
+  bool subscribe(const char*) { subscribeCount++; return connected_; }
+  bool subscribe(const char*, uint8_t) { subscribeCount++; return connected_; }
+  bool unsubscribe(const char*) { return connected_; }
+
+  // Stato ispezionabile dai test
+  unsigned publishCount = 0;
+  unsigned subscribeCount = 0;
+  unsigned connectCount = 0;
+  bool lastRetained = false;
+  bool lastCleanSession = true;
+  char lastTopic[128] = {};
+  char lastPayload[1024] = {};
+  unsigned lastPayloadLen = 0;
+
+private:
+  MQTT_CALLBACK_SIGNATURE;
+  bool connected_ = false;
+  uint16_t bufferSize_ = 256;
+};
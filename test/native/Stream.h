@@ -0,0 +1,69 @@
+#pragma once
+// Shim host di Print/Stream (env PlatformIO `native`).
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include "WString.h"
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t* buf, size_t n) {
+    size_t w = 0;
+    while (n--) w += write(*buf++);
+    return w;
+  }
+  size_t write(const char* s) { return s ? write((const uint8_t*)s, strlen(s)) : 0; }
+  virtual void flush() {}
+
+  size_t print(const char* s) { return write(s); }
+  size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return print(String(v)); }
+  size_t print(unsigned int v) { return print(String(v)); }
+  size_t print(long v) { return print(String(v)); }
+  size_t print(unsigned long v) { return print(String(v)); }
+  size_t print(double v, int d = 2) { return print(String(v, (unsigned int)d)); }
+
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(const T& v) { size_t n = print(v); return n + println(); }
+
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+    char buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n < 0) return 0;
+    return write((const uint8_t*)buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  size_t readBytes(char* buf, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+      int c = read();
+      if (c < 0) break;
+      buf[i++] = (char)c;
+    }
+    return i;
+  }
+  size_t readBytes(uint8_t* buf, size_t n) { return readBytes((char*)buf, n); }
+
+  String readString() {
+    String out;
+    int c;
+    while ((c = read()) >= 0) out += (char)c;
+    return out;
+  }
+
+  void setTimeout(unsigned long) {}
+};
@@ -0,0 +1,15 @@
+#pragma once
+// Shim host di Update (flash OTA) per l'env `native`.
+#include "Arduino.h"
+
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+
+class UpdateClass {
+public:
+  bool begin(size_t = UPDATE_SIZE_UNKNOWN) { return false; }
+  size_t write(uint8_t*, size_t len) { return len; }
+  bool end(bool = false) { return false; }
+  const char* errorString() { return "native"; }
+};
+
+inline UpdateClass Update;
@@ -0,0 +1,164 @@
+#pragma once
+// Shim host di Arduino `String` (env PlatformIO `native`).
+// Implementazione su std::string: copre il sottoinsieme di API usato in src/.
+
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cctype>
+#include <cstdint>
+
+class String {
+public:
+  String() {}
+  String(const char* s) : s_(s ? s : "") {}
+  String(const char* s, size_t n) : s_(s ? std::string(s, n) : std::string()) {}
+  String(const std::string& s) : s_(s) {}
+  String(const String&) = default;
+  String(String&&) noexcept = default;
+  explicit String(char c) : s_(1, c) {}
+  explicit String(unsigned char v, unsigned char base = 10) { fromInt((unsigned long long)v, base); }
+  explicit String(int v, unsigned char base = 10) { fromSigned(v, base); }
+  explicit String(unsigned int v, unsigned char base = 10) { fromInt(v, base); }
+  explicit String(long v, unsigned char base = 10) { fromSigned(v, base); }
+  explicit String(unsigned long v, unsigned char base = 10) { fromInt(v, base); }
+  explicit String(long long v, unsigned char base = 10) { fromSigned(v, base); }
+  explicit String(unsigned long long v, unsigned char base = 10) { fromInt(v, base); }
+  explicit String(float v, unsigned int decimals = 2) { fromDouble(v, decimals); }
+  explicit String(double v, unsigned int decimals = 2) { fromDouble(v, decimals); }
+
+  String& operator=(const String&) = default;
+  String& operator=(String&&) noexcept = default;
+  String& operator=(const char* s) { s_ = s ? s : ""; return *this; }
+
+  const char* c_str() const { return s_.c_str(); }
+  unsigned int length() const { return (unsigned int)s_.size(); }
+  bool isEmpty() const { return s_.empty(); }
+  bool reserve(unsigned int n) { s_.reserve(n); return true; }
+  char charAt(unsigned int i) const { return i < s_.size() ? s_[i] : 0; }
+  char operator[](unsigned int i) const { return charAt(i); }
+  char& operator[](unsigned int i) { return s_[i]; }
+  void setCharAt(unsigned int i, char c) { if (i < s_.size()) s_[i] = c; }
+
+  bool concat(const String& o) { s_ += o.s_; return true; }
+  bool concat(const char* s) { if (!s) return false; s_ += s; return true; }
+  bool concat(const char* s, unsigned int n) { if (!s) return false; s_.append(s, n); return true; }
+  bool concat(char c) { s_ += c; return true; }
+  bool concat(int v) { return concat(String(v)); }
+  bool concat(unsigned int v) { return concat(String(v)); }
+  bool concat(long v) { return concat(String(v)); }
+  bool concat(unsigned long v) { return concat(String(v)); }
+
+  String& operator+=(const String& o) { concat(o); return *this; }
+  String& operator+=(const char* s) { concat(s); return *this; }
+  String& operator+=(char c) { concat(c); return *this; }
+  String& operator+=(int v) { concat(v); return *this; }
+  String& operator+=(unsigned int v) { concat(v); return *this; }
+  String& operator+=(long v) { concat(v); return *this; }
+  String& operator+=(unsigned long v) { concat(v); return *this; }
+
+  int compareTo(const String& o) const { return s_.compare(o.s_); }
+  bool equals(const String& o) const { return s_ == o.s_; }
+  bool equals(const char* s) const { return s_ == (s ? s : ""); }
+  bool equalsIgnoreCase(const String& o) const {
+    if (s_.size() != o.s_.size()) return false;
+    for (size_t i = 0; i < s_.size(); i++)
+      if (tolower((unsigned char)s_[i]) != tolower((unsigned char)o.s_[i])) return false;
+    return true;
+  }
+  bool startsWith(const String& p) const { return s_.compare(0, p.s_.size(), p.s_) == 0; }
+  bool endsWith(const String& p) const {
+    return s_.size() >= p.s_.size() && s_.compare(s_.size() - p.s_.size(), p.s_.size(), p.s_) == 0;
+  }
+
+  int indexOf(char c, unsigned int from = 0) const { return pos(s_.find(c, from)); }
+  int indexOf(const String& p, unsigned int from = 0) const { return pos(s_.find(p.s_, from)); }
+  int lastIndexOf(char c) const { return pos(s_.rfind(c)); }
+  int lastIndexOf(const String& p) const { return pos(s_.rfind(p.s_)); }
+
+  String substring(unsigned int from) const { return from < s_.size() ? String(s_.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > to) { unsigned int t = from; from = to; to = t; }
+    if (from >= s_.size()) return String();
+    return String(s_.substr(from, to - from));
+  }
+
+  void replace(char a, char b) { for (auto& c : s_) if (c == a) c = b; }
+  void replace(const String& a, const String& b) {
+    if (a.s_.empty()) return;
+    size_t p = 0;
+    while ((p = s_.find(a.s_, p)) != std::string::npos) {
+      s_.replace(p, a.s_.size(), b.s_);
+      p += b.s_.size();
+    }
+  }
+  void remove(unsigned int index) { if (index < s_.size()) s_.erase(index); }
+  void remove(unsigned int index, unsigned int count) { if (index < s_.size()) s_.erase(index, count); }
+  void toLowerCase() { for (auto& c : s_) c = (char)tolower((unsigned char)c); }
+  void toUpperCase() { for (auto& c : s_) c = (char)toupper((unsigned char)c); }
+  void trim() {
+    size_t b = 0, e = s_.size();
+    while (b < e && isspace((unsigned char)s_[b])) b++;
+    while (e > b && isspace((unsigned char)s_[e - 1])) e--;
+    s_ = s_.substr(b, e - b);
+  }
+
+  long toInt() const { return strtol(s_.c_str(), nullptr, 10); }
+  float toFloat() const { return (float)strtod(s_.c_str(), nullptr); }
+  double toDouble() const { return strtod(s_.c_str(), nullptr); }
+
+  friend bool operator==(const String& a, const String& b) { return a.s_ == b.s_; }
+  friend bool operator==(const String& a, const char* b) { return a.equals(b); }
+  friend bool operator==(const char* a, const String& b) { return b.equals(a); }
+  friend bool operator!=(const String& a, const String& b) { return !(a == b); }
+  friend bool operator!=(const String& a, const char* b) { return !(a == b); }
+  friend bool operator!=(const char* a, const String& b) { return !(a == b); }
+  friend bool operator<(const String& a, const String& b) { return a.s_ < b.s_; }
+  friend bool operator>(const String& a, const String& b) { return a.s_ > b.s_; }
+  friend bool operator<=(const String& a, const String& b) { return a.s_ <= b.s_; }
+  friend bool operator>=(const String& a, const String& b) { return a.s_ >= b.s_; }
+
+private:
+  static int pos(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+
+  void fromInt(unsigned long long v, unsigned char base) {
+    if (base < 2 || base > 36) base = 10;
+    char buf[72];
+    int i = (int)sizeof(buf) - 1;
+    buf[i] = 0;
+    do {
+      int d = (int)(v % base);
+      buf[--i] = (char)(d < 10 ? '0' + d : 'a' + d - 10);
+      v /= base;
+    } while (v);
+    s_ = &buf[i];
+  }
+  void fromSigned(long long v, unsigned char base) {
+    if (v < 0 && base == 10) {
+      fromInt((unsigned long long)(-(v + 1)) + 1ULL, base);
+      s_.insert(s_.begin(), '-');
+    } else {
+      fromInt((unsigned long long)v, base);
+    }
+  }
+  void fromDouble(double v, unsigned int decimals) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+    s_ = buf;
+  }
+
+  std::string s_;
+};
+
+// Compatibilità con ArduinoJson (riconosce StringSumHelper come stringa Arduino)
+class StringSumHelper : public String {
+public:
+  using String::String;
+  StringSumHelper(const String& s) : String(s) {}
+};
+
+inline StringSumHelper operator+(const String& a, const String& b) { StringSumHelper r(a); r.concat(b); return r; }
+inline StringSumHelper operator+(const String& a, const char* b) { StringSumHelper r(a); r.concat(b); return r; }
+inline StringSumHelper operator+(const char* a, const String& b) { StringSumHelper r(a); r.concat(b); return r; }
+inline StringSumHelper operator+(const String& a, char b) { StringSumHelper r(a); r.concat(b); return r; }
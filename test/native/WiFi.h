@@ -0,0 +1,50 @@
+#pragma once
+// Shim host della WiFi ESP32 per l'env `native`.
+// `native::wifiStatus`/`native::wifiRssi` permettono ai test di simulare la rete.
+#include "Arduino.h"
+#include "IPAddress.h"
+#include "WiFiClient.h"
+#include "WiFiClientSecure.h"
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6,
+  WL_NO_SHIELD = 255
+} wl_status_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 } wifi_mode_t;
+
+namespace native {
+  inline wl_status_t wifiStatus = WL_CONNECTED;
+  inline int wifiRssi = -60;
+}
+
+class WiFiClass {
+public:
+  wl_status_t begin(const char*, const char* = nullptr, int32_t = 0, const uint8_t* = nullptr, bool = true) {
+    return native::wifiStatus;
+  }
+  bool config(IPAddress, IPAddress, IPAddress, IPAddress = IPAddress(), IPAddress = IPAddress()) { return true; }
+  bool disconnect(bool = false, bool = false) { return true; }
+  bool mode(wifi_mode_t) { return true; }
+  bool setSleep(bool) { return true; }
+  bool setAutoReconnect(bool) { return true; }
+  bool persistent(bool) { return true; }
+  wl_status_t status() { return native::wifiStatus; }
+  bool isConnected() { return native::wifiStatus == WL_CONNECTED; }
+  int8_t RSSI() { return (int8_t)native::wifiRssi; }
+  int32_t channel() { return 6; }
+  uint8_t* BSSID() { static uint8_t b[6] = {0x02, 0, 0, 0, 0, 1}; return b; }
+  String macAddress() { return String("24:6F:28:AA:BB:CC"); }
+  IPAddress localIP() { return IPAddress(192, 168, 1, 150); }
+  IPAddress gatewayIP() { return IPAddress(192, 168, 1, 1); }
+  IPAddress subnetMask() { return IPAddress(255, 255, 255, 0); }
+  IPAddress dnsIP(uint8_t = 0) { return IPAddress(192, 168, 1, 1); }
+};
+
+inline WiFiClass WiFi;
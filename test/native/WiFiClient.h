@@ -0,0 +1,21 @@
+#pragma once
+// Shim host di WiFiClient per l'env `native` (nessuna rete reale).
+#include "Arduino.h"
+#include "IPAddress.h"
+
+class WiFiClient : public Stream {
+public:
+  virtual ~WiFiClient() {}
+  virtual int connect(const char*, uint16_t) { return 0; }
+  virtual int connect(IPAddress, uint16_t) { return 0; }
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t*, size_t n) override { return n; }
+  using Print::write;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  void stop() {}
+  uint8_t connected() { return 0; }
+  void setNoDelay(bool) {}
+  operator bool() { return connected(); }
+};
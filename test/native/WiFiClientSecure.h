@@ -0,0 +1,10 @@
+#pragma once
+// Shim host di WiFiClientSecure per l'env `native`.
+#include "WiFiClient.h"
+
+class WiFiClientSecure : public WiFiClient {
+public:
+  void setInsecure() {}
+  void setCACert(const char*) {}
+  void setHandshakeTimeout(unsigned long) {}
+};
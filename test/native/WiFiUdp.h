@@ -0,0 +1,17 @@
+#pragma once
+// Shim host di WiFiUDP per l'env `native`.
+#include "Arduino.h"
+#include "IPAddress.h"
+
+class WiFiUDP : public Stream {
+public:
+  int beginPacket(const char*, uint16_t) { return 1; }
+  int beginPacket(IPAddress, uint16_t) { return 1; }
+  int endPacket() { return 1; }
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t*, size_t n) override { return n; }
+  using Print::write;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+};
@@ -0,0 +1,22 @@
+#pragma once
+// Shim host delle API OTA ESP-IDF per l'env `native`.
+#include <stdint.h>
+
+typedef int esp_err_t;
+#ifndef ESP_OK
+#define ESP_OK 0
+#define ESP_FAIL -1
+#endif
+
+typedef struct {
+  uint32_t magic_word;
+  uint32_t secure_version;
+  char version[32];
+  char project_name[32];
+} esp_app_desc_t;
+
+static inline const esp_app_desc_t* esp_ota_get_app_description(void) {
+  static const esp_app_desc_t desc = {0xABCD5432, 0, "native", "bonsai"};
+  return &desc;
+}
+static inline esp_err_t esp_ota_mark_app_valid_cancel_rollback(void) { return ESP_OK; }
@@ -0,0 +1,129 @@
+#pragma once
+// Shim host di esp_partition per l'env `native`: partizioni dati in RAM con la
+// semantica della NOR flash (write porta solo bit 1→0, erase a settori da 4 KB
+// riporta a 0xFF). "history" e "kvstore" esistono già; i test ne aggiungono con
+// addPartition().
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef int esp_err_t;
+#ifndef ESP_OK
+#define ESP_OK 0
+#endif
+#ifndef ESP_FAIL
+#define ESP_FAIL -1
+#endif
+#ifndef ESP_ERR_INVALID_ARG
+#define ESP_ERR_INVALID_ARG 0x102
+#endif
+#ifndef ESP_ERR_INVALID_SIZE
+#define ESP_ERR_INVALID_SIZE 0x104
+#endif
+
+#ifndef SPI_FLASH_SEC_SIZE
+#define SPI_FLASH_SEC_SIZE 4096
+#endif
+
+typedef enum {
+  ESP_PARTITION_TYPE_APP = 0x00,
+  ESP_PARTITION_TYPE_DATA = 0x01,
+} esp_partition_type_t;
+
+typedef enum {
+  ESP_PARTITION_SUBTYPE_DATA_NVS = 0x02,
+  ESP_PARTITION_SUBTYPE_DATA_SPIFFS = 0x82,
+  ESP_PARTITION_SUBTYPE_ANY = 0xff,
+} esp_partition_subtype_t;
+
+typedef struct {
+  esp_partition_type_t type;
+  esp_partition_subtype_t subtype;
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+  bool encrypted;
+} esp_partition_t;
+
+namespace native {
+  struct FlashPartition {
+    esp_partition_t part;
+    std::vector<uint8_t> data;
+    uint32_t erases = 0;
+    uint32_t writes = 0;
+  };
+
+  inline std::map<std::string, FlashPartition>& flashPartitions() {
+    static std::map<std::string, FlashPartition> parts;
+    return parts;
+  }
+
+  inline FlashPartition& addPartition(const char* label, uint32_t size) {
+    FlashPartition& p = flashPartitions()[label];
+    memset(&p.part, 0, sizeof(p.part));
+    p.part.type = ESP_PARTITION_TYPE_DATA;
+    p.part.subtype = (esp_partition_subtype_t)0x40;
+    p.part.size = size;
+    strncpy(p.part.label, label, sizeof(p.part.label) - 1);
+    p.data.assign(size, 0xFF);
+    p.erases = p.writes = 0;
+    return p;
+  }
+
+  inline FlashPartition* flashPartition(const esp_partition_t* part) {
+    auto it = flashPartitions().find(part->label);
+    return it == flashPartitions().end() ? nullptr : &it->second;
+  }
+
+  // Stesse righe di partitions_ota.csv
+  inline bool defaultPartitions() {
+    addPartition("history", 0x40000).part.subtype = (esp_partition_subtype_t)0x41;
+    addPartition("kvstore", 0x10000);
+    return true;
+  }
+  inline bool partitionsReady = defaultPartitions();
+}
+
+static inline const esp_partition_t* esp_partition_find_first(esp_partition_type_t type,
+                                                              esp_partition_subtype_t subtype,
+                                                              const char* label) {
+  for (auto& kv : native::flashPartitions()) {
+    const esp_partition_t& p = kv.second.part;
+    if (p.type != type) continue;
+    if (subtype != ESP_PARTITION_SUBTYPE_ANY && p.subtype != subtype) continue;
+    if (label && kv.first != label) continue;
+    return &p;
+  }
+  return nullptr;
+}
+
+static inline esp_err_t esp_partition_read(const esp_partition_t* part, size_t off, void* dst, size_t len) {
+  native::FlashPartition* p = native::flashPartition(part);
+  if (!p) return ESP_ERR_INVALID_ARG;
+  if (off + len > part->size) return ESP_ERR_INVALID_SIZE;
+  memcpy(dst, p->data.data() + off, len);
+  return ESP_OK;
+}
+
+static inline esp_err_t esp_partition_write(const esp_partition_t* part, size_t off, const void* src, size_t len) {
+  native::FlashPartition* p = native::flashPartition(part);
+  if (!p) return ESP_ERR_INVALID_ARG;
+  if (off + len > part->size) return ESP_ERR_INVALID_SIZE;
+  const uint8_t* s = (const uint8_t*)src;
+  for (size_t i = 0; i < len; i++) p->data[off + i] &= s[i];   // NOR: solo 1→0
+  p->writes++;
+  return ESP_OK;
+}
+
+static inline esp_err_t esp_partition_erase_range(const esp_partition_t* part, size_t off, size_t len) {
+  native::FlashPartition* p = native::flashPartition(part);
+  if (!p) return ESP_ERR_INVALID_ARG;
+  if (off % SPI_FLASH_SEC_SIZE || len % SPI_FLASH_SEC_SIZE) return ESP_ERR_INVALID_ARG;
+  if (off + len > part->size) return ESP_ERR_INVALID_SIZE;
+  memset(p->data.data() + off, 0xFF, len);
+  p->erases += (uint32_t)(len / SPI_FLASH_SEC_SIZE);
+  return ESP_OK;
+}
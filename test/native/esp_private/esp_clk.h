@@ -0,0 +1,7 @@
+#pragma once
+// Shim host di esp_private/esp_clk.h per l'env `native`.
+#include <stdint.h>
+#include "Arduino.h"
+
+// Sul device: timer RTC in µs, continua in deep sleep
+static inline uint64_t esp_clk_rtc_time(void) { return (uint64_t)micros(); }
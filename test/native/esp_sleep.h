@@ -0,0 +1,12 @@
+#pragma once
+// Shim host di esp_sleep.h per l'env `native`.
+#include <stdint.h>
+
+typedef enum {
+  ESP_SLEEP_WAKEUP_UNDEFINED, ESP_SLEEP_WAKEUP_ALL, ESP_SLEEP_WAKEUP_EXT0, ESP_SLEEP_WAKEUP_EXT1,
+  ESP_SLEEP_WAKEUP_TIMER, ESP_SLEEP_WAKEUP_TOUCHPAD, ESP_SLEEP_WAKEUP_ULP,
+} esp_sleep_wakeup_cause_t;
+
+static inline esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(void) { return ESP_SLEEP_WAKEUP_UNDEFINED; }
+static inline int esp_sleep_enable_timer_wakeup(uint64_t us) { (void)us; return 0; }
+static inline void esp_deep_sleep_start(void) {}
@@ -0,0 +1,16 @@
+#pragma once
+// Shim host del task watchdog ESP-IDF per l'env `native`.
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef int esp_err_t;
+#ifndef ESP_OK
+#define ESP_OK 0
+#define ESP_FAIL -1
+#endif
+typedef void* TaskHandle_t;
+
+static inline esp_err_t esp_task_wdt_init(uint32_t timeout_s, bool panic) { (void)timeout_s; (void)panic; return ESP_OK; }
+static inline esp_err_t esp_task_wdt_add(TaskHandle_t h) { (void)h; return ESP_OK; }
+static inline esp_err_t esp_task_wdt_delete(TaskHandle_t h) { (void)h; return ESP_OK; }
+static inline esp_err_t esp_task_wdt_reset(void) { return ESP_OK; }
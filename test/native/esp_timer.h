@@ -0,0 +1,6 @@
+#pragma once
+// Shim host di esp_timer per l'env `native`.
+#include <stdint.h>
+#include "Arduino.h"
+
+static inline int64_t esp_timer_get_time(void) { return (int64_t)micros(); }
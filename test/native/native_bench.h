@@ -0,0 +1,67 @@
+#pragma once
+// =====================================================================
+// Micro-benchmark per l'env `native`: ns/op e allocazioni heap per call.
+// Il conteggio allocazioni richiede NATIVE_BENCH_COUNT_ALLOCS in UNA sola
+// unità di compilazione della suite (sostituisce operator new/delete).
+// =====================================================================
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace native {
+  inline unsigned long long allocCount = 0;
+  inline unsigned long long allocBytes = 0;
+}
+
+struct BenchResult {
+  const char* name;
+  unsigned long iterations;
+  double nsPerOp;
+  double allocsPerOp;
+  double bytesPerOp;
+};
+
+// Esegue `fn` per `iterations` volte (dopo un giro di warm-up) e stampa una
+// riga nel formato: BENCH <nome> <ns/op> ns/op <alloc/op> allocs/op <B/op> B/op
+template <typename Fn>
+BenchResult benchRun(const char* name, unsigned long iterations, Fn&& fn)
+{
+  for (unsigned long i = 0; i < iterations / 10 + 1; i++) fn();
+
+  const unsigned long long a0 = native::allocCount;
+  const unsigned long long b0 = native::allocBytes;
+  const auto t0 = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < iterations; i++) fn();
+  const auto t1 = std::chrono::steady_clock::now();
+
+  BenchResult r;
+  r.name = name;
+  r.iterations = iterations;
+  r.nsPerOp = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / iterations;
+  r.allocsPerOp = (double)(native::allocCount - a0) / iterations;
+  r.bytesPerOp = (double)(native::allocBytes - b0) / iterations;
+
+  printf("BENCH %-32s %10.1f ns/op %8.2f allocs/op %9.1f B/op\n",
+         r.name, r.nsPerOp, r.allocsPerOp, r.bytesPerOp);
+  fflush(stdout);
+  return r;
+}
+
+#ifdef NATIVE_BENCH_COUNT_ALLOCS
+void* operator new(std::size_t n)
+{
+  native::allocCount++;
+  native::allocBytes += n;
+  if (void* p = std::malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+void* operator new[](std::size_t n) { return operator new(n); }
+// Unico punto che libera: fuori linea, così GCC 12 non vede free() accanto
+// all'operator new inlinato (-Wmismatched-new-delete); le altre forme inoltrano qui
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { ::operator delete(p); }
+void operator delete(void* p, std::size_t) noexcept { ::operator delete(p); }
+void operator delete[](void* p, std::size_t) noexcept { ::operator delete[](p); }
+#endif
@@ -0,0 +1,1455 @@
+// =====================================================================
+// Benchmark host del core firmware (pio test -e native -f test_bench)
+// Ogni test verifica il risultato funzionale e stampa ns/op + alloc/op.
+// =====================================================================
+#define NATIVE_BENCH_COUNT_ALLOCS
+#include <native_bench.h>
+
+#include <unity.h>
+#include <Arduino.h>
+
+#include "config.h"
+#include "config_api.h"
+#include "config_validator.h"
+#include "config_cache.h"
+#include "config_schema.h"
+#include "record_store.h"
+#include "history_store.h"
+#include <Preferences.h>
+#include "mqtt.h"
+#include "pump_controller.h"
+#include "soil_filter.h"
+#include "adc_sampler.h"
+#include "signal_filter.h"
+#include <algorithm>
+#include "telemetry_buffer.h"
+#include "telemetry_codec.h"
+#include "report_policy.h"
+#include "sleep_scheduler.h"
+#include "wake_stub.h"
+#include "wake_policy.h"
+#include "boot_sequencer.h"
+#include "control_task.h"
+#include "irrigation_controller.h"
+#include "spsc_queue.h"
+#include <thread>
+#include "update/FirmwareUpdateStrategy.h"
+
+// Globali che sul device vivono in main.cpp
+Config config;
+PumpController* pumpController = nullptr;
+int soilValue = 0;
+int soilPercent = 0;
+int batteryMv = 0;
+WiFiClient* plainClient = nullptr;
+WiFiClientSecure* secureClient = nullptr;
+AsyncWebServer server(80);  // webserver.cpp non fa parte dell'env native
+
+// trigger_firmware_check.cpp non fa parte dell'env native
+void triggerFirmwareCheck() {}
+
+static const char* SAMPLE_CONFIG_JSON = R"JSON({
+  "wifi_ssid": "bonsai-net",
+  "wifi_password": "supersecret",
+  "config_version": "20250728",
+  "update_server": "https://update.example.org",
+  "mqtt_broker": "mqtt.example.org",
+  "mqtt_username": "bonsai",
+  "mqtt_password": "mqtt-password",
+  "mqtt_port": 1883,
+  "led_pin": 4,
+  "sensor_pin": 32,
+  "pump_pin": 26,
+  "relay_pin": 27,
+  "battery_pin": 34,
+  "moisture_threshold": 25,
+  "pump_duration": 5,
+  "measurement_interval": 1800000,
+  "debug": false,
+  "use_pump": true,
+  "enable_webserver": false,
+  "sleep_hours": 1,
+  "webserver_timeout": 60,
+  "use_dhcp": true,
+  "ip_address": "192.168.1.150",
+  "gateway": "192.168.1.1",
+  "subnet": "255.255.255.0",
+  "ota_manifest_url": "http://192.168.1.10:3000/firmware/manifest.json",
+  "timezone": "Europe/Rome"
+})JSON";
+
+static const unsigned long ITER = 20000;
+
+void setUp()
+{
+  config = getDefaultConfig();
+  jsonToConfig(SAMPLE_CONFIG_JSON, config);
+  setupDeviceId();
+  mqttReady = true;
+  mqttClient.connect(deviceId.c_str());
+}
+
+void tearDown() {}
+
+// ------------------------------------------------------------------
+// Config
+// ------------------------------------------------------------------
+
+static void bench_jsonToConfig()
+{
+  const String json(SAMPLE_CONFIG_JSON);
+  Config c = getDefaultConfig();
+  TEST_ASSERT_TRUE(jsonToConfig(json, c));
+  TEST_ASSERT_EQUAL_STRING("bonsai-net", c.wifi_ssid.c_str());
+  TEST_ASSERT_EQUAL(1800000, c.measurement_interval);
+
+  benchRun("jsonToConfig", ITER, [&] { jsonToConfig(json, c); });
+}
+
+static void bench_configToJson()
+{
+  Config back = getDefaultConfig();
+  TEST_ASSERT_TRUE(jsonToConfig(configToJson(config), back));
+  TEST_ASSERT_TRUE(back.wifi_ssid == config.wifi_ssid);
+  TEST_ASSERT_EQUAL(config.sleep_hours, back.sleep_hours);
+
+  size_t sink = 0;
+  benchRun("configToJson", ITER, [&] { sink += configToJson(config).length(); });
+  TEST_ASSERT_TRUE(sink > 0);
+}
+
+static void bench_configStream()
+{
+  // Chiavi fuori tabella saltate dal filtro, anche annidate
+  const char* extra = R"({"firmware_version":"1.0.0","junk":{"a":[1,2,3]},"moisture_threshold":33})";
+  Config c = config;
+  TEST_ASSERT_TRUE(jsonToConfig(extra, strlen(extra), c));
+  TEST_ASSERT_EQUAL(33, c.moisture_threshold);
+
+  // Salvataggio e rilettura dallo stream del File
+  c.sleep_hours = 7;
+  TEST_ASSERT_TRUE(saveConfigStruct(c));
+  Config back = getDefaultConfig();
+  TEST_ASSERT_TRUE(loadConfig(back));
+  TEST_ASSERT_EQUAL(7, back.sleep_hours);
+
+  // POST /api/config in due chunk: risposta solo all'ultimo, applicato da loop()
+  setupConfigApi();
+  native::Route* r = native::findRoute("/api/config", HTTP_POST);
+  TEST_ASSERT_NOT_NULL(r);
+  const char* body = R"({"moisture_threshold":41})";
+  const size_t total = strlen(body);
+  AsyncWebServerRequest req;
+  r->onBody(&req, (uint8_t*)body, 10, 0, total);
+  TEST_ASSERT_EQUAL(0, req.sentCode);
+  r->onBody(&req, (uint8_t*)body + 10, total - 10, 10, total);
+  TEST_ASSERT_EQUAL(202, req.sentCode);
+  TEST_ASSERT_TRUE(req.sentBody == "{\"status\":\"accepted\"}");
+
+  AsyncWebServerRequest busy;
+  r->onBody(&busy, (uint8_t*)body, total, 0, total);
+  TEST_ASSERT_EQUAL(503, busy.sentCode);
+
+  serviceConfigApi();
+  TEST_ASSERT_EQUAL(41, config.moisture_threshold);
+
+  // Valore fuori limiti: rifiutato subito, senza leggere config
+  const char* bad = R"({"moisture_threshold":400})";
+  AsyncWebServerRequest invalid;
+  r->onBody(&invalid, (uint8_t*)bad, strlen(bad), 0, strlen(bad));
+  TEST_ASSERT_EQUAL(400, invalid.sentCode);
+  serviceConfigApi();
+  TEST_ASSERT_EQUAL(41, config.moisture_threshold);
+
+  AsyncWebServerRequest big;
+  r->onBody(&big, (uint8_t*)body, total, 0, CONFIG_BODY_MAX + 1);
+  TEST_ASSERT_EQUAL(413, big.sentCode);
+
+  benchRun("jsonToConfig(filter)", ITER, [&] { jsonToConfig(extra, strlen(extra), c); });
+}
+
+static void bench_validateConfig()
+{
+  TEST_ASSERT_TRUE(validateConfig(config));
+  benchRun("validateConfig", ITER * 10, [&] { validateConfig(config); });
+}
+
+static void bench_configSchema()
+{
+  // Tabella coerente: nomi unici, default dentro i limiti
+  for (const ConfigField& f : CONFIG_FIELDS) {
+    TEST_ASSERT_TRUE(ConfigSchema::find(f.name) == &f);
+    if (f.type == ConfigFieldType::Int) {
+      TEST_ASSERT_TRUE(f.def >= f.min && f.def <= f.max);
+    } else if (f.type == ConfigFieldType::Str) {
+      TEST_ASSERT_TRUE((int32_t)strlen(f.defStr) <= f.max);
+    }
+  }
+
+  // Default validi salvo il campo obbligatorio
+  Config c = getDefaultConfig();
+  TEST_ASSERT_EQUAL(1883, c.mqtt_port);
+  TEST_ASSERT_EQUAL(4, c.led_pin);
+  TEST_ASSERT_TRUE(c.timezone == "Europe/Rome");
+  TEST_ASSERT_FALSE(validateConfig(c));
+  c.wifi_ssid = "bonsai-net";
+  TEST_ASSERT_TRUE(validateConfig(c));
+
+  c.pump_pin = 7;    // flash
+  TEST_ASSERT_FALSE(validateConfig(c));
+  c.pump_pin = 26;
+  c.irrigation_soak_s = 601;
+  TEST_ASSERT_FALSE(validateConfig(c));
+  c.irrigation_soak_s = 30;
+  c.subnet = "255.255.255.255.0";
+  TEST_ASSERT_FALSE(validateConfig(c));
+  c.subnet = "";
+  TEST_ASSERT_TRUE(validateConfig(c));
+
+  // Capacità dei documenti dalla tabella
+  TEST_ASSERT_TRUE(CONFIG_PARSE_CAPACITY > CONFIG_JSON_CAPACITY);
+  TEST_ASSERT_TRUE(CONFIG_IMAGE_BYTES < CONFIG_JSON_CAPACITY);
+
+  static uint8_t image[CONFIG_IMAGE_BYTES];
+  TEST_ASSERT_TRUE(ConfigSchema::toImage(c, image));
+  Config back = getDefaultConfig();
+  ConfigSchema::fromImage(image, back);
+  TEST_ASSERT_TRUE(back.wifi_ssid == c.wifi_ssid);
+  TEST_ASSERT_TRUE(validateConfig(back));
+
+  benchRun("getDefaultConfig", ITER, [&] { c = getDefaultConfig(); });
+}
+
+static void bench_configApply()
+{
+  Config a = getDefaultConfig();
+  a.wifi_ssid = "bonsai-net";
+  a.mqtt_broker = "192.168.1.10";
+  Config b = a;
+  TEST_ASSERT_TRUE(ConfigSchema::applyClass(a, b) == ConfigApply::None);
+
+  b.moisture_threshold = 40;
+  b.timezone = "UTC0";
+  TEST_ASSERT_TRUE(ConfigSchema::applyClass(a, b) == ConfigApply::Live);
+  b.mqtt_port = 8883;
+  TEST_ASSERT_TRUE(ConfigSchema::applyClass(a, b) == ConfigApply::Reconnect);
+  b.pump_pin = 25;
+  TEST_ASSERT_TRUE(ConfigSchema::applyClass(a, b) == ConfigApply::Restart);
+  TEST_ASSERT_EQUAL_STRING("restart", ConfigSchema::applyStr(ConfigApply::Restart));
+
+  // Solo i campi cambiati
+  ConfigSchema::update(a, b);
+  TEST_ASSERT_EQUAL(40, a.moisture_threshold);
+  TEST_ASSERT_EQUAL(8883, a.mqtt_port);
+  TEST_ASSERT_TRUE(a.timezone == "UTC0");
+  TEST_ASSERT_TRUE(ConfigSchema::applyClass(a, b) == ConfigApply::None);
+
+  // Worker inline (native): la pausa è immediata
+  TEST_ASSERT_TRUE(mqttPause(100));
+  mqttResume(false);
+
+  // Restart rinviato (reboot=0), poi una modifica live: la prima resta salvata
+  const Config keep = config;
+  config = getDefaultConfig();
+  config.wifi_ssid = "bonsai-net";
+  ConfigApply applied;
+  Config saved;
+  const char* pin = R"({"pump_pin":25})";
+  TEST_ASSERT_TRUE(persistAndApplyConfig(pin, strlen(pin), applied, saved));
+  TEST_ASSERT_TRUE(applied == ConfigApply::Restart);
+  TEST_ASSERT_EQUAL(26, config.pump_pin);
+  const char* thr = R"({"moisture_threshold":40})";
+  TEST_ASSERT_TRUE(persistAndApplyConfig(thr, strlen(thr), applied, saved));
+  TEST_ASSERT_TRUE(applied == ConfigApply::Live);
+  TEST_ASSERT_EQUAL(40, config.moisture_threshold);
+  TEST_ASSERT_EQUAL(26, config.pump_pin);
+  TEST_ASSERT_EQUAL(25, saved.pump_pin);
+  Config flash = getDefaultConfig();
+  TEST_ASSERT_TRUE(ConfigCache::restoreFlash(flash));
+  TEST_ASSERT_EQUAL(25, flash.pump_pin);
+  TEST_ASSERT_EQUAL(40, flash.moisture_threshold);
+
+  // Tornando al pin in uso non resta niente in sospeso
+  const char* back = R"({"pump_pin":26})";
+  TEST_ASSERT_TRUE(persistAndApplyConfig(back, strlen(back), applied, saved));
+  TEST_ASSERT_TRUE(applied == ConfigApply::Restart);
+  Config mixed = a;
+  ConfigSchema::copyFlagged(mixed, b, CFG_RESTART);
+  TEST_ASSERT_EQUAL(25, mixed.pump_pin);
+  TEST_ASSERT_EQUAL(40, mixed.moisture_threshold);
+  config = keep;
+  TEST_ASSERT_TRUE(mqttFlush(100));   // ack su bonsai/ack/config
+
+  PumpController p(26, 60000);
+  p.setMaxRunMs(90000);
+  TEST_ASSERT_EQUAL_UINT32(90000, p.getMaxRunMs());
+
+  benchRun("applyClass", ITER, [&] { (void)ConfigSchema::applyClass(a, b); });
+}
+
+static void bench_configCache()
+{
+  TEST_ASSERT_EQUAL_UINT32(0xCBF43926UL, ConfigCache::crc32("123456789", 9));
+
+  Config c = getDefaultConfig();
+  c.wifi_ssid = "bonsai-net";
+  c.mqtt_broker = "192.168.1.10";
+  c.timezone = "Europe/Rome";
+  c.mqtt_port = 1884;
+  c.sleep_hours = 3;
+  c.adaptive_sleep = true;
+
+  static ConfigImage img;
+  TEST_ASSERT_TRUE(ConfigCache::pack(c, img));
+  Config back = getDefaultConfig();
+  TEST_ASSERT_TRUE(ConfigCache::unpack(img, back));
+  TEST_ASSERT_TRUE(back.wifi_ssid == c.wifi_ssid);
+  TEST_ASSERT_TRUE(back.mqtt_broker == c.mqtt_broker);
+  TEST_ASSERT_EQUAL(c.mqtt_port, back.mqtt_port);
+  TEST_ASSERT_EQUAL(c.sleep_hours, back.sleep_hours);
+  TEST_ASSERT_TRUE(back.adaptive_sleep);
+  TEST_ASSERT_TRUE(configToJson(back) == configToJson(c));
+
+  // Immagine corrotta o di un altro layout: scartata
+  img.data[CONFIG_IMAGE_BYTES / 2] ^= 1;
+  TEST_ASSERT_FALSE(ConfigCache::unpack(img, back));
+  img.data[CONFIG_IMAGE_BYTES / 2] ^= 1;
+  img.schema++;
+  TEST_ASSERT_FALSE(ConfigCache::unpack(img, back));
+  img.schema--;
+
+  // Stringa oltre il campo fisso: niente cache
+  Config big = c;
+  big.wifi_ssid = String("0123456789012345678901234567890123");
+  TEST_ASSERT_FALSE(ConfigCache::pack(big, img));
+
+  // Solo i wake da deep sleep usano la cache; flash riscritta solo se cambia
+  RecordStore* kv = kvStore();
+  TEST_ASSERT_NOT_NULL(kv);
+  TEST_ASSERT_TRUE(ConfigCache::store(c));
+  const uint32_t ver = kv->version(REC_CONFIG);
+  TEST_ASSERT_TRUE(ConfigCache::store(c));
+  TEST_ASSERT_EQUAL_UINT32(ver, kv->version(REC_CONFIG));
+  ConfigSource src = ConfigSource::Json;
+  TEST_ASSERT_FALSE(ConfigCache::restore(back, false, src));
+  back = getDefaultConfig();
+  TEST_ASSERT_TRUE(ConfigCache::restore(back, true, src));
+  TEST_ASSERT_TRUE(src == ConfigSource::Rtc);
+  TEST_ASSERT_EQUAL(1884, back.mqtt_port);
+  back = getDefaultConfig();
+  TEST_ASSERT_TRUE(ConfigCache::restoreFlash(back));
+  TEST_ASSERT_TRUE(ConfigCache::flashSource() == ConfigSource::Store);
+  TEST_ASSERT_TRUE(back.timezone == "Europe/Rome");
+
+  // Seme di config.json: riscritto solo se cambia
+  TEST_ASSERT_TRUE(ConfigCache::setJsonSeed(0x1234));
+  TEST_ASSERT_EQUAL_UINT32(0x1234, ConfigCache::jsonSeed());
+
+  ConfigCache::invalidate();
+  TEST_ASSERT_FALSE(ConfigCache::restore(back, true, src));
+  TEST_ASSERT_FALSE(ConfigCache::restoreFlash(back));
+
+  // config.json con una stringa oltre il limite: solo quel campo torna al
+  // default, il resto resta; la cache lo accetta e il seme viene registrato
+  String longPass;
+  for (int i = 0; i < 300; i++) longPass += 'x';
+  Config seeded = getDefaultConfig();
+  seeded.wifi_ssid = "orto";
+  seeded.mqtt_broker = "broker.lan";
+  seeded.mqtt_password = longPass;
+  seeded.pump_pin = 13;
+  seeded.moisture_threshold = 33;
+  seeded.ota_manifest_url = "https://updates.example.com/bonsai/manifest.json";
+  {
+    auto f = FS_IMPL.open(CONFIG_PATH, "w");
+    f.print(configToJson(seeded));
+    f.close();
+  }
+  back = getDefaultConfig();
+  TEST_ASSERT_TRUE(loadConfig(back, &src));
+  TEST_ASSERT_TRUE(src == ConfigSource::Json);
+  TEST_ASSERT_TRUE(back.mqtt_password == "");
+  TEST_ASSERT_TRUE(back.mqtt_broker == "broker.lan");
+  TEST_ASSERT_TRUE(back.wifi_ssid == "orto");
+  TEST_ASSERT_TRUE(back.ota_manifest_url == seeded.ota_manifest_url);
+  TEST_ASSERT_EQUAL(13, back.pump_pin);
+  TEST_ASSERT_EQUAL(33, back.moisture_threshold);
+  back = getDefaultConfig();
+  TEST_ASSERT_TRUE(loadConfig(back, &src));
+  TEST_ASSERT_TRUE(src == ConfigCache::flashSource());
+  TEST_ASSERT_EQUAL(13, back.pump_pin);
+  FS_IMPL.remove(CONFIG_PATH);
+
+  TEST_ASSERT_TRUE(ConfigCache::pack(c, img));
+  benchRun("ConfigCache::unpack", ITER, [&] { ConfigCache::unpack(img, back); });
+}
+
+static void bench_recordStore()
+{
+  // 4 settori: testa, riserva per la compattazione e due di storia
+  native::FlashPartition& fp = native::addPartition("kvtest", 4 * RecordStore::SECTOR);
+  RecordStore st(&fp.part);
+  TEST_ASSERT_TRUE(st.begin());
+  TEST_ASSERT_EQUAL(3, st.freeSectors());
+
+  uint32_t a = 1, b = 2;
+  TEST_ASSERT_TRUE(st.put(3, &a, sizeof(a)));
+  TEST_ASSERT_TRUE(st.put(3, &b, sizeof(b)));
+  uint32_t out = 0;
+  TEST_ASSERT_EQUAL(4, st.get(3, &out, sizeof(out)));
+  TEST_ASSERT_EQUAL_UINT32(2, out);
+  TEST_ASSERT_EQUAL_UINT32(2, st.version(3));
+  TEST_ASSERT_EQUAL(-1, st.get(4, &out, sizeof(out)));
+  TEST_ASSERT_EQUAL(-1, st.get(3, &out, 2));
+
+  // Riavvio: l'indice si ricostruisce dalla flash
+  RecordStore re(&fp.part);
+  TEST_ASSERT_TRUE(re.begin());
+  TEST_ASSERT_EQUAL(4, re.get(3, &out, sizeof(out)));
+  TEST_ASSERT_EQUAL_UINT32(2, out);
+
+  // Scrittura interrotta sull'ultimo record: vale la versione prima
+  const uint32_t c = 3;
+  TEST_ASSERT_TRUE(re.put(3, &c, sizeof(c)));
+  const size_t lastData = 8 + 2 * 16 + 12;   // header settore, due record, header
+  fp.data[lastData] = 0;
+  RecordStore torn(&fp.part);
+  TEST_ASSERT_TRUE(torn.begin());
+  TEST_ASSERT_EQUAL(1, torn.stats().corrupt);
+  TEST_ASSERT_EQUAL(4, torn.get(3, &out, sizeof(out)));
+  TEST_ASSERT_EQUAL_UINT32(2, out);
+
+  // Molti salvataggi: il tail si compatta e i dati attuali sopravvivono
+  static uint8_t blob[900];
+  memset(blob, 0xA5, sizeof(blob));
+  TEST_ASSERT_TRUE(torn.put(5, blob, sizeof(blob)));
+  for (uint32_t i = 0; i < 200; i++) {
+    blob[0] = (uint8_t)i;
+    TEST_ASSERT_TRUE(torn.put(7, blob, sizeof(blob)));
+  }
+  const RecordStoreStats s = torn.stats();
+  TEST_ASSERT_TRUE(s.compactions > 0);
+  TEST_ASSERT_TRUE(torn.freeSectors() >= RecordStore::RESERVE_SECTORS);
+  TEST_ASSERT_EQUAL(4, torn.get(3, &out, sizeof(out)));
+  TEST_ASSERT_EQUAL_UINT32(2, out);
+  uint8_t back[900];
+  TEST_ASSERT_EQUAL(900, torn.get(5, back, sizeof(back)));
+  TEST_ASSERT_EQUAL(0xA5, back[0]);
+  TEST_ASSERT_EQUAL(900, torn.get(7, back, sizeof(back)));
+  TEST_ASSERT_EQUAL(199, back[0]);
+
+  // Cancellazioni distribuite su tutti i settori
+  TEST_ASSERT_TRUE(fp.erases >= 4 * 10);
+
+  // Tombstone: sopravvive a compattazione e riavvio
+  TEST_ASSERT_TRUE(torn.remove(5));
+  TEST_ASSERT_FALSE(torn.has(5));
+  while (torn.maintain(4)) {}
+  RecordStore after(&fp.part);
+  TEST_ASSERT_TRUE(after.begin());
+  TEST_ASSERT_FALSE(after.has(5));
+  TEST_ASSERT_EQUAL(900, after.get(7, back, sizeof(back)));
+  TEST_ASSERT_EQUAL(199, back[0]);
+
+  benchRun("RecordStore::put", 1000, [&] { after.put(9, &c, sizeof(c)); });
+  benchRun("RecordStore::get", ITER, [&] { after.get(7, back, sizeof(back)); });
+}
+
+static HistoryRecord historySample(uint32_t t, uint8_t soil)
+{
+  HistoryRecord r = {};
+  r.t = t;
+  r.kind = (uint8_t)HistoryKind::Sample;
+  r.soilPct = soil;
+  r.batteryMv = 3000;
+  r.rssi = -60;
+  return r;
+}
+
+static String historyText(HistoryStream& s, size_t chunk)
+{
+  String out;
+  uint8_t buf[512];
+  size_t n;
+  while ((n = s.fill(buf, chunk)) > 0) out.concat((const char*)buf, (unsigned)n);
+  return out;
+}
+
+static void bench_historyStore()
+{
+  // 4 settori da 255 record: il quinto settore sovrascrive il primo
+  native::FlashPartition& fp = native::addPartition("histtest", 4 * HistoryStore::SECTOR);
+  HistoryStore h(&fp.part);
+  TEST_ASSERT_TRUE(h.begin());
+  TEST_ASSERT_EQUAL_UINT32(h.first(), h.end());
+
+  // Un campione al minuto per 10 ore, pompa 5 s ogni ora
+  const uint32_t T0 = 1700000000UL;
+  for (uint32_t i = 0; i < 600; i++) {
+    TEST_ASSERT_TRUE(h.append(historySample(T0 + i * 60, (uint8_t)(i % 60))));
+    if (i % 60 == 59) {
+      HistoryRecord p = {};
+      p.t = T0 + i * 60;
+      p.kind = (uint8_t)HistoryKind::Pump;
+      p.soilPct = HISTORY_NONE;
+      p.pumpS = 5;
+      TEST_ASSERT_TRUE(h.append(p));
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(610, h.end() - h.first());
+
+  // Bisezione per tempo, anche a cavallo dei blocchi
+  HistoryRecord r;
+  TEST_ASSERT_EQUAL_UINT32(h.first(), h.lowerBound(0));
+  TEST_ASSERT_EQUAL_UINT32(h.end(), h.lowerBound(T0 + 600 * 60));
+  const uint32_t seq = h.lowerBound(T0 + 300 * 60 - 30);
+  TEST_ASSERT_EQUAL(1, h.read(seq, &r, 1));
+  TEST_ASSERT_TRUE(HistoryStore::valid(r));
+  TEST_ASSERT_EQUAL_UINT32(T0 + 300 * 60, r.t);
+
+  // Riavvio: indice dei blocchi e coda ricostruiti dalla flash
+  HistoryStore re(&fp.part);
+  TEST_ASSERT_TRUE(re.begin());
+  TEST_ASSERT_EQUAL_UINT32(h.end(), re.end());
+  TEST_ASSERT_EQUAL_UINT32(T0 + 599 * 60, re.lastTime());
+  TEST_ASSERT_EQUAL_UINT32(seq, re.lowerBound(T0 + 300 * 60 - 30));
+
+  // Prima ora a intervalli di 10 minuti: 6 punti, pompa nell'ultimo
+  HistoryStream q(re, T0, T0 + 3599, 600);
+  const String json = historyText(q, 512);
+  TEST_ASSERT_TRUE(json.startsWith("{\"from\":1700000000,\"to\":1700003599,\"step\":600,\"points\":[[1700000000,4,3000,-60,0],"));
+  TEST_ASSERT_TRUE(json.endsWith(",[1700003000,54,3000,-60,5]]}"));
+
+  // Chunk minuscoli: stesso testo, nessun punto troncato
+  HistoryStream q7(re, T0, T0 + 3599, 600);
+  TEST_ASSERT_TRUE(historyText(q7, 7) == json);
+
+  // Intervallo vuoto e step automatico entro MAX_POINTS
+  HistoryStream none(re, T0 - 1000, T0 - 1, 60);
+  TEST_ASSERT_TRUE(historyText(none, 512) == "{\"from\":1699999000,\"to\":1699999999,\"step\":60,\"points\":[]}");
+  HistoryStream wide(re, 0, 2000000000UL, 0);
+  TEST_ASSERT_TRUE(2000000000UL / wide.step() < HistoryStream::MAX_POINTS);
+
+  // Orologio all'indietro: t portato all'ultimo, l'ordine resta
+  TEST_ASSERT_TRUE(re.append(historySample(T0, 10)));
+  TEST_ASSERT_EQUAL_UINT32(T0 + 599 * 60, re.lastTime());
+
+  // Buffer circolare: i record più vecchi cedono il posto, la ricerca parte dal primo rimasto
+  for (uint32_t i = 600; i < 1400; i++) TEST_ASSERT_TRUE(re.append(historySample(T0 + i * 60, 50)));
+  TEST_ASSERT_TRUE(re.end() - re.first() <= 4 * HistoryStore::RECORDS_PER_SECTOR);
+  TEST_ASSERT_TRUE(re.end() - re.first() > 3 * HistoryStore::RECORDS_PER_SECTOR);
+  TEST_ASSERT_EQUAL_UINT32(re.first(), re.lowerBound(T0));
+  TEST_ASSERT_EQUAL(1, re.read(re.first(), &r, 1));
+  TEST_ASSERT_TRUE(r.t > T0);
+
+  uint32_t sink = 0;
+  benchRun("HistoryStore::lowerBound", ITER, [&] { sink += re.lowerBound(T0 + 1000 * 60); });
+  uint8_t buf[1436];
+  benchRun("HistoryStream 1 day", 1000, [&] {
+    HistoryStream day(re, T0 + 1400 * 60 - 86400, T0 + 1400 * 60, 0);
+    while (size_t n = day.fill(buf, sizeof(buf))) sink += n;
+  });
+  TEST_ASSERT_TRUE(sink > 0);
+}
+
+// ------------------------------------------------------------------
+// MQTT
+// ------------------------------------------------------------------
+
+static void bench_publishConfigSnapshot()
+{
+  const unsigned before = mqttClient.publishCount;
+  publishConfigSnapshot();
+  TEST_ASSERT_TRUE(mqttFlush(100));  // publishMqtt accoda, il worker invia
+  TEST_ASSERT_EQUAL(before + 1, mqttClient.publishCount);
+  TEST_ASSERT_TRUE(mqttClient.lastRetained);
+  TEST_ASSERT_TRUE(strstr(mqttClient.lastPayload, "\"device_id\"") != nullptr);
+  TEST_ASSERT_TRUE(strstr(mqttClient.lastPayload, "\"led_pin\"") != nullptr);
+  TEST_ASSERT_TRUE(strstr(mqttClient.lastPayload, "\"webserver_timeout\"") != nullptr);
+
+  benchRun("publishConfigSnapshot", ITER, [] { publishConfigSnapshot(); mqttFlush(100); });
+}
+
+static void bench_mqttCallback_pump()
+{
+  PumpController pump(config.pump_pin, 60000);
+  pump.begin();
+  pumpController = &pump;
+
+  String topic = "bonsai/" + deviceId + "/command/pump";
+  char t[96];
+  snprintf(t, sizeof(t), "%s", topic.c_str());
+  byte on[] = {'o', 'n'};
+  byte off[] = {'o', 'f', 'f'};
+
+  mqttCallback(t, on, sizeof(on));
+  TEST_ASSERT_TRUE(pump.getState());
+  mqttCallback(t, off, sizeof(off));
+  TEST_ASSERT_FALSE(pump.getState());
+
+  bool flip = false;
+  benchRun("mqttCallback(command/pump)", ITER, [&] {
+    flip = !flip;
+    if (flip) mqttCallback(t, on, sizeof(on));
+    else      mqttCallback(t, off, sizeof(off));
+  });
+
+  pumpController = nullptr;
+}
+
+static void bench_mqttCallback_json_pump()
+{
+  PumpController pump(config.pump_pin, 60000);
+  pump.begin();
+  pumpController = &pump;
+
+  String topic = "bonsai/" + deviceId + "/command/pump";
+  char t[96];
+  snprintf(t, sizeof(t), "%s", topic.c_str());
+  static const char onJson[] = "{\"pump\":\"on\"}";
+
+  mqttCallback(t, (byte*)onJson, sizeof(onJson) - 1);
+  TEST_ASSERT_TRUE(pump.getState());
+
+  benchRun("mqttCallback(json pump)", ITER, [&] {
+    pump.turnOff();
+    mqttCallback(t, (byte*)onJson, sizeof(onJson) - 1);
+  });
+
+  pumpController = nullptr;
+}
+
+static void bench_connectMqtt_session()
+{
+  config.mqtt_persistent_session = true;
+  mqttClient.disconnect();
+
+  // Primo connect: sessione persistente, subscribe QoS 1 e snapshot
+  unsigned subs = mqttClient.subscribeCount;
+  TEST_ASSERT_TRUE(connectMqtt());
+  TEST_ASSERT_FALSE(mqttClient.lastCleanSession);
+  TEST_ASSERT_EQUAL(subs + MqttRouter::subscriptionCount(), mqttClient.subscribeCount);
+
+  // Wake successivo: stessa sessione, nessun subscribe
+  mqttClient.disconnect();
+  subs = mqttClient.subscribeCount;
+  TEST_ASSERT_TRUE(connectMqtt());
+  TEST_ASSERT_EQUAL(subs, mqttClient.subscribeCount);
+
+  // Sessione pulita: si sottoscrive sempre
+  config.mqtt_persistent_session = false;
+  mqttClient.disconnect();
+  TEST_ASSERT_TRUE(connectMqtt());
+  TEST_ASSERT_TRUE(mqttClient.lastCleanSession);
+  TEST_ASSERT_EQUAL(subs + MqttRouter::subscriptionCount(), mqttClient.subscribeCount);
+
+  // Reboot via MQTT: niente riavvio nel callback, lo fa il worker dopo
+  // mqttClient.loop() (PUBACK già scritto) e con la coda svuotata
+  setupMqtt();
+  TEST_ASSERT_TRUE(mqttFlush(100));
+  char reboot[96];
+  snprintf(reboot, sizeof(reboot), "bonsai/%s/command/reboot", deviceId.c_str());
+  byte none[] = {0};
+  const unsigned restarts = native::restartCount;
+  mqttCallback(reboot, none, 0);
+  TEST_ASSERT_EQUAL(restarts, native::restartCount);
+  mqttWorkerStep();
+  TEST_ASSERT_EQUAL(restarts + 1, native::restartCount);
+  TEST_ASSERT_FALSE(mqttClient.connected());
+  mqttWorkerStep();
+  TEST_ASSERT_EQUAL(restarts + 1, native::restartCount);
+
+  config.mqtt_persistent_session = true;
+  benchRun("connectMqtt(resumed)", ITER / 10, [] { mqttClient.disconnect(); connectMqtt(); });
+}
+
+static void bench_mqttRoute()
+{
+  const String own = "bonsai/" + deviceId;
+  TEST_ASSERT_EQUAL((int)MqttRoute::Pump, (int)MqttRouter::route((own + "/command/pump").c_str()));
+  TEST_ASSERT_EQUAL((int)MqttRoute::Reboot, (int)MqttRouter::route((own + "/command/restart").c_str()));
+  TEST_ASSERT_EQUAL((int)MqttRoute::Ota, (int)MqttRouter::route(("bonsai/ota/force/" + deviceId).c_str()));
+  TEST_ASSERT_EQUAL((int)MqttRoute::ConfigSet, (int)MqttRouter::route("bonsai/config/set"));
+  TEST_ASSERT_EQUAL((int)MqttRoute::ConfigLegacy, (int)MqttRouter::route(("bonsai/config/" + deviceId).c_str()));
+  TEST_ASSERT_EQUAL((int)MqttRoute::None, (int)MqttRouter::route((own + "/command/pumps").c_str()));
+  TEST_ASSERT_EQUAL((int)MqttRoute::None, (int)MqttRouter::route("bonsai/other-device/command/pump"));
+  TEST_ASSERT_EQUAL(9, MqttRouter::subscriptionCount());
+
+  char t[96];
+  snprintf(t, sizeof(t), "%s/command/ota", own.c_str());
+  benchRun("MqttRouter::route", ITER * 10, [&] { MqttRouter::route(t); });
+}
+
+static void bench_mqttCallback_unmatched()
+{
+  // Caso peggiore: nessun match, passa anche da handleMqttConfigCommands
+  char t[] = "bonsai/other-device/status/humidity";
+  byte payload[] = {'4', '2'};
+  const unsigned restarts = native::restartCount;
+
+  benchRun("mqttCallback(unmatched)", ITER, [&] { mqttCallback(t, payload, sizeof(payload)); });
+  TEST_ASSERT_EQUAL(restarts, native::restartCount);
+}
+
+static void bench_publishStatus_text()
+{
+  config.telemetry_binary = false;
+  ReportPolicy::reset();
+  const unsigned before = mqttClient.publishCount;
+  publishStatus();
+  TEST_ASSERT_TRUE(mqttFlush(100));
+  TEST_ASSERT_TRUE(mqttClient.publishCount - before >= 5);
+
+  // Valori fermi: nessun publish finché non scade l'heartbeat
+  const unsigned steady = mqttClient.publishCount;
+  benchRun("publishStatus(text, steady)", ITER, [] { publishStatus(); mqttFlush(100); });
+  TEST_ASSERT_EQUAL(steady, mqttClient.publishCount);
+
+  config.report_heartbeat_s = 0;  // politica disattivata: comportamento storico
+  benchRun("publishStatus(text, no policy)", ITER, [] { publishStatus(); mqttFlush(100); });
+  config = getDefaultConfig();
+  jsonToConfig(SAMPLE_CONFIG_JSON, config);
+}
+
+static void bench_publishStatus_binary()
+{
+  config.telemetry_binary = true;
+  soilValue = 2110;
+  soilPercent = 48;
+  ReportPolicy::reset();
+  const unsigned before = mqttClient.publishCount;
+  publishStatus();
+  TEST_ASSERT_TRUE(mqttFlush(100));
+  // Frame + contatori di coda MQTT e task di controllo (heartbeat, subito dopo il reset)
+  TEST_ASSERT_EQUAL(before + 3, mqttClient.publishCount);
+  TEST_ASSERT_EQUAL(TELEMETRY_FRAME_V1_LEN, mqttClient.lastPayloadLen);
+  TEST_ASSERT_TRUE(strstr(mqttClient.lastTopic, "/telemetry") != nullptr);
+
+  TelemetryFrame f;
+  TEST_ASSERT_TRUE(decodeTelemetryFrame((const uint8_t*)mqttClient.lastPayload, mqttClient.lastPayloadLen, f));
+  TEST_ASSERT_EQUAL(48, f.soilPct);
+  TEST_ASSERT_EQUAL(2110, f.soilRaw);
+
+  benchRun("publishStatus(binary)", ITER, [] { publishStatus(); mqttFlush(100); });
+  config.telemetry_binary = false;
+}
+
+static void bench_reportPolicy()
+{
+  Config c = getDefaultConfig();
+  c.report_heartbeat_s = 60;
+  c.report_deadband_humidity = 3;
+  ReportPolicy::reset();
+
+  TEST_ASSERT_TRUE(ReportPolicy::due(c, StatusMetric::Humidity, 40, 1000));
+  ReportPolicy::reported(StatusMetric::Humidity, 40, 1000);
+  TEST_ASSERT_FALSE(ReportPolicy::due(c, StatusMetric::Humidity, 42, 2000));
+  TEST_ASSERT_TRUE(ReportPolicy::due(c, StatusMetric::Humidity, 37, 2000));
+  TEST_ASSERT_TRUE(ReportPolicy::due(c, StatusMetric::Humidity, 40, 61000));
+
+  // Solo heartbeat e qualunque variazione
+  ReportPolicy::reported(StatusMetric::LastSeen, 0, 1000);
+  TEST_ASSERT_FALSE(ReportPolicy::due(c, StatusMetric::LastSeen, 0, 60999));
+  ReportPolicy::reported(StatusMetric::Pump, 0, 1000);
+  TEST_ASSERT_TRUE(ReportPolicy::due(c, StatusMetric::Pump, 1, 1001));
+
+  c.report_heartbeat_s = 0;
+  TEST_ASSERT_TRUE(ReportPolicy::due(c, StatusMetric::Humidity, 40, 2000));
+  c.report_heartbeat_s = 60;
+
+  unsigned long t = 2000;
+  bool sink = false;
+  benchRun("ReportPolicy::due", ITER * 10, [&] { sink ^= ReportPolicy::due(c, StatusMetric::Humidity, 41, ++t); });
+  (void)sink;
+}
+
+static void bench_mqttQueue()
+{
+  static uint8_t arena[256];
+  static uint8_t buf[256];
+  MqttQueue q(arena, sizeof(arena));
+  MqttMessage m;
+  const uint8_t payload[100] = {};
+
+  // Coalesce: due retained sullo stesso topic → resta solo l'ultimo
+  TEST_ASSERT_TRUE(q.push("a/pump", (const uint8_t*)"on", 2, true));
+  TEST_ASSERT_TRUE(q.push("a/pump", (const uint8_t*)"off", 3, true));
+  TEST_ASSERT_EQUAL(1, q.depth());
+  TEST_ASSERT_TRUE(q.pop(m, buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL(3, m.len);
+  TEST_ASSERT_EQUAL_MEMORY("off", buf, 3);
+  TEST_ASSERT_FALSE(q.pop(m, buf, sizeof(buf)));
+
+  // Drop-oldest: l'arena da 256 B tiene due payload da 100, il terzo scarta il primo
+  TEST_ASSERT_TRUE(q.push("a/1", payload, 100, false));
+  TEST_ASSERT_TRUE(q.push("a/2", payload, 100, false));
+  TEST_ASSERT_TRUE(q.push("a/3", payload, 100, false));
+  TEST_ASSERT_EQUAL(2, q.depth());
+  TEST_ASSERT_TRUE(q.pop(m, buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL_STRING("a/2", m.topic);
+  TEST_ASSERT_TRUE(q.pop(m, buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL_STRING("a/3", m.topic);
+
+  // Troppo grande per l'arena: rifiutato
+  TEST_ASSERT_FALSE(q.push("a/big", payload, 300, false));
+
+  MqttQueueStats st = q.stats();
+  TEST_ASSERT_EQUAL(1, st.coalesced);
+  TEST_ASSERT_EQUAL(2, st.dropped);
+  TEST_ASSERT_EQUAL(0, st.depth);
+
+  benchRun("MqttQueue push+pop(100B)", ITER * 10, [&] {
+    q.push("bonsai/x/status/humidity", payload, 100, false);
+    q.pop(m, buf, sizeof(buf));
+  });
+}
+
+static void bench_spscQueue()
+{
+  SpscQueue<uint32_t, 8> q;
+  uint32_t v = 0;
+
+  TEST_ASSERT_FALSE(q.pop(v));
+  for (uint32_t i = 0; i < q.CAPACITY; i++) TEST_ASSERT_TRUE(q.push(i));
+  TEST_ASSERT_FALSE(q.push(99));   // piena: N-1 elementi
+  for (uint32_t i = 0; i < q.CAPACITY; i++) {
+    TEST_ASSERT_TRUE(q.pop(v));
+    TEST_ASSERT_EQUAL(i, v);
+  }
+  TEST_ASSERT_TRUE(q.empty());
+
+  // Due thread veri: ordine FIFO e nessuna perdita senza lock
+  static SpscQueue<uint32_t, 16> xq;
+  const uint32_t N = 200000;
+  std::thread producer([&] {
+    for (uint32_t i = 0; i < N; i++)
+      while (!xq.push(i)) std::this_thread::yield();
+  });
+  uint32_t expected = 0;
+  bool inOrder = true;
+  while (expected < N) {
+    if (!xq.pop(v)) { std::this_thread::yield(); continue; }
+    inOrder = inOrder && v == expected;
+    expected++;
+  }
+  producer.join();
+  TEST_ASSERT_TRUE(inOrder);
+
+  // Comando pompa dal lato rete: applicato dal controllo, stato ed evento visibili
+  PumpController pump(config.pump_pin, 60000);
+  pump.begin();
+  pumpController = &pump;
+  ControlEvent ev;
+  while (ControlTask::pollEvent(ev)) {}
+  TEST_ASSERT_TRUE(ControlTask::send(ControlCmd::PumpOn));
+  TEST_ASSERT_TRUE(ControlTask::synced());
+  TEST_ASSERT_TRUE(ControlTask::pumpOn());
+  TEST_ASSERT_TRUE(ControlTask::pollEvent(ev));
+  TEST_ASSERT_TRUE(ev.type == ControlEventType::PumpOn);
+  ControlTask::send(ControlCmd::PumpOff);
+  TEST_ASSERT_FALSE(ControlTask::pumpOn());
+  pumpController = nullptr;
+
+  benchRun("SpscQueue push+pop", ITER * 10, [&] { q.push(1); q.pop(v); });
+}
+
+static void bench_pumpCutoff()
+{
+  // Scatto del timer hardware simulato con cutoff() oltre maxRunMs: pin
+  // spento subito, stato ed emergency allineati dal loop() successivo
+  PumpController pump(config.pump_pin, 20);
+  pump.begin();
+  static int fired;
+  fired = 0;
+  pump.setCutoffListener([](void*) { fired++; }, nullptr);
+  TEST_ASSERT_TRUE(pump.turnOn());
+  TEST_ASSERT_EQUAL(PUMP_ON, digitalRead(config.pump_pin));
+  pump.cutoff();   // prima della scadenza: callback di un'accensione precedente
+  TEST_ASSERT_EQUAL(PUMP_ON, digitalRead(config.pump_pin));
+  TEST_ASSERT_FALSE(pump.cutoffPending());
+  delay(25);
+  pump.cutoff();
+  TEST_ASSERT_EQUAL(PUMP_OFF, digitalRead(config.pump_pin));
+  TEST_ASSERT_EQUAL(1, fired);
+  TEST_ASSERT_TRUE(pump.cutoffPending());
+  pump.loop();
+  TEST_ASSERT_FALSE(pump.getState());
+  TEST_ASSERT_TRUE(pump.isEmergencyStop());
+  TEST_ASSERT_FALSE(pump.cutoffPending());
+  TEST_ASSERT_FALSE(pump.turnOn());
+
+  // Scatto in coda dopo turnOff(): disarmato, niente emergency
+  pump.clearEmergencyStop();
+  TEST_ASSERT_TRUE(pump.turnOn());
+  delay(25);
+  TEST_ASSERT_TRUE(pump.turnOff());
+  pump.cutoff();
+  pump.loop();
+  TEST_ASSERT_FALSE(pump.isEmergencyStop());
+  TEST_ASSERT_EQUAL(1, fired);
+
+  // ... e dopo una riaccensione: la pompa nuova resta accesa
+  TEST_ASSERT_TRUE(pump.turnOn());
+  pump.cutoff();
+  TEST_ASSERT_EQUAL(PUMP_ON, digitalRead(config.pump_pin));
+  TEST_ASSERT_FALSE(pump.cutoffPending());
+  TEST_ASSERT_TRUE(pump.turnOff());
+
+  // Dal task di controllo: emergencyStop() visibile già dal contesto del timer
+  pumpController = &pump;
+  ControlTask::begin();
+  ControlEvent ev;
+  while (ControlTask::pollEvent(ev)) {}
+  ControlTask::send(ControlCmd::PumpOn);
+  TEST_ASSERT_TRUE(ControlTask::pumpOn());
+  delay(25);
+  pump.cutoff();
+  TEST_ASSERT_TRUE(ControlTask::emergencyStop());
+  TEST_ASSERT_FALSE(ControlTask::pumpOn());
+  ControlTask::step();
+  bool stopped = false;
+  while (ControlTask::pollEvent(ev)) stopped = stopped || ev.type == ControlEventType::EmergencyStop;
+  TEST_ASSERT_TRUE(stopped);
+  pump.clearEmergencyStop();
+  ControlTask::step();
+  TEST_ASSERT_FALSE(ControlTask::emergencyStop());
+  pump.setCutoffListener(nullptr, nullptr);
+  pumpController = nullptr;
+
+  benchRun("PumpController turnOn+turnOff", ITER, [&] { pump.turnOn(); pump.turnOff(); });
+}
+
+static void bench_irrigation()
+{
+  PumpController pump(config.pump_pin, 60000);
+  pump.begin();
+  IrrigationController irr(&pump);
+  // Impulsi da 3 s, soak 10 s, budget 9 s, obiettivo 40 %
+  IrrigationParams p = { 3000, 10000, 9000, 40, IRRIGATION_MAX_CYCLES };
+  TEST_ASSERT_EQUAL(9000 + 2 * (10000 + IrrigationController::MEASURE_ALLOWANCE_MS),
+                    IrrigationController::maxDurationMs(p));
+
+  // Obiettivo raggiunto al secondo impulso
+  TEST_ASSERT_TRUE(irr.start(p, 20, 0));
+  TEST_ASSERT_TRUE(pump.getState());
+  TEST_ASSERT_FALSE(irr.loop(2999));
+  TEST_ASSERT_TRUE(pump.getState());
+  TEST_ASSERT_FALSE(irr.loop(3000));
+  TEST_ASSERT_FALSE(pump.getState());
+  TEST_ASSERT_TRUE(irr.phase() == IrrigationPhase::Soak);
+  TEST_ASSERT_FALSE(irr.loop(12999));
+  TEST_ASSERT_TRUE(irr.loop(13000));          // serve una misura
+  irr.onSoilSample(30, 13010);
+  TEST_ASSERT_TRUE(pump.getState());
+  irr.loop(16010);
+  TEST_ASSERT_TRUE(irr.loop(26010));
+  irr.onSoilSample(42, 26020);
+  TEST_ASSERT_FALSE(irr.active());
+  TEST_ASSERT_FALSE(pump.getState());
+  TEST_ASSERT_TRUE(irr.takeFinished());
+  TEST_ASSERT_FALSE(irr.takeFinished());
+
+  static char out[IrrigationController::MAX_STATS_JSON];
+  TEST_ASSERT_TRUE(IrrigationController::formatStats(irr.stats(), out, sizeof(out)) > 0);
+  TEST_ASSERT_EQUAL_STRING("{\"result\":\"target\",\"cycles\":2,\"pump_ms\":6000,\"total_ms\":26020,"
+                           "\"start\":20,\"end\":42,\"c\":[[3000,30],[3000,42]]}", out);
+
+  // Il suolo non risponde: budget finito, l'ultimo impulso chiude senza soak
+  TEST_ASSERT_TRUE(irr.start(p, 20, 0));
+  irr.loop(3000);
+  TEST_ASSERT_TRUE(irr.loop(13000));
+  irr.onSoilSample(21, 13000);
+  irr.loop(16000);
+  TEST_ASSERT_TRUE(irr.loop(26000));
+  irr.onSoilSample(22, 26000);
+  irr.loop(29000);
+  TEST_ASSERT_FALSE(irr.active());
+  TEST_ASSERT_FALSE(pump.getState());
+  TEST_ASSERT_TRUE(irr.stats().result == IrrigationResult::Budget);
+  TEST_ASSERT_EQUAL(3, irr.stats().cycles);
+  TEST_ASSERT_EQUAL(9000, irr.stats().pumpMs);
+  TEST_ASSERT_EQUAL(-1, irr.stats().cyclePct[2]);
+
+  // Comando manuale a metà impulso
+  TEST_ASSERT_TRUE(irr.start(p, 20, 0));
+  irr.abort(1500);
+  TEST_ASSERT_FALSE(pump.getState());
+  TEST_ASSERT_TRUE(irr.stats().result == IrrigationResult::Aborted);
+  TEST_ASSERT_EQUAL(1500, irr.stats().pumpMs);
+
+  // Già all'obiettivo: nessuna sessione
+  TEST_ASSERT_FALSE(irr.start(p, 45, 0));
+  TEST_ASSERT_TRUE(irr.stats().result == IrrigationResult::None);
+  TEST_ASSERT_FALSE(pump.getState());
+
+  // Caso peggiore del JSON
+  IrrigationStats worst = {};
+  worst.result = IrrigationResult::PumpFailed;
+  worst.cycles = IRRIGATION_MAX_CYCLES;
+  worst.pumpMs = worst.totalMs = UINT32_MAX;
+  worst.startPct = worst.endPct = -1;
+  for (uint8_t i = 0; i < IRRIGATION_MAX_CYCLES; i++) {
+    worst.cyclePumpMs[i] = UINT32_MAX;
+    worst.cyclePct[i] = -1;
+  }
+  TEST_ASSERT_TRUE(IrrigationController::formatStats(worst, out, sizeof(out)) > 0);
+
+  // Dal task di controllo: Irrigate avvia la sessione, PumpOff la chiude con le statistiche
+  const Config saved = config;
+  config.pump_duration = 5;
+  config.irrigation_pulse_s = 0;
+  config.irrigation_soak_s = 30;
+  config.irrigation_target = 0;
+  config.moisture_threshold = 25;
+  pumpController = &pump;
+  ControlEvent ev;
+  while (ControlTask::pollEvent(ev)) {}
+  TEST_ASSERT_TRUE(ControlTask::send(ControlCmd::Irrigate));
+  TEST_ASSERT_TRUE(ControlTask::irrigating());
+  TEST_ASSERT_TRUE(ControlTask::pumpOn());
+  ControlTask::send(ControlCmd::PumpOff);
+  TEST_ASSERT_FALSE(ControlTask::irrigating());
+  bool done = false;
+  while (ControlTask::pollEvent(ev)) done = done || ev.type == ControlEventType::IrrigationDone;
+  TEST_ASSERT_TRUE(done);
+  TEST_ASSERT_TRUE(ControlTask::irrigationStats().result == IrrigationResult::Aborted);
+  pumpController = nullptr;
+  config = saved;
+
+  benchRun("IrrigationController::formatStats", ITER, [&] {
+    IrrigationController::formatStats(worst, out, sizeof(out));
+  });
+}
+
+static void bench_telemetryFrame()
+{
+  TelemetryFrame in = {};
+  in.flags = TELEMETRY_BIT_PUMP_ON | TELEMETRY_BIT_TIME_VALID;
+  in.ts = 1760000000UL;
+  in.rssi = -67;
+  in.soilPct = 42;
+  in.soilRaw = 2375;
+  in.battery = 3012;
+  in.tempC10 = -15;
+
+  uint8_t buf[TELEMETRY_FRAME_V1_LEN];
+  TEST_ASSERT_EQUAL(0, encodeTelemetryFrame(in, buf, sizeof(buf) - 1));
+  TEST_ASSERT_EQUAL(TELEMETRY_FRAME_V1_LEN, encodeTelemetryFrame(in, buf, sizeof(buf)));
+
+  TelemetryFrame out;
+  TEST_ASSERT_TRUE(decodeTelemetryFrame(buf, sizeof(buf), out));
+  TEST_ASSERT_EQUAL(in.ts, out.ts);
+  TEST_ASSERT_EQUAL(in.rssi, out.rssi);
+  TEST_ASSERT_EQUAL(in.soilRaw, out.soilRaw);
+  TEST_ASSERT_EQUAL(in.battery, out.battery);
+  TEST_ASSERT_EQUAL(in.tempC10, out.tempC10);
+  buf[0] = 99;
+  TEST_ASSERT_FALSE(decodeTelemetryFrame(buf, sizeof(buf), out));
+
+  benchRun("encodeTelemetryFrame", ITER * 10, [&] { encodeTelemetryFrame(in, buf, sizeof(buf)); });
+}
+
+// ------------------------------------------------------------------
+// OTA / sensore
+// ------------------------------------------------------------------
+
+static void bench_compareVersions()
+{
+  const String a("v1.4.10");
+  const String b("v1.4.11");
+  TEST_ASSERT_EQUAL(-1, FirmwareUpdateStrategy::compareVersions_(a, b));
+  TEST_ASSERT_EQUAL(1, FirmwareUpdateStrategy::compareVersions_(b, a));
+  TEST_ASSERT_EQUAL(0, FirmwareUpdateStrategy::compareVersions_(a, a));
+
+  int sink = 0;
+  benchRun("compareVersions_", ITER * 10, [&] { sink += FirmwareUpdateStrategy::compareVersions_(a, b); });
+  TEST_ASSERT_TRUE(sink < 0);
+}
+
+static void bench_soilFilter()
+{
+  int s[5] = {2100, 4095, 2110, 0, 2120};
+  TEST_ASSERT_EQUAL(2110, soilFilterSamples(s, 5));
+  TEST_ASSERT_EQUAL(0, soilRawToPercent(4095));
+  TEST_ASSERT_EQUAL(100, soilRawToPercent(0));
+
+  // Soglia ULP sul grezzo: il più secco che vale ancora `p`, uno in più è sotto
+  for (int p = 1; p <= 100; p++) {
+    const int raw = soilPercentToRaw(p);
+    TEST_ASSERT_TRUE(soilRawToPercent(raw) >= p);
+    TEST_ASSERT_TRUE(soilRawToPercent(raw + 1) < p);
+  }
+  TEST_ASSERT_EQUAL(4095, soilPercentToRaw(0));
+
+  int sink = 0;
+  benchRun("soilFilterSamples(5)", ITER * 10, [&] {
+    int v[5] = {2100, 4095, 2110, 0, 2120};
+    sink += soilRawToPercent(soilFilterSamples(v, 5));
+  });
+  TEST_ASSERT_TRUE(sink > 0);
+}
+
+// Traccia di riferimento del sensore capacitivo: rumore ±6 LSB attorno a ~2049
+// e i glitch tipici (saturazione a 4095/0, picchi isolati)
+static const int32_t SOIL_TRACE[64] = {
+  2049, 2046, 2050, 4095, 2044, 2045, 2052, 2045, 2049, 3980, 2044, 2052, 2047, 2044, 2045, 2050,
+  2050, 2045, 2047, 2045, 2052, 0,    2044, 2053, 2045, 2047, 2054, 2054, 2053, 2044, 2053, 2053,
+  2050, 2044, 2047, 2044, 2052, 2046, 2048, 2050, 1210, 2052, 2045, 2053, 2048, 2052, 2054, 2046,
+  2045, 2053, 2053, 2054, 2047, 2049, 2045, 4095, 2055, 2045, 2053, 2044, 2053, 2047, 2051, 2054,
+};
+
+static void bench_signalFilter()
+{
+  using namespace SignalFilter;
+
+  // Riferimento: media dei 59 campioni senza glitch
+  int32_t refSum = 0, refN = 0;
+  for (int32_t v : SOIL_TRACE)
+    if (v > 2000 && v < 2100) { refSum += v; refN++; }
+  const int32_t ref = refSum / refN;
+
+  // Mediana mobile = mediana della finestra ordinata a forza bruta
+  RunningMedian<int32_t, 9> rm;
+  for (int i = 0; i < 64; i++) {
+    const int32_t got = rm.push(SOIL_TRACE[i]);
+    int32_t w[9];
+    const int n = i + 1 < 9 ? i + 1 : 9;
+    std::copy(SOIL_TRACE + i + 1 - n, SOIL_TRACE + i + 1, w);
+    std::sort(w, w + n);
+    const int32_t want = (n & 1) ? w[n / 2] : (w[n / 2 - 1] + w[n / 2]) / 2;
+    TEST_ASSERT_EQUAL(want, got);
+  }
+
+  // 16 campioni con 2 glitch: Hampel + media resta sul riferimento, la vecchia
+  // media senza min/max no (scarta un solo valore alto)
+  AdcHampel hampel;
+  MinMaxTracker<int32_t> range;
+  int32_t hSum = 0, rawSum = 0;
+  for (int i = 0; i < 16; i++) {
+    hSum += hampel.push(SOIL_TRACE[i]);
+    rawSum += SOIL_TRACE[i];
+    range.push(SOIL_TRACE[i]);
+  }
+  const int32_t hampelMean = hSum / 16;
+  const int32_t trimmedMean = (rawSum - range.min() - range.max()) / 14;
+  TEST_ASSERT_EQUAL(2, hampel.outliers());
+  TEST_ASSERT_INT_WITHIN(3, ref, hampelMean);
+  TEST_ASSERT_TRUE(abs(trimmedMean - ref) > 50);
+
+  // Su tutta la traccia: tutti e 5 i glitch sostituiti
+  hampel.reset();
+  for (int32_t v : SOIL_TRACE) hampel.push(v);
+  TEST_ASSERT_EQUAL(5, hampel.outliers());
+
+  // IIR: ingresso costante esatto, gradino 0 → 1000 al 99% in 16 passi con α = 1/4
+  ExpIir<2> iir;
+  TEST_ASSERT_EQUAL(2049, iir.push(2049));
+  iir.reset();
+  iir.push(0);
+  int32_t y = 0;
+  for (int i = 0; i < 16; i++) y = iir.push(1000);
+  TEST_ASSERT_INT_WITHIN(10, 1000, y);
+
+  TEST_ASSERT_EQUAL(4095, range.max());
+  TEST_ASSERT_EQUAL(2044, range.min());
+
+  int32_t sink = 0;
+  size_t k = 0;
+  benchRun("RunningMedian<9>::push", ITER * 10, [&] { sink += rm.push(SOIL_TRACE[k++ & 63]); });
+  benchRun("AdcHampel::push", ITER * 10, [&] { sink += hampel.push(SOIL_TRACE[k++ & 63]); });
+  benchRun("ExpIir<2>::push", ITER * 10, [&] { sink += iir.push(SOIL_TRACE[k++ & 63]); });
+  TEST_ASSERT_TRUE(sink != 0);
+}
+
+static void bench_adcReduce()
+{
+  TEST_ASSERT_EQUAL(4, AdcSampler::gpioToAdc1Channel(32));
+  TEST_ASSERT_EQUAL(6, AdcSampler::gpioToAdc1Channel(34));
+  TEST_ASSERT_EQUAL(-1, AdcSampler::gpioToAdc1Channel(26));   // ADC2: niente DMA
+
+  // Frame TYPE1 alternati soil/batteria come li produce il DMA, più un canale estraneo
+  static uint8_t frames[256];
+  size_t len = 0;
+  auto put = [&](uint8_t ch, uint16_t v) {
+    const uint16_t w = (uint16_t)((ch << 12) | (v & 0x0FFF));
+    frames[len++] = (uint8_t)w;
+    frames[len++] = (uint8_t)(w >> 8);
+  };
+  for (int i = 0; i < 60; i++) {
+    put(4, (uint16_t)(2000 + (i % 3)));   // 2000..2002
+    put(6, 1500);
+  }
+  put(4, 4095);   // spike: sostituito da Hampel
+  put(4, 0);      // spike: sostituito da Hampel
+  put(5, 123);    // canale non configurato
+
+  AdcChannelAcc soil, batt;
+  AdcSampler::accumulate(frames, len, 4, 6, soil, batt);
+  TEST_ASSERT_EQUAL(62, soil.n);
+  TEST_ASSERT_EQUAL(60, batt.n);
+  TEST_ASSERT_EQUAL(2001, AdcSampler::channelMean(soil));
+  TEST_ASSERT_EQUAL(1500, AdcSampler::channelMean(batt));
+  TEST_ASSERT_EQUAL(2, soil.hampel.outliers());
+  TEST_ASSERT_EQUAL(4095, soil.range.max());
+
+  // Senza driver DMA (env native) il controllo deve ripiegare su analogRead
+  TEST_ASSERT_FALSE(AdcSampler::begin(32, 34));
+
+  benchRun("AdcSampler::accumulate(256B)", ITER, [&] {
+    AdcChannelAcc s, b;
+    AdcSampler::accumulate(frames, len, 4, 6, s, b);
+    AdcSampler::channelMean(s);
+  });
+}
+
+static void bench_telemetryBatch()
+{
+  TelemetryBuffer::begin(true);
+  for (uint32_t i = 0; i < TelemetryBuffer::CAPACITY + 2; i++) {
+    TelemetrySample s = {};
+    s.ts = 1760000000UL + i * 3600UL;
+    s.wake = i + 1;
+    s.soilRaw = 4095;
+    s.battery = 4095;
+    s.soilPct = 100;
+    s.flags = TELEMETRY_FLAG_WATERED | TELEMETRY_FLAG_PUMP_ALERT;
+    TelemetryBuffer::append(s);
+  }
+  TEST_ASSERT_EQUAL(TelemetryBuffer::CAPACITY, TelemetryBuffer::count());
+  TEST_ASSERT_EQUAL(2, TelemetryBuffer::dropped());
+  TEST_ASSERT_TRUE(TelemetryBuffer::almostFull());
+
+  // Caso peggiore: deve stare in MAX_BATCH_JSON, il più vecchio rimasto è il wake 3
+  static char out[TelemetryBuffer::MAX_BATCH_JSON];
+  size_t n = TelemetryBuffer::formatBatch(out, sizeof(out), 99);
+  TEST_ASSERT_TRUE(n > 0);
+  TEST_ASSERT_TRUE(strstr(out, "\"s\":[[1760007200,3,") != nullptr);
+  TEST_ASSERT_EQUAL(0, TelemetryBuffer::formatBatch(out, 64, 99));
+
+  benchRun("formatBatch(48)", ITER / 10, [&] { TelemetryBuffer::formatBatch(out, sizeof(out), 99); });
+
+  TelemetryBuffer::clear();
+  TEST_ASSERT_EQUAL(0, TelemetryBuffer::count());
+}
+
+static void bench_bootSequencer()
+{
+  // radio: non termina mai, la deadline lo chiude (onTimeout) → mqtt skipped,
+  // ntp (solo after) parte comunque; sensor indipendente finisce subito;
+  // pump fallisce in start() → irrigate skipped
+  static int timeouts, polls;
+  timeouts = 0;
+  polls = 0;
+  BootSequencer seq;
+  const int radio = seq.add("radio", 20, [] { return true; },
+                            [] { polls++; return StageStatus::Running; },
+                            0, 0, BootPhase::Count, [] { timeouts++; });
+  const int mqtt = seq.add("mqtt", 0, nullptr, nullptr, 0, STAGE_BIT(radio));
+  const int ntp = seq.add("ntp", 0, nullptr, nullptr, STAGE_BIT(radio));
+  const int sensor = seq.add("sensor", 0, nullptr, [] { return StageStatus::Done; });
+  const int pump = seq.add("pump", 0, [] { return false; }, nullptr);
+  const int irrigate = seq.add("irrigate", 0, nullptr, nullptr, 0,
+                               STAGE_BIT(sensor) | STAGE_BIT(pump));
+
+  seq.tick();
+  TEST_ASSERT_EQUAL((int)StageStatus::Running, (int)seq.status(radio));
+  TEST_ASSERT_EQUAL((int)StageStatus::Pending, (int)seq.status(mqtt));
+  TEST_ASSERT_TRUE(seq.ok(sensor));
+  TEST_ASSERT_EQUAL((int)StageStatus::Failed, (int)seq.status(pump));
+  TEST_ASSERT_EQUAL((int)StageStatus::Skipped, (int)seq.status(irrigate));
+  TEST_ASSERT_FALSE(seq.done());
+
+  const unsigned long t0 = millis();
+  while (!seq.done() && millis() - t0 < 500) { seq.tick(); delay(1); }
+  TEST_ASSERT_TRUE(seq.done());
+  TEST_ASSERT_EQUAL((int)StageStatus::Failed, (int)seq.status(radio));
+  TEST_ASSERT_EQUAL(1, timeouts);
+  TEST_ASSERT_TRUE(polls > 1);
+  TEST_ASSERT_TRUE(seq.elapsedMs(radio) >= 20);
+  TEST_ASSERT_EQUAL((int)StageStatus::Skipped, (int)seq.status(mqtt));
+  TEST_ASSERT_TRUE(seq.ok(ntp));
+  TEST_ASSERT_EQUAL((int)StageStatus::Skipped, (int)seq.status(99));
+
+  BootSequencer full;
+  for (uint8_t i = 0; i < BootSequencer::MAX_STAGES; i++)
+    TEST_ASSERT_EQUAL(i, full.add("s", 0, nullptr, nullptr, i ? STAGE_BIT(i - 1) : 0));
+  TEST_ASSERT_EQUAL(-1, full.add("s", 0, nullptr, nullptr));
+
+  benchRun("BootSequencer::tick(12 done)", ITER, [&] { full.tick(); });
+}
+
+static void bench_wakePolicy()
+{
+  Config cfg = getDefaultConfig();
+  cfg.sleep_hours = 1;
+  cfg.maintenance_wakes = 4;
+  cfg.debug = false;
+  cfg.enable_webserver = false;
+
+  Config awake = cfg;
+  awake.debug = true;
+  TEST_ASSERT_EQUAL((int)RadioReason::AlwaysOn, (int)WakePolicy::decide(awake, 50, false, false, false));
+  awake = cfg;
+  awake.maintenance_wakes = 1;
+  TEST_ASSERT_EQUAL((int)RadioReason::AlwaysOn, (int)WakePolicy::decide(awake, 50, false, false, false));
+  TEST_ASSERT_EQUAL(0, WakePolicy::quickWakeBudget(awake));
+
+  WakePolicy::begin(true);
+  TEST_ASSERT_EQUAL((int)RadioReason::ColdBoot, (int)WakePolicy::decide(cfg, 50, false, false, false));
+  TEST_ASSERT_EQUAL(0, WakePolicy::quickWakeBudget(cfg));   // mai riportato
+  WakePolicy::radioDone(true, 50);
+
+  // Wake da deep sleep: priorità pompa > irrigazione > retry > batch > delta > manutenzione
+  WakePolicy::begin(false);
+  TEST_ASSERT_EQUAL(50, WakePolicy::lastReportedPercent());
+  TEST_ASSERT_EQUAL((int)RadioReason::PumpAlert, (int)WakePolicy::decide(cfg, 50, true, true, true));
+  TEST_ASSERT_EQUAL((int)RadioReason::Watered, (int)WakePolicy::decide(cfg, 50, true, false, true));
+  TEST_ASSERT_EQUAL((int)RadioReason::BatchFull, (int)WakePolicy::decide(cfg, 50, false, false, true));
+  TEST_ASSERT_EQUAL((int)RadioReason::MoistureDelta,
+                    (int)WakePolicy::decide(cfg, 50 - WakePolicy::MOISTURE_REPORT_DELTA, false, false, false));
+  TEST_ASSERT_EQUAL((int)RadioReason::None, (int)WakePolicy::decide(cfg, 52, false, false, false));
+
+  // Broker irraggiungibile: si riprova, e niente wake rapidi finché non passa
+  WakePolicy::radioDone(false, 52);
+  TEST_ASSERT_EQUAL((int)RadioReason::Retry, (int)WakePolicy::decide(cfg, 52, false, false, true));
+  TEST_ASSERT_EQUAL(0, WakePolicy::quickWakeBudget(cfg));
+  WakePolicy::radioDone(true, 52);
+  TEST_ASSERT_EQUAL(0, WakePolicy::wakesSinceRadio());
+
+  // Budget: i wake rapidi più quello completo successivo fanno maintenance_wakes
+  TEST_ASSERT_EQUAL(3, WakePolicy::quickWakeBudget(cfg));
+  WakePolicy::radioSkipped();
+  TEST_ASSERT_EQUAL(2, WakePolicy::quickWakeBudget(cfg));
+  WakePolicy::quickWakes(2);
+  TEST_ASSERT_EQUAL(3, WakePolicy::wakesSinceRadio());
+  TEST_ASSERT_EQUAL(0, WakePolicy::quickWakeBudget(cfg));
+  TEST_ASSERT_EQUAL((int)RadioReason::Maintenance, (int)WakePolicy::decide(cfg, 52, false, false, false));
+  WakePolicy::quickWakes(UINT16_MAX);
+  TEST_ASSERT_EQUAL(UINT16_MAX, WakePolicy::wakesSinceRadio());
+
+  // Mai riportato dopo un cold boot: il primo wake da sleep riporta comunque
+  WakePolicy::begin(true);
+  WakePolicy::radioSkipped();
+  WakePolicy::begin(false);
+  TEST_ASSERT_EQUAL((int)RadioReason::MoistureDelta, (int)WakePolicy::decide(cfg, 52, false, false, false));
+
+  benchRun("WakePolicy::decide", ITER, [&] { WakePolicy::decide(cfg, 52, false, false, false); });
+}
+
+static void bench_sleepScheduler()
+{
+  Config cfg = getDefaultConfig();
+  cfg.moisture_threshold = 25;
+  cfg.measurement_interval = 1800000;   // minimo 30 min
+  cfg.sleep_hours = 1;
+  cfg.sleep_max_hours = 12;
+  cfg.low_battery_mv = 3000;
+
+  // Storico insufficiente: sleep_hours
+  SleepScheduler::begin(true);
+  SleepPlan p = SleepScheduler::plan(cfg, 60, 3300);
+  TEST_ASSERT_EQUAL((int)SleepReason::NoTrend, (int)p.reason);
+  TEST_ASSERT_EQUAL(3600, p.sleepS);
+
+  // Asciuga di 5 %/h: 40 % → soglia 25 % tra 3 h, sveglia a 7/8
+  for (uint32_t h = 0; h < 5; h++) SleepScheduler::record(h * 3600, 60 - 5 * (int)h, false);
+  p = SleepScheduler::plan(cfg, 40, 3300);
+  TEST_ASSERT_EQUAL((int)SleepReason::Predicted, (int)p.reason);
+  TEST_ASSERT_EQUAL(-500, p.slopeX100);
+  TEST_ASSERT_EQUAL(10800, p.crossS);
+  TEST_ASSERT_EQUAL(9450, p.sleepS);
+
+  // Batteria scarica: raddoppia
+  p = SleepScheduler::plan(cfg, 40, 2500);
+  TEST_ASSERT_TRUE(p.stretched);
+  TEST_ASSERT_EQUAL(18900, p.sleepS);
+
+  // Sotto soglia: intervallo minimo
+  p = SleepScheduler::plan(cfg, 20, 3300);
+  TEST_ASSERT_EQUAL((int)SleepReason::Dry, (int)p.reason);
+  TEST_ASSERT_EQUAL(1800, p.sleepS);
+
+  // Irrigazione: lo storico riparte
+  SleepScheduler::record(5 * 3600, 35, true);
+  TEST_ASSERT_EQUAL(0, SleepScheduler::historyCount());
+
+  // Stabile (rumore ±1): intervallo massimo
+  const int flat[] = { 50, 51, 50, 49, 50, 51 };
+  for (uint32_t i = 0; i < 6; i++) SleepScheduler::record(6 * 3600 + i * 3600, flat[i], false);
+  p = SleepScheduler::plan(cfg, 50, 3300);
+  TEST_ASSERT_EQUAL((int)SleepReason::Steady, (int)p.reason);
+  TEST_ASSERT_EQUAL(12 * 3600, p.sleepS);
+
+  // Salita brusca senza pompa (pioggia): nuovo storico
+  SleepScheduler::record(12 * 3600, 70, false);
+  TEST_ASSERT_EQUAL(1, SleepScheduler::historyCount());
+
+  for (uint32_t i = 0; i < SleepScheduler::HISTORY; i++)
+    SleepScheduler::record(13 * 3600 + i * 3600, 70 - (int)i, false);
+  benchRun("SleepScheduler::plan(8)", ITER, [&] { SleepScheduler::plan(cfg, 60, 3300); });
+}
+
+static void bench_wakeStubBand()
+{
+  // La banda sul grezzo deve decidere esattamente come WakePolicy::decide()
+  // sulla percentuale: soglia e delta di report
+  const int delta = 5;
+  int16_t lo = 0, hi = 0;
+  TEST_ASSERT_FALSE(WakeStub::quickBand(25, -1, delta, lo, hi));   // mai riportato
+  TEST_ASSERT_FALSE(WakeStub::quickBand(25, 20, delta, lo, hi));   // già sotto soglia
+
+  const int last[] = { 30, 50, 97, 100 };
+  for (int l : last) {
+    TEST_ASSERT_TRUE(WakeStub::quickBand(25, l, delta, lo, hi));
+    for (int raw = 0; raw <= 4095; raw++) {
+      const int pct = soilRawToPercent(raw);
+      const bool quick = pct >= 25 && abs(pct - l) < delta;
+      TEST_ASSERT_EQUAL(quick, raw > lo && raw <= hi);
+    }
+  }
+
+  int sink = 0;
+  benchRun("WakeStub::quickBand", ITER, [&] {
+    WakeStub::quickBand(25, 50, delta, lo, hi);
+    sink += hi - lo;
+  });
+  TEST_ASSERT_TRUE(sink > 0);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(bench_jsonToConfig);
+  RUN_TEST(bench_configToJson);
+  RUN_TEST(bench_configStream);
+  RUN_TEST(bench_validateConfig);
+  RUN_TEST(bench_configSchema);
+  RUN_TEST(bench_configApply);
+  RUN_TEST(bench_configCache);
+  RUN_TEST(bench_recordStore);
+  RUN_TEST(bench_historyStore);
+  RUN_TEST(bench_publishConfigSnapshot);
+  RUN_TEST(bench_mqttCallback_pump);
+  RUN_TEST(bench_mqttCallback_json_pump);
+  RUN_TEST(bench_mqttRoute);
+  RUN_TEST(bench_connectMqtt_session);
+  RUN_TEST(bench_mqttCallback_unmatched);
+  RUN_TEST(bench_publishStatus_text);
+  RUN_TEST(bench_publishStatus_binary);
+  RUN_TEST(bench_reportPolicy);
+  RUN_TEST(bench_mqttQueue);
+  RUN_TEST(bench_spscQueue);
+  RUN_TEST(bench_pumpCutoff);
+  RUN_TEST(bench_irrigation);
+  RUN_TEST(bench_telemetryFrame);
+  RUN_TEST(bench_compareVersions);
+  RUN_TEST(bench_soilFilter);
+  RUN_TEST(bench_signalFilter);
+  RUN_TEST(bench_adcReduce);
+  RUN_TEST(bench_telemetryBatch);
+  RUN_TEST(bench_bootSequencer);
+  RUN_TEST(bench_wakePolicy);
+  RUN_TEST(bench_sleepScheduler);
+  RUN_TEST(bench_wakeStubBand);
+  return UNITY_END();
+}